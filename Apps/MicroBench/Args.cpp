@@ -0,0 +1,62 @@
+#include "Args.h"
+#include <iostream>
+#include <algorithm>
+#include <thread>
+
+const char* helpString =
+  R".(
+Usage: MicroBench benchmark [options]
+transforms - recursive Node::updateTransform against the flattened TransformHierarchy
+culling - Frustum::intersects per AABB against the scalar and AVX2 AABBBatch kernels
+recording - command buffer bind state kept in owning Ptr against borrowed Ref handles
+pools - small Objects from new against Pooled types, descriptor set and asset loading patterns
+-n 1000000 - count: nodes, boxes, draws or objects
+-g 4 - group size: children per node, draws per pipeline
+-t 0 - threads, 0=hardware concurrency
+-i 20 - timed iterations of every benchmark, average is logged
+-d 1 - fraction of local matrices changed before every update
+).";
+
+
+void Args::init(int argc, char** argv) {
+  std::string arg;
+  auto next = [&]() {
+    arg = *argv;
+    argv++;
+    argc--;
+  };
+  next();
+
+  if(!argc) {
+    std::cout << helpString;
+    exit(0);
+  }
+  next();
+  benchmark = arg;
+
+  while(argc) {
+    next();
+
+    if(arg == "-n" && argc) {
+      next();
+      count = std::max(1, std::stoi(arg));
+    } else if(arg == "-g" && argc) {
+      next();
+      groupSize = std::max(1, std::stoi(arg));
+    } else if(arg == "-t" && argc) {
+      next();
+      threads = std::max(0, std::stoi(arg));
+    } else if(arg == "-i" && argc) {
+      next();
+      iterations = std::max(1, std::stoi(arg));
+    } else if(arg == "-d" && argc) {
+      next();
+      dirty = std::clamp(std::stof(arg), 0.f, 1.f);
+    } else {
+      std::cout << helpString;
+      exit(0);
+    }
+  }
+
+  if(threads == 0) threads = std::max(1, int(std::thread::hardware_concurrency()));
+}
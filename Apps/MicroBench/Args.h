@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+struct Args {
+public:
+  void init(int argc, char** argv);
+
+  std::string benchmark;
+  // elements and the size of their groups, their meaning depends on the benchmark
+  int count = 1000000;
+  int groupSize = 4;
+  int threads = 0;
+  int iterations = 20;
+  float dirty = 1;
+};
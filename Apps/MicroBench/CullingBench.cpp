@@ -0,0 +1,82 @@
+#include "CullingBench.h"
+
+#include "Timer.h"
+#include "Math/AABB.h"
+#include "Math/Frustum.h"
+#include <random>
+
+using namespace Nei;
+
+namespace {
+  using namespace Timer;
+
+  // camera in the middle of the box cloud, turning a bit every iteration
+  mat4 viewProjection(int iteration) {
+    float angle = 0.1f * float(iteration);
+    mat4 view = lookAt(vec3(0), vec3(sin(angle), 0.2f, cos(angle)), vec3(0, 1, 0));
+    return perspective(radians(90.f), 16.f / 9.f, 0.1f, 500.f) * view;
+  }
+}
+
+void runCullingBench(Args const& args) {
+  nei_log("Culling: {} boxes, AVX2 {}", args.count, Frustum::hasAvx2() ? "supported" : "not supported");
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> position(-1000, 1000);
+  std::uniform_real_distribution<float> size(0.5f, 20);
+  std::vector<AABB> boxes(args.count);
+  AABBBatch batch;
+  batch.reserve(args.count);
+  for(auto& b : boxes) {
+    vec3 center = vec3(position(random), position(random), position(random));
+    vec3 extent = vec3(size(random), size(random), size(random));
+    b = AABB(center - extent, center + extent);
+    batch.add(b);
+  }
+
+  std::vector<uint> visible;
+  std::vector<uint> visibleScalar;
+  std::vector<uint> visibleAvx2;
+  visible.reserve(args.count);
+  visibleScalar.reserve(args.count);
+  visibleAvx2.reserve(args.count);
+
+  double aabbTime = 0;
+  double scalarTime = 0;
+  double avx2Time = 0;
+  size_t visibleCount = 0;
+  int mismatches = 0;
+  for(int i = 0; i < args.iterations; i++) {
+    Frustum frustum(viewProjection(i));
+
+    visible.clear();
+    auto start = Clock::now();
+    for(uint b = 0; b < uint(boxes.size()); b++) {
+      if(frustum.intersects(boxes[b])) visible.push_back(b);
+    }
+    aabbTime += ms(start);
+
+    visibleScalar.clear();
+    start = Clock::now();
+    frustum.cull(batch, visibleScalar, Frustum::Kernel::Scalar);
+    scalarTime += ms(start);
+
+    visibleAvx2.clear();
+    start = Clock::now();
+    frustum.cull(batch, visibleAvx2, Frustum::Kernel::Avx2);
+    avx2Time += ms(start);
+
+    visibleCount += visible.size();
+    if(visible != visibleScalar || visible != visibleAvx2) mismatches++;
+  }
+
+  double boxes = double(args.count);
+  aabbTime /= args.iterations;
+  scalarTime /= args.iterations;
+  avx2Time /= args.iterations;
+  nei_log("{}% visible on average", 100.0 * visibleCount / (boxes * args.iterations));
+  nei_log("AABB::intersects {} ms, {} boxes/ms", aabbTime, boxes / aabbTime);
+  nei_log("AABBBatch scalar {} ms, {} boxes/ms, {}x", scalarTime, boxes / scalarTime, aabbTime / scalarTime);
+  nei_log("AABBBatch AVX2 {} ms, {} boxes/ms, {}x", avx2Time, boxes / avx2Time, aabbTime / avx2Time);
+  nei_log("{} iterations with different visible lists", mismatches);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Args.h"
+
+// frustum test of n random boxes, per box AABB test against the SoA batch kernels
+void runCullingBench(Args const& args);
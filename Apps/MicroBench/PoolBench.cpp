@@ -0,0 +1,99 @@
+#include "PoolBench.h"
+
+#include "Timer.h"
+#include "NeiCore.h"
+#include <thread>
+
+using namespace Nei;
+
+namespace {
+  using namespace Timer;
+
+  constexpr int setsPerAllocation = 16;
+
+  // payload sizes close to DescriptorSet and Buffer
+  template <size_t Size>
+  struct Plain : Object {
+    char data[Size];
+  };
+
+  template <size_t Size>
+  struct PooledObject : Object, Pooled<PooledObject<Size>> {
+    char data[Size];
+  };
+
+  template <typename Body>
+  double onThreads(int threads, Body const& body) {
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for(int t = 1; t < threads; t++) pool.emplace_back(body, t);
+    body(0);
+    for(auto& t : pool) t.join();
+    return ms(start);
+  }
+
+  // DescriptorPool::allocate(count) every frame, the sets of the previous frame are released
+  template <typename Set>
+  double descriptorSets(Args const& args, int threads) {
+    int frames = glm::max(1, args.count / threads / setsPerAllocation);
+    return onThreads(threads, [&](int) {
+      std::vector<Ptr<Set>> previous, current;
+      for(int f = 0; f < frames; f++) {
+        for(int i = 0; i < setsPerAllocation; i++) current.push_back(new Set);
+        previous.swap(current);
+        current.clear();
+      }
+    });
+  }
+
+  // every loader thread creates buffers and sets for its share of the assets, all are released at the end
+  template <typename Buffer, typename Set>
+  double assetLoading(Args const& args, int threads) {
+    int count = glm::max(1, args.count / threads / 2);
+    std::vector<std::vector<Ptr<Object>>> loaded(threads);
+    double time = onThreads(threads, [&](int t) {
+      auto& objects = loaded[t];
+      for(int i = 0; i < count; i++) {
+        objects.push_back(new Buffer);
+        objects.push_back(new Set);
+      }
+    });
+    auto start = Clock::now();
+    loaded.clear();
+    return time + ms(start);
+  }
+
+  void compare(std::string const& name, double plainTime, double pooledTime, double objects) {
+    nei_log("{} new {} ms, {} ns/object", name, plainTime, 1e6 * plainTime / objects);
+    nei_log("{} pooled {} ms, {} ns/object, {}x", name, pooledTime, 1e6 * pooledTime / objects,
+      plainTime / pooledTime);
+  }
+}
+
+void runPoolBench(Args const& args) {
+  nei_log("Pools: {} objects, {} threads", args.count, args.threads);
+
+  using PlainSet = Plain<32>;
+  using PlainBuffer = Plain<96>;
+  using PooledSet = PooledObject<32>;
+  using PooledBuffer = PooledObject<96>;
+
+  double objects = double(args.count);
+  for(int threads : {1, args.threads}) {
+    double plainSets = 0;
+    double pooledSets = 0;
+    double plainAssets = 0;
+    double pooledAssets = 0;
+    for(int i = 0; i < args.iterations; i++) {
+      plainSets += descriptorSets<PlainSet>(args, threads);
+      pooledSets += descriptorSets<PooledSet>(args, threads);
+      plainAssets += assetLoading<PlainBuffer, PlainSet>(args, threads);
+      pooledAssets += assetLoading<PooledBuffer, PooledSet>(args, threads);
+    }
+    nei_log("{} threads", threads);
+    compare("Descriptor sets", plainSets / args.iterations, pooledSets / args.iterations, objects);
+    compare("Asset loading", plainAssets / args.iterations, pooledAssets / args.iterations, objects);
+    if(threads == args.threads) break;
+  }
+  ObjectPool::logStats();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Args.h"
+
+// n small Objects from the global allocator against Pooled types, descriptor set and asset loading patterns
+void runPoolBench(Args const& args);
@@ -0,0 +1,183 @@
+#include "RecordingBench.h"
+
+#include "Timer.h"
+#include "NeiCore.h"
+
+using namespace Nei;
+
+namespace {
+  using namespace Timer;
+
+  constexpr int pipelineCount = 64;
+  constexpr int meshCount = 1024;
+
+  // Vu::CommandBuffer can't be recorded without a device and its handles are Ref now, so its bind state is
+  // mirrored member by member. vkCmd* calls are replaced by a counter, driver recording cost is not measured
+  struct Pipeline : Object {
+    uint id = 0;
+    virtual void bind(uint64& commands) = 0;
+  };
+
+  struct GraphicsPipeline : Pipeline {
+    void bind(uint64& commands) override { commands += id; }
+  };
+
+  struct ComputePipeline : Pipeline {
+    void bind(uint64& commands) override { commands += id; }
+  };
+
+  struct RaytracingPipeline : Pipeline {
+    void bind(uint64& commands) override { commands += id; }
+  };
+
+  struct RenderPass : Object { };
+  struct Framebuffer : Object { };
+
+  struct Buffer : Object {
+    enum Type { Vertex, Index };
+    Type type = Vertex;
+    uint id = 0;
+  };
+
+  // Mesh getters return Ptr before and Ref after the change, like Scene/Mesh.h
+  template <template<typename> class Handle>
+  struct Mesh {
+    Ptr<Buffer> vertexBuffer;
+    Ptr<Buffer> indexBuffer;
+    uint indexCount = 0;
+
+    Handle<Buffer> getVertexBuffer() const { return vertexBuffer; }
+    Handle<Buffer> getIndexBuffer() const { return indexBuffer; }
+  };
+
+  // members and bind paths of Vu::CommandBuffer, Handle is Ptr as before or Ref as now
+  template <template<typename> class Handle>
+  struct CommandBuffer {
+    Handle<Pipeline> lastBoundPipeline;
+    Handle<GraphicsPipeline> boundGraphicsPipeline;
+    Handle<ComputePipeline> boundComputePipeline;
+    Handle<RaytracingPipeline> boundRaytracingPipeline;
+    Handle<RenderPass> currentRenderPass;
+    Handle<Framebuffer> currentFramebuffer;
+    uint64 commands = 0;
+
+    void bind(GraphicsPipeline* pipeline) {
+      lastBoundPipeline = pipeline;
+      if(boundGraphicsPipeline == pipeline) return;
+      pipeline->bind(commands);
+      boundGraphicsPipeline = pipeline;
+    }
+
+    // no bound buffer state, every bind is recorded
+    void bind(Buffer* buffer) {
+      if(!buffer) return;
+      commands += buffer->type == Buffer::Vertex ? buffer->id : buffer->id + 1;
+    }
+
+    void drawIndexed(uint indexCount) { commands += indexCount; }
+
+    void reset() {
+      lastBoundPipeline = nullptr;
+      boundComputePipeline = nullptr;
+      boundGraphicsPipeline = nullptr;
+      boundRaytracingPipeline = nullptr;
+      currentRenderPass = nullptr;
+      currentFramebuffer = nullptr;
+    }
+
+    void begin(RenderPass* renderPass, Framebuffer* framebuffer) {
+      reset();
+      currentFramebuffer = framebuffer;
+      currentRenderPass = renderPass;
+    }
+
+    void record(std::vector<Ptr<GraphicsPipeline>> const& pipelines, std::vector<Mesh<Handle>> const& meshes,
+                int draws, int drawsPerPipeline, int first) {
+      for(int d = 0; d < draws; d++) {
+        auto& mesh = meshes[(first + d) % meshCount];
+        bind(pipelines[(first + d) / drawsPerPipeline % pipelineCount]);
+        bind(mesh.getVertexBuffer());
+        bind(mesh.getIndexBuffer());
+        drawIndexed(mesh.indexCount);
+      }
+    }
+  };
+
+  struct Scene {
+    std::vector<Ptr<GraphicsPipeline>> pipelines;
+    std::vector<Ptr<Buffer>> buffers;
+    Ptr<RenderPass> renderPass = new RenderPass;
+    Ptr<Framebuffer> framebuffer = new Framebuffer;
+  };
+
+  template <template<typename> class Handle>
+  std::vector<Mesh<Handle>> meshes(Scene const& scene) {
+    std::vector<Mesh<Handle>> result(meshCount);
+    for(int i = 0; i < meshCount; i++) {
+      result[i].vertexBuffer = scene.buffers[2 * i];
+      result[i].indexBuffer = scene.buffers[2 * i + 1];
+      result[i].indexCount = 3 * (i + 1);
+    }
+    return result;
+  }
+
+  // every job records its share of the draws into its own command buffer, objects are shared like in a frame
+  template <template<typename> class Handle>
+  double recordFrame(Args const& args, Scene const& scene, std::vector<Mesh<Handle>> const& meshes,
+                     ThreadPool* pool, int threads, uint64& commands) {
+    std::vector<CommandBuffer<Handle>> cmds(threads);
+    int step = (args.count + threads - 1) / threads;
+    auto record = [&](int t) {
+      int first = t * step;
+      cmds[t].begin(scene.renderPass, scene.framebuffer);
+      cmds[t].record(scene.pipelines, meshes, glm::max(0, glm::min(args.count, first + step) - first),
+        args.groupSize, first);
+    };
+
+    auto start = Clock::now();
+    if(threads > 1) pool->parallelFor(threads, record);
+    else record(0);
+    double time = ms(start);
+    for(auto& c : cmds) commands += c.commands;
+    return time;
+  }
+}
+
+void runRecordingBench(Args const& args) {
+  nei_log("Recording: {} draws, {} draws per pipeline, {} threads", args.count, args.groupSize, args.threads);
+  nei_log("CommandBuffer bind state and Mesh getters are mirrored without a device, driver recording is not "
+    "included");
+
+  Scene scene;
+  for(int i = 0; i < pipelineCount; i++) {
+    scene.pipelines.push_back(new GraphicsPipeline);
+    scene.pipelines.back()->id = i;
+  }
+  for(int i = 0; i < 2 * meshCount; i++) {
+    scene.buffers.push_back(new Buffer);
+    scene.buffers.back()->type = i % 2 ? Buffer::Index : Buffer::Vertex;
+    scene.buffers.back()->id = i;
+  }
+  auto ptrMeshes = meshes<Ptr>(scene);
+  auto refMeshes = meshes<Ref>(scene);
+
+  Ptr<ThreadPool> pool = new ThreadPool(args.threads);
+  double draws = double(args.count);
+  for(int threads : {1, pool->getThreadCount()}) {
+    double ptrTime = 0;
+    double refTime = 0;
+    uint64 ptrCommands = 0;
+    uint64 refCommands = 0;
+    for(int i = 0; i < args.iterations; i++) {
+      ptrTime += recordFrame<Ptr>(args, scene, ptrMeshes, pool, threads, ptrCommands);
+      refTime += recordFrame<Ref>(args, scene, refMeshes, pool, threads, refCommands);
+    }
+    ptrTime /= args.iterations;
+    refTime /= args.iterations;
+    nei_log("{} threads", threads);
+    nei_log("Ptr bind state {} ms, {} ns/draw", ptrTime, 1e6 * ptrTime / draws);
+    nei_log("Ref bind state {} ms, {} ns/draw, {}x", refTime, 1e6 * refTime / draws, ptrTime / refTime);
+    if(ptrCommands != refCommands) nei_log("Recorded commands differ");
+    if(threads == pool->getThreadCount()) break;
+  }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Args.h"
+
+// bind state tracking of n draws with owning Ptr handles against borrowed Ref handles, on t threads
+void runRecordingBench(Args const& args);
@@ -0,0 +1,11 @@
+#pragma once
+#include <chrono>
+
+namespace Timer {
+  using Clock = std::chrono::high_resolution_clock;
+
+  // milliseconds since start
+  inline double ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+};
@@ -0,0 +1,96 @@
+#include "TransformBench.h"
+
+#include "Timer.h"
+#include "Scene/Node.h"
+#include "Scene/TransformHierarchy.h"
+
+using namespace Nei;
+
+namespace {
+  using namespace Timer;
+
+  mat4 localMatrix(int node, int frame) {
+    float angle = 0.001f * float(node + frame);
+    return rotate(translate(mat4(1), vec3(1, 0, 0)), angle, vec3(0, 1, 0));
+  }
+
+  void updateRecursive(Node* node) {
+    node->updateTransform();
+    for(auto& c : node->getChildren()) updateRecursive(c);
+  }
+
+  // nodes whose local matrix changes in the frame, node 0 is the root and never changes
+  std::vector<int> changedNodes(Args const& args, int frame) {
+    std::vector<int> changed;
+    int count = int(args.dirty * (args.count - 1));
+    if(count == 0) return changed;
+    int step = (args.count - 1) / count;
+    for(int i = 0; i < count; i++) changed.push_back(1 + i * step + frame % step);
+    return changed;
+  }
+}
+
+void runTransformBench(Args const& args) {
+  nei_log("Transforms: {} nodes, {} children per node, {} threads, {}% changed per update", args.count,
+    args.groupSize, args.threads, args.dirty * 100);
+
+  // same breadth first tree for both, parent of node i is (i - 1) / branching
+  auto start = Clock::now();
+  std::vector<Ptr<Node>> nodes(args.count);
+  nodes[0] = new Node;
+  for(int i = 1; i < args.count; i++) {
+    nodes[i] = new Node;
+    nodes[i]->setLocalMatrix(localMatrix(i, 0));
+    nodes[(i - 1) / args.groupSize]->add(nodes[i]);
+  }
+  nei_log("Node tree built in {} ms", ms(start));
+
+  start = Clock::now();
+  // workers are started once, like the pool of Application
+  Ptr<ThreadPool> pool = new ThreadPool(args.threads);
+  TransformHierarchy hierarchy;
+  hierarchy.add();
+  for(int i = 1; i < args.count; i++) hierarchy.add((i - 1) / args.groupSize, localMatrix(i, 0));
+  hierarchy.update(pool);
+  nei_log("TransformHierarchy built in {} ms, depth {}", ms(start), hierarchy.getDepth());
+  updateRecursive(nodes[0]);
+
+  double nodeTime = 0;
+  double flatTime = 0;
+  double flatSingleTime = 0;
+  for(int frame = 1; frame <= args.iterations; frame++) {
+    auto changed = changedNodes(args, frame);
+
+    for(int i : changed) nodes[i]->setLocalMatrix(localMatrix(i, frame));
+    start = Clock::now();
+    updateRecursive(nodes[0]);
+    nodeTime += ms(start);
+
+    // single threaded run shows the layout and simd gain alone
+    for(int i : changed) hierarchy.setLocal(i, localMatrix(i, frame));
+    start = Clock::now();
+    hierarchy.update();
+    flatSingleTime += ms(start);
+
+    for(int i : changed) hierarchy.setLocal(i, localMatrix(i, frame));
+    start = Clock::now();
+    hierarchy.update(pool);
+    flatTime += ms(start);
+  }
+
+  float maxError = 0;
+  for(int i = 0; i < args.count; i++) {
+    auto& a = nodes[i]->getWorldMatrix();
+    auto& b = hierarchy.getWorld(i);
+    for(int c = 0; c < 4; c++)
+      for(int r = 0; r < 4; r++) maxError = max(maxError, abs(a[c][r] - b[c][r]));
+  }
+
+  nodeTime /= args.iterations;
+  flatTime /= args.iterations;
+  flatSingleTime /= args.iterations;
+  nei_log("Node::updateTransform {} ms", nodeTime);
+  nei_log("TransformHierarchy 1 thread {} ms, {}x", flatSingleTime, nodeTime / flatSingleTime);
+  nei_log("TransformHierarchy {} threads {} ms, {}x", args.threads, flatTime, nodeTime / flatTime);
+  nei_log("Max world matrix difference {}", maxError);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "Args.h"
+
+// world matrices of a tree with n nodes, every node has b children
+void runTransformBench(Args const& args);
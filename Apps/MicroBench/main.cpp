@@ -0,0 +1,30 @@
+#include "Args.h"
+#include "TransformBench.h"
+#include "CullingBench.h"
+#include "RecordingBench.h"
+#include "PoolBench.h"
+#include "NeiCore.h"
+
+int main(int argc, char** argv) {
+  Args args;
+  args.init(argc, argv);
+
+  if(args.benchmark == "transforms") {
+    runTransformBench(args);
+    return 0;
+  }
+  if(args.benchmark == "culling") {
+    runCullingBench(args);
+    return 0;
+  }
+  if(args.benchmark == "recording") {
+    runRecordingBench(args);
+    return 0;
+  }
+  if(args.benchmark == "pools") {
+    runPoolBench(args);
+    return 0;
+  }
+  nei_log("Unknown benchmark {}", args.benchmark);
+  return 1;
+}
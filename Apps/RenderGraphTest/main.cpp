@@ -0,0 +1,141 @@
+#include "NeiGin.h"
+
+using namespace Nei;
+using namespace Vu;
+
+namespace {
+  int failures = 0;
+
+  void check(bool condition, char const* what) {
+    if(condition) return;
+    nei_warning("Failed: {}", what);
+    failures++;
+  }
+
+  using Access = RenderGraph::Access;
+  using Stage = vk::PipelineStageFlagBits;
+  using Layout = vk::ImageLayout;
+
+  // buffers are only keys for the graph, barriers are derived without a device
+  Buffer* fakeBuffer(int i) {
+    static char storage[16];
+    return reinterpret_cast<Buffer*>(storage + i);
+  }
+
+  // textures without an image, the graph only reads their layout and range
+  Ptr<Texture> fakeTexture() {
+    return new Texture(nullptr);
+  }
+
+  bool hasTransition(RenderGraph::Batch const& batch, Layout from, Layout to) {
+    for(auto& imb : batch.images)
+      if(imb.oldLayout == from && imb.newLayout == to) return true;
+    return false;
+  }
+
+  void computeWriteThenRead() {
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addPass("Write", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->addPass("Read", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeRead);
+    graph->compile();
+    check(graph->hasBarrier(1), "compute read after compute write waits for the write");
+  }
+
+  void secondReadIsVisible() {
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addPass("Write", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->addPass("Read", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeRead);
+    graph->addPass("Read again", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeRead);
+    graph->compile();
+    check(graph->hasBarrier(1), "first read waits for the write");
+    check(!graph->hasBarrier(2), "second read in the same stage needs no barrier");
+  }
+
+  void computeWriteThenWrite() {
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addPass("Write", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->addPass("Write again", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->addPass("Read", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeRead);
+    graph->compile();
+    check(graph->hasBarrier(1), "write after write waits");
+    check(graph->hasBarrier(2), "read waits for the second write");
+  }
+
+  // split clear and dispatch, the graph orders the transfer before the shader
+  void transferThenCompute() {
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addPass("Clear", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::TransferWrite);
+    graph->addPass("Dispatch", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->compile();
+    auto& batch = graph->getBarrier(1);
+    check(bool(batch.srcStages & Stage::eTransfer), "dispatch waits for the transfer stage");
+    check(bool(batch.dstStages & Stage::eComputeShader), "transfer is made visible to compute");
+    check(bool(batch.memory.srcAccessMask & vk::AccessFlagBits::eTransferWrite), "transfer write is made available");
+  }
+
+  void imageLayouts() {
+    auto texture = fakeTexture();
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addPass("Write", [](CommandBuffer*) { }).use(texture, Access::ComputeWrite);
+    graph->addPass("Copy", [](CommandBuffer*) { }).use(texture, Access::TransferRead);
+    graph->compile();
+
+    auto& first = graph->getBarrier(0, false);
+    check(hasTransition(first, Layout::eUndefined, Layout::eGeneral), "first frame starts from undefined");
+    check(bool(first.srcStages & Stage::eTopOfPipe), "first transition waits for nothing");
+    auto& copy = graph->getBarrier(1, false);
+    check(hasTransition(copy, Layout::eGeneral, Layout::eTransferSrcOptimal), "copy gets its transfer layout");
+    check(bool(copy.srcStages & Stage::eComputeShader), "copy waits for the compute write");
+
+    // content is kept, the next frame starts from the layout the last pass left
+    auto& steady = graph->getBarrier(0);
+    check(hasTransition(steady, Layout::eTransferSrcOptimal, Layout::eGeneral), "steady state starts from the copy");
+    check(bool(steady.srcStages & Stage::eTransfer), "steady write waits for the copy of the previous frame");
+  }
+
+  void transientImage() {
+    auto texture = fakeTexture();
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->setTransient(texture);
+    graph->addPass("Write", [](CommandBuffer*) { }).use(texture, Access::ComputeWrite);
+    graph->addPass("Copy", [](CommandBuffer*) { }).use(texture, Access::TransferRead);
+    graph->compile();
+    check(hasTransition(graph->getBarrier(0), Layout::eUndefined, Layout::eGeneral),
+      "transient content is discarded in the steady state");
+  }
+
+  // b reuses the memory of a, its first use waits for the last use of a in both simulations
+  void aliases() {
+    Ptr<RenderGraph> graph = new RenderGraph(nullptr);
+    graph->addAlias(fakeBuffer(0), fakeBuffer(1));
+    graph->addPass("Write a", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::ComputeWrite);
+    graph->addPass("Read a", [](CommandBuffer*) { }).use(fakeBuffer(0), Access::RaytracingRead);
+    graph->addPass("Write b", [](CommandBuffer*) { }).use(fakeBuffer(1), Access::TransferWrite);
+    graph->compile();
+
+    for(bool steady : {false, true}) {
+      auto& batch = graph->getBarrier(2, steady);
+      check(bool(batch.srcStages & Stage::eRayTracingShaderNV), "first use of b waits for the reader of a");
+      check(bool(batch.dstStages & Stage::eTransfer), "alias barrier is in front of the transfer");
+    }
+    check(graph->hasBarrier(0), "a waits for b of the previous frame");
+    check(!graph->getBarrier(0, false).srcStages, "nothing to wait for in the first frame");
+  }
+}
+
+int main(int argc, char** argv) {
+  computeWriteThenRead();
+  secondReadIsVisible();
+  computeWriteThenWrite();
+  transferThenCompute();
+  imageLayouts();
+  transientImage();
+  aliases();
+
+  if(failures) {
+    nei_warning("RenderGraphTest {} checks failed", failures);
+    return 1;
+  }
+  nei_log("RenderGraphTest passed");
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "Args.h"
 #include <iostream>
+#include <algorithm>
 
 const char* helpString =
   R".(
@@ -15,6 +16,29 @@ Usage:
 -r 1 - render scale (allows to 4k on 1080p display)
 -a 1 - average render times from N frames
 -b 0 - Build BVH 0=once, 1=update top every frame, 2=update top+bottom every frame, 3=full rebuild
+-sm 0 - shadow mode 0=full rate, 1=half resolution, 2=checkerboard, 3=temporal reprojection, 4=world space cache,
+      5=classified and compacted rays, 6=inline ray query in lighting pass (VK_KHR_ray_query)
+-cs 22 - shadow cache size as log2 of entries (8 bytes per entry)
+-ca 600 - shadow cache entries not used for N frames are evicted
+-qm - measure shadow mask error against full rate reference (not included in timings)
+-fb - full pipeline barrier before every pass instead of barriers derived by the render graph
+-na - no memory aliasing, every transient render target gets its own allocation
+-i 1 - model instances placed in a grid, one top level instance each
+-ia 0 - fraction of instances moved every frame, only moved instances are uploaded (needs -b 1, 2 or 3)
+-c 1 - split the model into N spatial clusters, one bottom level BVH each
+-cm - cluster by centroid median instead of surface area heuristic
+-ts 0 - split long thin triangles before the bottom level build, budget as fraction of extra triangles
+-bc "" - load static bottom levels from cache directory, built ones are stored (needs -b 0 or 1 and -rt khr or -sm 6)
+-rt nv - ray tracing api nv=VK_NV_ray_tracing, khr=VK_KHR_acceleration_structure and VK_KHR_ray_tracing_pipeline
+-nc - no background compaction of bottom levels
+-ct - compact the top level too once bottom levels are compacted (not with -b 3)
+-hb 0 - build static bottom levels on the cpu with N threads (needs -b 0 or 1, implies -rt khr)
+-ac - BVH updates on the dedicated compute queue, overlapping the gbuffer pass
+-sh - shader binding table in host memory instead of device local, for comparison
+-rp - record the frame once per swapchain image and replay it, only camera data is written (needs -b 0, -sm 0, 1, 2, 5 or 6)
+-fc 0 - frustum cull the gbuffer per instance and cluster, the model is split into N clusters (reuses -c clusters)
+-gc 0 - cull the gbuffer on the gpu against the frustum and a depth pyramid of the last frame, N clusters per instance,
+      visible clusters are drawn with vkCmdDrawIndexedIndirectCount (reuses -c clusters)
 ).";
 
 
@@ -68,6 +92,60 @@ void Args::init(int argc, char** argv) {
     } else if(arg == "-b" && argc) {
       next();
       bvh = std::stoi(arg);
+    } else if(arg == "-sm" && argc) {
+      next();
+      shadowMode = ShadowMode(std::stoi(arg));
+    } else if(arg == "-qm") {
+      shadowQuality = true;
+    } else if(arg == "-fb") {
+      fullBarriers = true;
+    } else if(arg == "-na") {
+      aliasing = false;
+    } else if(arg == "-i" && argc) {
+      next();
+      instances = std::max(1, std::stoi(arg));
+    } else if(arg == "-ia" && argc) {
+      next();
+      instanceAnimation = std::stof(arg);
+    } else if(arg == "-c" && argc) {
+      next();
+      clusters = std::max(1, std::stoi(arg));
+    } else if(arg == "-cm") {
+      clusterMedian = true;
+    } else if(arg == "-ts" && argc) {
+      next();
+      splitBudget = std::stof(arg);
+    } else if(arg == "-bc" && argc) {
+      next();
+      bvhCache = arg;
+    } else if(arg == "-rt" && argc) {
+      next();
+      raytracingKHR = arg == "khr";
+    } else if(arg == "-nc") {
+      compaction = false;
+    } else if(arg == "-ct") {
+      compactTop = true;
+    } else if(arg == "-ac") {
+      asyncCompute = true;
+    } else if(arg == "-sh") {
+      sbtHost = true;
+    } else if(arg == "-rp") {
+      replay = true;
+    } else if(arg == "-fc" && argc) {
+      next();
+      frustumClusters = std::max(0, std::stoi(arg));
+    } else if(arg == "-gc" && argc) {
+      next();
+      gpuClusters = std::max(0, std::stoi(arg));
+    } else if(arg == "-hb" && argc) {
+      next();
+      hostBuild = std::max(0, std::stoi(arg));
+    } else if(arg == "-cs" && argc) {
+      next();
+      cacheBits = std::stoi(arg);
+    } else if(arg == "-ca" && argc) {
+      next();
+      cacheAge = std::stoi(arg);
     } else if(arg == "-p" && argc) {
       next();
       int preset = std::stoi(arg);
@@ -3,6 +3,16 @@
 #include <glm/vec3.hpp>
 
 
+enum class ShadowMode {
+  Full,         // one ray per pixel
+  Half,         // one ray per 2x2 block
+  Checkerboard, // one ray per two pixels
+  Temporal,     // reprojected, traces only disoccluded pixels and shadow edges
+  Cache,        // world space visibility cache, traces only cache misses
+  Classified,   // sky and back facing pixels resolved by compute, remaining rays compacted
+  RayQuery      // lighting pass traces inline, no shadow mask and no ray tracing pipeline
+};
+
 struct Args {
 public:
   void init(int argc, char** argv);
@@ -17,4 +27,25 @@ public:
   int bvh = 0;
   glm::vec3 light = glm::vec3(0,10,0);
   std::string log;
+  ShadowMode shadowMode = ShadowMode::Full;
+  bool shadowQuality = false;
+  int cacheBits = 22;
+  int cacheAge = 600;
+  bool fullBarriers = false;
+  bool aliasing = true;
+  int instances = 1;
+  float instanceAnimation = 0;
+  int clusters = 1;
+  bool clusterMedian = false;
+  float splitBudget = 0;
+  std::string bvhCache;
+  bool raytracingKHR = false;
+  int hostBuild = 0;
+  bool compaction = true;
+  bool compactTop = false;
+  bool asyncCompute = false;
+  bool sbtHost = false;
+  bool replay = false;
+  int frustumClusters = 0;
+  int gpuClusters = 0;
 };
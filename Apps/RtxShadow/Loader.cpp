@@ -7,6 +7,7 @@
 
 #include "Assets/MeshBuffer.h"
 #include "NeiVu/Texture.h"
+#include "NeiVu/TransferBuffer.h"
 
 #include <fstream>
 
@@ -48,6 +49,10 @@ ModelData Loader::load(Nei::DeviceContext* dc, fs::path const& path) {
 
   auto vertexLayout = VertexLayout::defaultLayout();
 
+  // textures upload on the transfer queue while the meshes are converted
+  Ptr textureTransfer = new TransferBuffer(dc);
+  textureTransfer->begin();
+
   /* MATERIALS */
   for (uint i = 0; i < scene->mNumMaterials; i++) {
     auto aMat = scene->mMaterials[i];
@@ -74,12 +79,13 @@ ModelData Loader::load(Nei::DeviceContext* dc, fs::path const& path) {
         }
       }
 
-      ret.textures.push_back(NeiApp->getAssetManager()->loadTexture2D(texPath));
+      ret.textures.push_back(NeiApp->getAssetManager()->loadTexture2D(texPath, textureTransfer));
     }
     else {
-      ret.textures.push_back(NeiApp->getAssetManager()->createDummy(uvec2(512)));
+      ret.textures.push_back(NeiApp->getAssetManager()->createDummy(uvec2(512), textureTransfer));
     }
   }
+  textureTransfer->end();
   
   /* MESHES */
 
@@ -115,6 +121,8 @@ ModelData Loader::load(Nei::DeviceContext* dc, fs::path const& path) {
 
     for (uint j = 0; j < vertexCount; j++) {
       vptr->position = toGlm(aMesh->mVertices[j]);
+      ret.boundsMin = min(ret.boundsMin, vptr->position);
+      ret.boundsMax = max(ret.boundsMax, vptr->position);
       if (normals)vptr->normal = toGlm(aMesh->mNormals[j]);
       if (texCoords)vptr->texCoord = toGlm(aMesh->mTextureCoords[0][j]);
       vptr->material = materialId;
@@ -138,7 +146,7 @@ ModelData Loader::load(Nei::DeviceContext* dc, fs::path const& path) {
   meshBuffer->createFromMesh(mesh);
   mesh->setMeshBuffer(meshBuffer);
 
-  dc->wait();
+  textureTransfer->wait();
 
   return ret;
 }
@@ -6,6 +6,8 @@
 struct ModelData {
   Nei::Ptr<Nei::Mesh> mesh;
   std::vector < Nei::Ptr<Nei::Texture2D>> textures;
+  glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
 };
 
 struct Loader {
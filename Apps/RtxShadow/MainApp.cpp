@@ -12,8 +12,22 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
   opt.vsync = false;
 
 #if rtx
+  if(args.hostBuild > 0 && !args.raytracingKHR && args.shadowMode != ShadowMode::RayQuery) {
+    nei_warning("Host builds need KHR acceleration structures, using -rt khr");
+    args.raytracingKHR = true;
+  }
   opt.deviceExtensions.push_back(VK_NV_RAY_TRACING_EXTENSION_NAME);
+  if(args.raytracingKHR) {
+    opt.deviceExtensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+    opt.deviceExtensions.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+  }
+  if(args.shadowMode == ShadowMode::RayQuery) {
+    opt.deviceExtensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+    opt.deviceExtensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+  }
 #endif
+  if(args.gpuClusters > 0)
+    opt.deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 
 #ifdef DEBUG
   opt.validation = true;
@@ -34,8 +48,66 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
   auto& dc = deviceContext;
   Ptr cmd = new CommandBuffer(dc);
 
+  if(args.shadowMode == ShadowMode::RayQuery && !dc->supportsRayQuery()) {
+    nei_error("VK_KHR_ray_query not supported, falling back to full rate shadow mask");
+    args.shadowMode = ShadowMode::Full;
+  }
+  if(args.raytracingKHR && !dc->supportsRaytracingPipeline()) {
+    nei_error("VK_KHR_ray_tracing_pipeline not supported, falling back to VK_NV_ray_tracing");
+    args.raytracingKHR = false;
+  }
+  if(args.gpuClusters > 0 && !dc->supportsMultiDrawIndirect()) {
+    nei_error("multiDrawIndirect or drawIndirectFirstInstance not supported, gbuffer is not culled on the gpu");
+    args.gpuClusters = 0;
+  }
+  if(args.gpuClusters > 0 && !dc->supportsDrawIndirectCount())
+    nei_warning("VK_KHR_draw_indirect_count not supported, culled draws are kept with zero instances");
+  if(args.gpuClusters > 0 && args.frustumClusters > 0) {
+    nei_warning("Gbuffer is culled on the gpu, ignoring -fc");
+    args.frustumClusters = 0;
+  }
+  if(args.shadowMode == ShadowMode::RayQuery && args.shadowQuality) {
+    nei_warning("Shadow quality is not measured with ray queries, there is no shadow mask");
+    args.shadowQuality = false;
+  }
+#if rtx
+  if(args.asyncCompute && dc->getComputeQueueIndex() == MissingQueue) {
+    nei_error("No dedicated compute queue, BVH updates stay on the main queue");
+    args.asyncCompute = false;
+  }
+  // bvh and mesh buffers are used by both queues, no ownership transfers between them
+  if(args.asyncCompute)
+    dc->setConcurrentQueues({dc->getMainQueueIndex(), dc->getComputeQueueIndex()});
+#endif
+
 
   profiler = new Profiler(dc);
+  raysCounter = profiler->addCounter("raysTraced");
+  barriersCounter = profiler->addCounter("barriers");
+  if(args.shadowQuality) {
+    pixelsCounter = profiler->addCounter("pixels");
+    errorCounter = profiler->addCounter("shadowError%", pixelsCounter);
+  }
+  if(args.shadowMode == ShadowMode::Cache) {
+    lookupsCounter = profiler->addCounter("cacheLookups");
+    hitsCounter = profiler->addCounter("cacheHit%", lookupsCounter);
+  }
+  if(args.shadowMode == ShadowMode::Classified) {
+    skippedCounter = profiler->addCounter("raysSkipped");
+    // cosine to workgroup mean direction in 1/100
+    coherenceCounter = profiler->addCounter("rayCoherence%", raysCounter, 0.01);
+  }
+  if(args.instances > 1)
+    uploadsCounter = profiler->addCounter("instancesUploaded");
+  if(args.frustumClusters > 0)
+    visibleCounter = profiler->addCounter("clustersVisible");
+  if(args.gpuClusters > 0) {
+    trianglesCounter = profiler->addCounter("triangles");
+    frustumCulledCounter = profiler->addCounter("frustumCulled%", trianglesCounter);
+    occlusionCulledCounter = profiler->addCounter("occlusionCulled%", trianglesCounter);
+  }
+  if(args.asyncCompute && !profiler->addAsyncQueue(dc->getComputeQueueIndex(), "asyncBVH"))
+    nei_warning("Compute queue has no timestamps, async BVH time is not logged");
   if(!args.log.empty()) {
     profiler->openLog(args.log);
   }
@@ -49,20 +121,68 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
   }
 
   lightPosition = args.light;
+  placeInstances();
+
+  // thin triangles are split only for the bottom levels, gbuffer draws the original mesh
+  raytracingMesh = model.mesh;
+  if(args.splitBudget > 0)
+    raytracingMesh = TriangleSplitter::split(dc, model.mesh, args.splitBudget);
+
+  // one bottom level per cluster instead of one spanning the whole scene
+  std::vector<MeshCluster> clusters;
+  if(args.clusters > 1) {
+    auto method = args.clusterMedian ? MeshPartition::Method::Median : MeshPartition::Method::Sah;
+    clusters = MeshPartition::split(raytracingMesh, args.clusters, method);
+    raytracingMesh->upload();
+    nei_log("{} clusters, surface area {}x of the scene bounds", clusters.size(), MeshPartition::overlap(clusters));
+  }
+
+  // gbuffer draws are culled per cluster, bottom level clusters are reused when they index the drawn mesh
+  int cullClusterCount = args.gpuClusters > 0 ? args.gpuClusters : args.frustumClusters;
+  if(cullClusterCount > 0) {
+    if(raytracingMesh == model.mesh && !clusters.empty()) {
+      drawClusters = clusters;
+    } else {
+      drawClusters = MeshPartition::split(model.mesh, cullClusterCount);
+      model.mesh->upload();
+    }
+    nei_log("{} clusters culled per instance", drawClusters.size());
+  }
+  if(args.replay && cullClusterCount > 0) {
+    nei_warning("Culling data is written while recording, recording every frame");
+    args.replay = false;
+  }
 
 #if rtx
+  if(args.instanceAnimation > 0 && args.bvh == 0) {
+    nei_warning("Moving instances need a top level update, using -b 1");
+    args.bvh = 1;
+  }
+  if(args.replay && (args.bvh != 0 || args.asyncCompute || args.shadowMode == ShadowMode::Temporal ||
+                     args.shadowMode == ShadowMode::Cache)) {
+    nei_warning("Replay needs static geometry and no shadow history (-b 0, not -sm 3 or 4), recording every frame");
+    args.replay = false;
+  }
+
   {
     auto start = std::chrono::high_resolution_clock::now();
     cmd->begin();
-    bvh = new RaytracingBVH(dc);
+    bvh = new RaytracingBVH(dc, args.shadowMode == ShadowMode::RayQuery || args.raytracingKHR
+                                  ? AccelerationStructure::Api::KHR
+                                  : AccelerationStructure::Api::NV);
     bvh->setUpdatable(args.bvh==1 || args.bvh == 2,args.bvh==2);
-    bvh->buildBottom(cmd, model.mesh);
-
-    if(args.bvh == 0) { // compact if static bvh
-      cmd->end();
-      cmd->submit();
-      bvh->compactBottom();
-      cmd->begin();
+    bvh->setFramesInFlight(4);
+    // full rebuilds don't fit into compacted structures
+    bvh->setCompaction(args.compactTop && args.bvh != 3, args.compaction && args.bvh != 3);
+    // cached and host built bottom levels have no device scratch, they are never rebuilt
+    bool staticBottom = args.bvh == 0 || args.bvh == 1;
+    if(!args.bvhCache.empty() && staticBottom) bvh->setCache(args.bvhCache);
+    if(args.hostBuild > 0 && staticBottom) bvh->setHostBuild(getThreadPool(), args.hostBuild);
+    std::vector<int> bottoms;
+    if(clusters.empty()) bottoms.push_back(bvh->buildBottom(cmd, raytracingMesh));
+    for(auto& c : clusters) bottoms.push_back(bvh->buildBottom(cmd, raytracingMesh, c.firstIndex, c.indexCount));
+    for(auto& t : instanceTransforms) {
+      for(auto b : bottoms) bvh->addInstance(b, t);
     }
 
     bvh->buildTop(cmd);
@@ -71,6 +191,11 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
     auto end = std::chrono::high_resolution_clock::now();
 
     nei_log("BVH build time {} ms", std::chrono::duration<double, std::milli>(end - start).count());
+    nei_log("BVH memory {} kB, {} bottom levels", bvh->getMemorySize() / 1024, bvh->getBottomCount());
+
+    if(!args.bvhCache.empty())
+      nei_log("BVH cache {} of {} bottom levels loaded", bvh->getCachedCount(), bvh->getBottomCount());
+    bvhCompacting = true;
   }
 #endif
 
@@ -79,30 +204,135 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
   gbufferPipeline = dc->loadFx(NeiFS->resolve("shaders/gbuffer.fx"));
   gbufferPipeline->addVertexLayout(VertexLayout::defaultLayout());
 #if rtx
-  shadowMaskPipeline = dc->getFxLoader()->loadFxFile(NeiFS->resolve("shaders/shadowmask.fx")).as<RaytracingPipeline>();
-  sbt = shadowMaskPipeline->createShaderBindingTable();
+  if(args.shadowMode != ShadowMode::RayQuery) {
+    if(args.raytracingKHR) dc->getFxLoader()->setRaytracingApi(RaytracingApi::KHR);
+    shadowMaskPipeline = dc->getFxLoader()->loadFxFile(NeiFS->resolve("shaders/shadowmask.fx")).as<RaytracingPipeline>();
+    sbt = shadowMaskPipeline->createShaderBindingTable(args.sbtHost ? CpuOnly : GpuOnly);
+    sbt->setFramesInFlight(4);
+  }
+  if(args.shadowMode != ShadowMode::Full && args.shadowMode != ShadowMode::RayQuery)
+    shadowUpsamplePipeline = dc->loadComp(NeiFS->resolve("shaders/shadowupsample.fx"));
+  if(args.shadowQuality)
+    shadowComparePipeline = dc->loadComp(NeiFS->resolve("shaders/shadowcompare.fx"));
+  if(args.shadowMode == ShadowMode::Temporal) {
+    shadowReprojectPipeline = dc->loadComp(NeiFS->resolve("shaders/shadowreproject.fx"));
+    shadowHistoryPipeline = dc->loadComp(NeiFS->resolve("shaders/shadowhistory.fx"));
+  }
+  if(args.shadowMode == ShadowMode::Cache) {
+    shadowCachePipeline = dc->loadComp(NeiFS->resolve("shaders/shadowcache.fx"));
+    if(args.bvh != 0) nei_warning("Shadow cache expects static geometry (-b 0)");
+  }
+  if(args.shadowMode == ShadowMode::Classified)
+    shadowClassifyPipeline = dc->loadComp(NeiFS->resolve("shaders/shadowclassify.fx"));
 #endif
-  lightingPipeline = dc->loadComp(NeiFS->resolve("shaders/lighting.fx"));
+  if(args.gpuClusters > 0) {
+    gbufferIndirectPipeline = dc->loadFx(NeiFS->resolve("shaders/gbuffer_indirect.fx"));
+    gbufferIndirectPipeline->addVertexLayout(VertexLayout::defaultLayout());
+    cullPipeline = dc->loadComp(NeiFS->resolve("shaders/cull.fx"));
+    hizDepthPipeline = dc->loadComp(NeiFS->resolve("shaders/hizdepth.fx"));
+    hizReducePipeline = dc->loadComp(NeiFS->resolve("shaders/hizreduce.fx"));
+  }
+  if(args.shadowMode == ShadowMode::RayQuery)
+    lightingPipeline = dc->loadComp(NeiFS->resolve("shaders/lighting_rq.fx"));
+  else
+    lightingPipeline = dc->loadComp(NeiFS->resolve("shaders/lighting.fx"));
+
 
+  // transient targets are placed into shared memory once their lifetimes are known
+  MemoryUsage transient = args.aliasing ? Aliased : GpuOnly;
 
   // Gbuffer
   gbuffer = new GBuffer(dc);
   gbuffer->addColorLayer(vk::Format::eR32G32B32A32Sfloat, "gbufferPosition", vk::ImageLayout::eGeneral);
   gbuffer->addColorLayer(vk::Format::eR16G16B16A16Sfloat, "gbufferNormal", vk::ImageLayout::eGeneral);
   gbuffer->addColorLayer(vk::Format::eR8G8B8A8Unorm, "gbufferColor", vk::ImageLayout::eGeneral);
-  gbuffer->addDepthLayer();
+  gbuffer->addDepthLayer(vk::Format::eD32SfloatS8Uint, "GBuffer Depth", vk::ImageLayout::eShaderReadOnlyOptimal,
+                         transient);
   gbuffer->resize(resolution);
 
-  accBuffer = new Texture2D(dc, resolution, vk::Format::eR8G8B8A8Unorm, Texture::Usage::GBuffer, false);
+  accBuffer = new Texture2D(dc, resolution, vk::Format::eR8G8B8A8Unorm, Texture::Usage::GBuffer, false, transient);
+
+  // Shadow Mask, ray queries trace in the lighting pass
+  if(args.shadowMode != ShadowMode::RayQuery)
+    shadowMask = new Texture2D(dc, resolution, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false, transient);
+  if(args.shadowMode == ShadowMode::Half)
+    shadowSparse = new Texture2D(dc, (resolution + 1u) / 2u, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false,
+                                 transient);
+  if(args.shadowMode == ShadowMode::Checkerboard)
+    shadowSparse = new Texture2D(dc, resolution, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false, transient);
+  if(args.shadowQuality)
+    shadowReference = new Texture2D(dc, resolution, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false, transient);
+  if(args.shadowMode == ShadowMode::Temporal) {
+    shadowDepth = new Texture2D(dc, resolution, vk::Format::eR32Sfloat, Texture::Usage::GBuffer, false, transient);
+    shadowHistory = new Texture2D(dc, resolution, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false);
+    depthHistory = new Texture2D(dc, resolution, vk::Format::eR32Sfloat, Texture::Usage::GBuffer, false);
+  }
+
+  if(args.shadowMode == ShadowMode::Cache) {
+    shadowCache = new Buffer(dc, uint((1u << args.cacheBits) * sizeof(uvec2)), Buffer::Storage);
+    shadowCache->setName("ShadowCache");
+    nei_log("Shadow cache {} MB", shadowCache->getSize() >> 20);
+  }
+
+  // header only when no pixel list is used, lists are rebuilt every frame
+  bool pixelList = args.shadowMode == ShadowMode::Temporal || args.shadowMode == ShadowMode::Cache;
+  uint rayListSize = rayListHeaderSize;
+  if(pixelList)
+    rayListSize += resolution.x * resolution.y * sizeof(uint);
+  rayList = new Buffer(dc, rayListSize, Buffer::IndirectStorage, pixelList ? transient : Default);
+
+  // 32 byte ray records
+  bool classified = args.shadowMode == ShadowMode::Classified;
+  uint rayBufferSize = rayListHeaderSize;
+  if(classified)
+    rayBufferSize += resolution.x * resolution.y * 2 * sizeof(vec4);
+  rayBuffer = new Buffer(dc, rayBufferSize, Buffer::IndirectStorage, classified ? transient : Default);
 
-  // Shadow Mask
-  shadowMask = new Texture2D(dc, resolution, vk::Format::eR8Unorm, Texture::Usage::GBuffer, false);
+  if(args.gpuClusters > 0) {
+    hiZ = new Texture2D(dc, max(resolution / 2u, uvec2(1)), vk::Format::eR32Sfloat, Texture::Usage::GBuffer, true);
+    hiZ->setName("HiZ");
+
+    std::vector<GpuCluster> gpuClusters;
+    for(auto& c : drawClusters)
+      gpuClusters.push_back({c.bounds.min, c.firstIndex, c.bounds.max, c.indexCount});
+    clusterBuffer = new Buffer(dc, uint(gpuClusters.size() * sizeof(GpuCluster)), Buffer::Storage);
+    clusterBuffer->setData(gpuClusters.data(), uint(gpuClusters.size() * sizeof(GpuCluster)));
+    clusterBuffer->setName("Clusters");
+
+    uint instancesSize = uint(instanceTransforms.size() * sizeof(mat4));
+    instanceBuffer = new Buffer(dc, instancesSize, Buffer::Storage);
+    instanceBuffer->setData(instanceTransforms.data(), instancesSize);
+    instanceBuffer->setName("Instances");
+    prevInstanceBuffer = new Buffer(dc, instancesSize, Buffer::Storage);
+    prevInstanceBuffer->setData(prevInstanceTransforms.data(), instancesSize);
+    prevInstanceBuffer->setName("PrevInstances");
+
+    uint maxDraws = uint(drawClusters.size() * instanceTransforms.size());
+    drawBuffer = new Buffer(dc, drawHeaderSize + maxDraws * sizeof(vk::DrawIndexedIndirectCommand),
+                            Buffer::IndirectStorage);
+    drawBuffer->setName("Draws");
+    nei_log("{} draws culled on the gpu, {} pyramid levels", maxDraws, hiZ->getMipLevels());
+  }
+
+  buildRenderGraph();
+  if(args.aliasing) allocateTransientMemory();
+  renderGraph->compile();
+
+  auto memory = dc->getMemoryManager();
+  nei_log("Device memory {} MB, peak {} MB", memory->getAllocatedSize() >> 20, memory->getPeakSize() >> 20);
 
   cmd->begin();
-  shadowMask->setLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, shadowMask->getFullRange());
+  for(auto& t : {shadowMask, shadowSparse, shadowReference, shadowDepth, shadowHistory, depthHistory, hiZ}) {
+    if(t) t->setLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, t->getFullRange());
+  }
+  if(shadowCache) (**cmd).fillBuffer(*shadowCache, 0, VK_WHOLE_SIZE, 0);
   cmd->end();
   cmd->submit();
 
+  // one region per command buffer slot, replayed frames use slot 4 + swapchain image
+  int frameSlots = 4 + (args.replay ? int(swapchain->getImageCount()) : 0);
+  uniforms = new UniformRing(dc, 64 * 1024, frameSlots);
+
   //Descriptors
   gbufferDescriptor = gbufferPipeline->allocateDescriptorSet();
   std::vector<vk::ImageView> views;
@@ -111,24 +341,298 @@ MainApp::MainApp(int argc, char** argv): SimpleApplication(nullptr) {
   gbufferDescriptor->update(0, views, dc->getSampler(SamplerType::linearRepeat));
 
 
-  lightingDescriptor = lightingPipeline->allocateDescriptorSet();
-  lightingDescriptor->update(0, accBuffer->createView());
-  lightingDescriptor->update(1, gbuffer->getLayer(0)->createView());
-  lightingDescriptor->update(2, gbuffer->getLayer(1)->createView());
-  lightingDescriptor->update(3, gbuffer->getLayer(2)->createView());
-  lightingDescriptor->update(4, shadowMask->createView());
+  // sets holding the top level are kept per frame slot, a slot rewrites them once its frame has finished
+  for(auto& lightingDescriptor : lightingDescriptors) {
+    lightingDescriptor = lightingPipeline->allocateDescriptorSet();
+    lightingDescriptor->update(0, accBuffer->createView());
+    lightingDescriptor->update(1, gbuffer->getLayer(0)->createView());
+    lightingDescriptor->update(2, gbuffer->getLayer(1)->createView());
+    lightingDescriptor->update(3, gbuffer->getLayer(2)->createView());
+#if rtx
+    if(args.shadowMode != ShadowMode::RayQuery)
+      lightingDescriptor->update(4, shadowMask->createView());
+    else
+      lightingDescriptor->update(5, profiler->getCounterBuffer());
+#else
+    lightingDescriptor->update(4, shadowMask->createView());
+#endif
+  }
 
 #if rtx
-  shadowMaskDescriptor = shadowMaskPipeline->allocateDescriptorSet();
-  shadowMaskDescriptor->update(0, shadowMask->createView());
-  shadowMaskDescriptor->update(1, bvh->getTop());
-  shadowMaskDescriptor->update(2, gbuffer->getLayer(0)->createView());
+  if(shadowMaskPipeline) {
+    for(auto& shadowMaskDescriptor : shadowMaskDescriptors) {
+      shadowMaskDescriptor = shadowMaskPipeline->allocateDescriptorSet();
+      shadowMaskDescriptor->update(0, (shadowSparse ? shadowSparse : shadowMask)->createView());
+      shadowMaskDescriptor->update(2, gbuffer->getLayer(0)->createView());
+      shadowMaskDescriptor->update(3, rayList);
+      shadowMaskDescriptor->update(4, rayBuffer);
+    }
+  }
+
+  if(shadowUpsamplePipeline) {
+    shadowUpsampleDescriptor = shadowUpsamplePipeline->allocateDescriptorSet();
+    shadowUpsampleDescriptor->update(0, shadowMask->createView());
+    shadowUpsampleDescriptor->update(1, shadowSparse->createView());
+    shadowUpsampleDescriptor->update(2, gbuffer->getLayer(0)->createView());
+    shadowUpsampleDescriptor->update(3, gbuffer->getLayer(1)->createView());
+  }
+
+  if(args.shadowQuality) {
+    for(auto& shadowReferenceDescriptor : shadowReferenceDescriptors) {
+      shadowReferenceDescriptor = shadowMaskPipeline->allocateDescriptorSet();
+      shadowReferenceDescriptor->update(0, shadowReference->createView());
+      shadowReferenceDescriptor->update(2, gbuffer->getLayer(0)->createView());
+      shadowReferenceDescriptor->update(3, rayList);
+      shadowReferenceDescriptor->update(4, rayBuffer);
+    }
+
+    shadowCompareDescriptor = shadowComparePipeline->allocateDescriptorSet();
+    shadowCompareDescriptor->update(0, shadowMask->createView());
+    shadowCompareDescriptor->update(1, shadowReference->createView());
+    shadowCompareDescriptor->update(2, profiler->getCounterBuffer());
+  }
+
+  if(args.shadowMode == ShadowMode::Temporal) {
+    shadowReprojectDescriptor = shadowReprojectPipeline->allocateDescriptorSet();
+    shadowReprojectDescriptor->update(0, uniforms, sizeof(TemporalData));
+    shadowReprojectDescriptor->update(1, shadowMask->createView());
+    shadowReprojectDescriptor->update(2, shadowDepth->createView());
+    shadowReprojectDescriptor->update(3, shadowHistory->createView());
+    shadowReprojectDescriptor->update(4, depthHistory->createView());
+    shadowReprojectDescriptor->update(5, gbuffer->getLayer(0)->createView());
+    shadowReprojectDescriptor->update(6, rayList);
+    shadowReprojectDescriptor->update(7, profiler->getCounterBuffer());
+
+    shadowHistoryDescriptor = shadowHistoryPipeline->allocateDescriptorSet();
+    shadowHistoryDescriptor->update(0, shadowMask->createView());
+    shadowHistoryDescriptor->update(1, shadowDepth->createView());
+    shadowHistoryDescriptor->update(2, shadowHistory->createView());
+    shadowHistoryDescriptor->update(3, depthHistory->createView());
+  }
+
+  if(args.shadowMode == ShadowMode::Cache) {
+    shadowCacheDescriptor = shadowCachePipeline->allocateDescriptorSet();
+    shadowCacheDescriptor->update(0, shadowMask->createView());
+    shadowCacheDescriptor->update(1, gbuffer->getLayer(0)->createView());
+    shadowCacheDescriptor->update(2, gbuffer->getLayer(1)->createView());
+    shadowCacheDescriptor->update(3, shadowCache);
+    shadowCacheDescriptor->update(4, rayList);
+    shadowCacheDescriptor->update(5, profiler->getCounterBuffer());
+  }
+
+  if(args.shadowMode == ShadowMode::Classified) {
+    shadowClassifyDescriptor = shadowClassifyPipeline->allocateDescriptorSet();
+    shadowClassifyDescriptor->update(0, shadowMask->createView());
+    shadowClassifyDescriptor->update(1, gbuffer->getLayer(0)->createView());
+    shadowClassifyDescriptor->update(2, gbuffer->getLayer(1)->createView());
+    shadowClassifyDescriptor->update(3, rayBuffer);
+    shadowClassifyDescriptor->update(4, profiler->getCounterBuffer());
+  }
+
+  for(int slot = 0; slot < 4; slot++) updateBvhDescriptors(slot);
 #endif
 
+  gbufferFrameDescriptor = gbufferPipeline->allocateDescriptorSet(1);
+  gbufferFrameDescriptor->update(0, uniforms, sizeof(FrameData));
+  lightingFrameDescriptor = lightingPipeline->allocateDescriptorSet(1);
+  lightingFrameDescriptor->update(0, uniforms, sizeof(FrameData));
+
+  if(args.gpuClusters > 0) {
+    gbufferIndirectDescriptor = gbufferIndirectPipeline->allocateDescriptorSet();
+    gbufferIndirectDescriptor->update(0, views, dc->getSampler(SamplerType::linearRepeat));
+    gbufferIndirectDescriptor->update(1, instanceBuffer);
+    gbufferIndirectFrameDescriptor = gbufferIndirectPipeline->allocateDescriptorSet(1);
+    gbufferIndirectFrameDescriptor->update(0, uniforms, sizeof(FrameData));
+
+    cullDescriptor = cullPipeline->allocateDescriptorSet();
+    cullDescriptor->update(0, uniforms, sizeof(CullData));
+    cullDescriptor->update(1, clusterBuffer);
+    cullDescriptor->update(2, instanceBuffer);
+    cullDescriptor->update(3, drawBuffer);
+    cullDescriptor->update(4, hiZ->createView(), dc->getSampler(SamplerType::nearestEdge));
+    cullDescriptor->update(5, profiler->getCounterBuffer());
+    cullDescriptor->update(6, prevInstanceBuffer);
+
+    hizDepthDescriptor = hizDepthPipeline->allocateDescriptorSet();
+    hizDepthDescriptor->update(0, gbuffer->getLayer(0)->createView());
+    hizDepthDescriptor->update(1, gbuffer->getLayer(1)->createView());
+    hizDepthDescriptor->update(2, hiZ->createView(vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    for(int level = 1; level < hiZ->getMipLevels(); level++) {
+      auto descriptor = hizReducePipeline->allocateDescriptorSet();
+      descriptor->update(0, hiZ->createView(vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor, 0, 1, level - 1, 1));
+      descriptor->update(1, hiZ->createView(vk::ImageViewType::e2D, vk::ImageAspectFlagBits::eColor, 0, 1, level, 1));
+      hizReduceDescriptors.push_back(descriptor);
+    }
+  }
+
+  replayBuffers.resize(args.replay ? swapchain->getImageCount() : 0);
+
   commandBuffers[0] = new CommandBuffer(dc);
   commandBuffers[1] = new CommandBuffer(dc);
   commandBuffers[2] = new CommandBuffer(dc);
   commandBuffers[3] = new CommandBuffer(dc);
+
+  if(args.asyncCompute) {
+    auto device = dc->getVkDevice();
+    for(int i = 0; i < 4; i++) {
+      bvhCommandBuffers[i] = new CommandBuffer(dc, true, dc->getComputeQueueIndex());
+      bvhReady[i] = device.createSemaphore(vk::SemaphoreCreateInfo());
+      frameDone[i] = device.createSemaphore(vk::SemaphoreCreateInfo());
+    }
+  }
+}
+
+MainApp::~MainApp() {
+  if(!args.asyncCompute) return;
+  deviceContext->wait();
+  auto device = deviceContext->getVkDevice();
+  for(int i = 0; i < 4; i++) {
+    device.destroySemaphore(bvhReady[i]);
+    device.destroySemaphore(frameDone[i]);
+  }
+}
+
+// top level handle changes when it is compacted
+void MainApp::updateBvhDescriptors(int slot) {
+  if(args.shadowMode == ShadowMode::RayQuery) lightingDescriptors[slot]->update(4, bvh->getTop());
+  if(shadowMaskDescriptors[slot]) shadowMaskDescriptors[slot]->update(1, bvh->getTop());
+  if(shadowReferenceDescriptors[slot]) shadowReferenceDescriptors[slot]->update(1, bvh->getTop());
+}
+
+mat4 MainApp::getViewProjection() {
+#ifdef fly
+  if(!args.flythrough.empty()) {
+    float t = args.frames > 0
+                ? max<float>(0, (frame.frameId - skipFrames) / float(args.frames) / float(args.avgFrames))
+                : float(frame.simTime / 60.);
+    CameraPathKeypoint const kp = cameraPath.getKeypoint(t);
+    glm::mat4 const viewMat = glm::lookAt(kp.position, kp.position + kp.viewVector, kp.upVector);
+    return camera->getProjection() * viewMat;
+  }
+#endif
+  return camera->getProjection() * camera->getView();
+}
+
+ivec3 MainApp::getShadowLaunchSize(ShadowMode mode) const {
+  switch(mode) {
+    case ShadowMode::Half:
+      return ivec3((resolution + 1u) / 2u, 1);
+    case ShadowMode::Checkerboard:
+      return ivec3((resolution.x + 1) / 2, resolution.y, 1);
+    default: // pixel lists without indirect trace, conservative as the ray count is known only on gpu
+      return ivec3(resolution, 1);
+  }
+}
+
+// empty list, also the indirect trace and dispatch command. The graph orders it before the compute pass
+void MainApp::resetRayHeader(CommandBuffer* cmd, Buffer* buffer) {
+  uint header[8] = {0, 1, 1, 0, 1, 1, 0, 0};
+  buffer->setDataInline(cmd, header, sizeof(header));
+}
+
+// reuses last frame mask where reprojection succeeds, other pixels are written to rayList
+void MainApp::reprojectShadows(CommandBuffer* cmd, mat4 const& vp) {
+  TemporalData temporal;
+  temporal.vp = vp;
+  temporal.prevVP = prevViewProjection;
+  temporal.params = ivec4(frame.frameId, historyValid, temporalRefresh, raysCounter);
+
+  cmd->bind(shadowReprojectPipeline);
+  shadowReprojectPipeline->setUniform(cmd, uniforms, shadowReprojectDescriptor, 0, temporal);
+  cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+}
+
+// pass 0 - resolves cache hits and lists misses, pass 1 - stores traced misses
+void MainApp::lookupShadowCache(CommandBuffer* cmd, mat4 const& vp, int pass) {
+  mat4 view = inverse(camera->getProjection()) * vp;
+
+  CacheConstants constants;
+  constants.camPos = vec3(inverse(view)[3]);
+  constants.pixelScale = 2 * tan(radians(camera->getFov().y) * 0.5f) / resolution.y * cacheCellPixels;
+  constants.frame = frame.frameId;
+  constants.maxAge = args.cacheAge;
+  constants.tableMask = (1u << args.cacheBits) - 1;
+  constants.pass = pass;
+  constants.lookupsCounter = lookupsCounter;
+  constants.raysCounter = raysCounter;
+
+  cmd->bind(shadowCachePipeline);
+  cmd->bind(shadowCacheDescriptor);
+  shadowCachePipeline->setConstants(cmd, constants, 0, vk::ShaderStageFlagBits::eCompute);
+  if(pass == 0)
+    cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+  else
+    cmd->dispatchIndirect(rayList, 3 * sizeof(uint));
+}
+
+// resolves sky and back facing pixels, remaining rays are compacted in morton order per 8x8 tile
+void MainApp::classifyShadowRays(CommandBuffer* cmd) {
+  ClassifyConstants constants;
+  constants.lightPosition = lightPosition;
+  constants.raysCounter = raysCounter;
+  constants.skippedCounter = skippedCounter;
+  constants.coherenceCounter = coherenceCounter;
+
+  cmd->bind(shadowClassifyPipeline);
+  cmd->bind(shadowClassifyDescriptor);
+  shadowClassifyPipeline->setConstants(cmd, constants, 0, vk::ShaderStageFlagBits::eCompute);
+  cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+}
+
+void MainApp::traceShadows(CommandBuffer* cmd, DescriptorSet* descriptor, ShadowMode mode) {
+  cmd->bind(shadowMaskPipeline);
+  cmd->bind(descriptor);
+  ShadowConstants constants = {lightPosition, int(mode)};
+  shadowMaskPipeline->setConstants(cmd, constants, 0, vk::ShaderStageFlagBits::eRaygenNV);
+  // khr launches pixel and ray lists with the count written by the gpu, the list header is the indirect command
+  bool indirect = sbt->getApi() == RaytracingApi::KHR && deviceContext->supportsTraceRaysIndirect();
+  if(indirect && (mode == ShadowMode::Temporal || mode == ShadowMode::Cache))
+    cmd->raytraceIndirect(sbt, rayList);
+  else if(indirect && mode == ShadowMode::Classified)
+    cmd->raytraceIndirect(sbt, rayBuffer);
+  else
+    cmd->raytrace(sbt, getShadowLaunchSize(mode));
+}
+
+// counts pixels which differ from the full rate reference mask
+void MainApp::measureShadowQuality(CommandBuffer* cmd) {
+  ProfileGPU(cmd, "ShadowQuality");
+  cmd->bind(shadowComparePipeline);
+  cmd->bind(shadowCompareDescriptor);
+  shadowComparePipeline->setConstants(cmd, errorCounter, 0, vk::ShaderStageFlagBits::eCompute);
+  cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+  profiler->setCounter(cmd, pixelsCounter, resolution.x * resolution.y);
+}
+
+// grid of model copies, first instance stays at the origin
+void MainApp::placeInstances() {
+  vec3 extent = model.boundsMax - model.boundsMin;
+  int side = int(ceil(sqrt(float(args.instances))));
+  for(int i = 0; i < args.instances; i++) {
+    vec3 offset = vec3(i % side, 0, i / side) * extent * 1.1f;
+    instanceOffsets.push_back(offset);
+    instanceTransforms.push_back(translate(mat4(1), offset));
+  }
+  prevInstanceTransforms = instanceTransforms;
+  if(args.instances > 1)
+    nei_log("{} instances in {}x{} grid", args.instances, side, (args.instances + side - 1) / side);
+}
+
+// last instances rotate around their center, the rest keeps its transform and is not uploaded
+void MainApp::animateInstances(int frameId) {
+  int count = int(round(args.instanceAnimation * args.instances));
+  vec3 center = (model.boundsMin + model.boundsMax) * 0.5f;
+  for(int i = args.instances - count; i < args.instances; i++) {
+    prevInstanceTransforms[i] = instanceTransforms[i];
+    float angle = frameId * 0.01f + i;
+    instanceTransforms[i] = translate(mat4(1), instanceOffsets[i] + center) * rotate(mat4(1), angle, vec3(0, 1, 0)) *
+      translate(mat4(1), -center);
+#if rtx
+    // every cluster of the model is a separate top level instance
+    int bottoms = bvh->getBottomCount();
+    for(int b = 0; b < bottoms; b++) bvh->setTransform(i * bottoms + b, instanceTransforms[i]);
+#endif
+  }
 }
 
 void MainApp::update(Nei::AppFrame const& frame) {
@@ -136,113 +640,490 @@ void MainApp::update(Nei::AppFrame const& frame) {
 
   if(args.frames > 0 && (frame.frameId - skipFrames) > args.frames * args.avgFrames) {
     profiler->finish();
+    ObjectPool::logStats();
     quit();
   }
 }
 
-void MainApp::draw() {
-  if(window->isClosed()) return;
-  if(!swapchain->isValid()) return;
+// passes are recorded in this order every frame, barriers between them are derived from the declared usage
+void MainApp::buildRenderGraph() {
+  using Access = RenderGraph::Access;
 
-  auto& cmd = commandBuffers[currentFrame];
-  currentFrame = (currentFrame + 1) % 4;
-  cmd->wait();
+  renderGraph = new RenderGraph(deviceContext);
+  renderGraph->setFullBarriers(args.fullBarriers);
+  for(Texture* t : {accBuffer, gbuffer->getDepthLayer(), shadowMask, shadowSparse, shadowReference, shadowDepth}) {
+    if(t) renderGraph->setTransient(t);
+  }
 
-  Scope frameScope(swapchain);
-  {
-    Scope commandScope(cmd);
+  Texture* position = gbuffer->getLayer(0);
+  Texture* normal = gbuffer->getLayer(1);
+  Texture* color = gbuffer->getLayer(2);
 
-    profiler->beginFrame(cmd, frame.frameId - skipFrames);
+  auto marker = [this]() {
+    renderGraph->addPass("Marker", [this](CommandBuffer* cmd) { profiler->writeMarker(cmd); });
+  };
+
+  marker();
 
-    profiler->writeMarker(cmd);
-    {
-      ProfileGPU(cmd, "BVH update");
 #if rtx
-      if(args.bvh==1)
-        bvh->updateTop(cmd);
-      if(args.bvh==2) {
-        bvh->updateBottom(cmd);
-        bvh->updateTop(cmd);
-      }
-      if (args.bvh == 3) {
-        bvh->rebuildBottom(cmd);
-        bvh->rebuildTop(cmd);
-    }
-      cmd->debugBarrier();
+  // async updates are recorded into the compute queue command buffer in draw
+  if(!args.asyncCompute) {
+    auto& bvhPass = renderGraph->addPass("BVH", [this](CommandBuffer* cmd) {
+      ProfileGPU(cmd, "BVH update");
+      updateBvh(cmd);
+    });
+    // compaction of static levels rebuilds the top level once
+    if(args.bvh != 0 || args.compaction || args.compactTop)
+      bvhPass.use(bvh->getTop(), Access::AccelerationStructureBuild);
+  }
 #endif
+
+  marker();
+
+  // culling is timed with the gbuffer pass
+  if(args.gpuClusters > 0) {
+    auto& uploadPass = renderGraph->addPass("CullUpload", [this](CommandBuffer* cmd) { uploadCullData(cmd); })
+      .use(drawBuffer, Access::TransferWrite);
+    if(args.instanceAnimation > 0) {
+      uploadPass.use(instanceBuffer, Access::TransferWrite)
+        .use(prevInstanceBuffer, Access::TransferWrite);
     }
 
-    profiler->writeMarker(cmd);
+    renderGraph->addPass("Cull", [this](CommandBuffer* cmd) { cullClustersGpu(cmd); })
+      .use(drawBuffer, Access::ComputeWrite)
+      .use(clusterBuffer, Access::ComputeRead)
+      .use(instanceBuffer, Access::ComputeRead)
+      .use(prevInstanceBuffer, Access::ComputeRead)
+      .use(hiZ, Access::ComputeRead);
+  }
 
-    {
+  auto& gbufferPass = renderGraph->addPass("GBuffer", [this](CommandBuffer* cmd) {
       ProfileGPU(cmd, "GBuffer");
+      Scope renderPass(gbuffer, cmd);
+      if(gbufferIndirectPipeline) {
+        cmd->bind(gbufferIndirectPipeline);
+        cmd->bind(gbufferIndirectDescriptor);
+        gbufferIndirectPipeline->bindDynamic(cmd, gbufferIndirectFrameDescriptor, 1, {frameDataOffset});
+        model.mesh->bind(cmd);
+        uint maxDraws = uint(drawClusters.size() * instanceTransforms.size());
+        if(deviceContext->supportsDrawIndirectCount())
+          cmd->drawIndexedIndirectCount(drawBuffer, drawHeaderSize, drawBuffer, 0, maxDraws);
+        else
+          cmd->drawIndexedIndirect(drawBuffer, drawHeaderSize, maxDraws);
+        return;
+      }
+      cmd->bind(gbufferPipeline);
+      cmd->bind(gbufferDescriptor);
+      gbufferPipeline->bindDynamic(cmd, gbufferFrameDescriptor, 1, {frameDataOffset});
+      if(args.frustumClusters > 0) {
+        for(size_t i = 0; i < instanceTransforms.size(); i++) {
+          uint first = visibleBegin[i];
+          uint count = visibleBegin[i + 1] - first;
+          if(count == 0) continue;
+          gbufferPipeline->setConstants(cmd, instanceTransforms[i], 0, vk::ShaderStageFlagBits::eVertex);
+          model.mesh->draw(cmd, drawClusters, visibleClusters.data() + first, count);
+        }
+        return;
+      }
+      for(auto& t : instanceTransforms) {
+        gbufferPipeline->setConstants(cmd, t, 0, vk::ShaderStageFlagBits::eVertex);
+        model.mesh->draw(cmd);
+      }
+    })
+    .use(position, Access::ColorAttachment)
+    .use(normal, Access::ColorAttachment)
+    .use(color, Access::ColorAttachment)
+    .use(gbuffer->getDepthLayer(), Access::DepthAttachment, vk::ImageLayout::eShaderReadOnlyOptimal);
 
-      {
-        Scope renderPass(gbuffer, cmd);
-        cmd->bind(gbufferPipeline);
+  if(args.gpuClusters > 0) {
+    gbufferPass.use(drawBuffer, Access::IndirectRead).use(instanceBuffer, Access::VertexRead);
 
-        mat4 vp;
-#ifdef fly
-        if(!args.flythrough.empty()) {
-            if (args.frames > 0) {
-                CameraPathKeypoint const kp = cameraPath.getKeypoint(max<float>(0, (frame.frameId - skipFrames)/float(args.frames) / float(args.avgFrames)));
-                glm::mat4 const viewMat = glm::lookAt(kp.position, kp.position + kp.viewVector, kp.upVector);
-                vp = camera->getProjection() * viewMat;
-            }
-            else{
-              CameraPathKeypoint const kp = cameraPath.getKeypoint(float(frame.simTime/60.));
-              glm::mat4 const viewMat = glm::lookAt(kp.position, kp.position + kp.viewVector, kp.upVector);
-              vp = camera->getProjection() * viewMat;
-            }
-        } else {
-          vp = camera->getProjection() * camera->getView();
-        }
+    // depth pyramid for the occlusion test of the next frame
+    renderGraph->addPass("HiZ", [this](CommandBuffer* cmd) { buildHiZ(cmd); })
+      .use(position, Access::ComputeRead)
+      .use(normal, Access::ComputeRead)
+      .use(hiZ, Access::ComputeWrite);
+  }
+
+  marker();
+
+#if rtx
+  if(args.shadowMode == ShadowMode::Temporal) {
+    renderGraph->addPass("ShadowReprojectClear", [this](CommandBuffer* cmd) { resetRayHeader(cmd, rayList); })
+      .use(rayList, Access::TransferWrite);
+    renderGraph->addPass("ShadowReproject", [this](CommandBuffer* cmd) { reprojectShadows(cmd, viewProjection); })
+      .use(rayList, Access::ComputeWrite)
+      .use(position, Access::ComputeRead)
+      .use(shadowHistory, Access::ComputeRead)
+      .use(depthHistory, Access::ComputeRead)
+      .use(shadowMask, Access::ComputeWrite)
+      .use(shadowDepth, Access::ComputeWrite);
+  }
+  if(args.shadowMode == ShadowMode::Cache) {
+    renderGraph->addPass("ShadowCacheClear", [this](CommandBuffer* cmd) { resetRayHeader(cmd, rayList); })
+      .use(rayList, Access::TransferWrite);
+    renderGraph->addPass("ShadowCacheLookup", [this](CommandBuffer* cmd) { lookupShadowCache(cmd, viewProjection, 0); })
+      .use(rayList, Access::ComputeWrite)
+      .use(shadowCache, Access::ComputeWrite)
+      .use(position, Access::ComputeRead)
+      .use(normal, Access::ComputeRead)
+      .use(shadowMask, Access::ComputeWrite);
+  }
+  if(args.shadowMode == ShadowMode::Classified) {
+    renderGraph->addPass("ShadowClassifyClear", [this](CommandBuffer* cmd) { resetRayHeader(cmd, rayBuffer); })
+      .use(rayBuffer, Access::TransferWrite);
+    renderGraph->addPass("ShadowClassify", [this](CommandBuffer* cmd) { classifyShadowRays(cmd); })
+      .use(rayBuffer, Access::ComputeWrite)
+      .use(position, Access::ComputeRead)
+      .use(normal, Access::ComputeRead)
+      .use(shadowMask, Access::ComputeWrite);
+  }
+
+  if(args.shadowMode != ShadowMode::RayQuery) {
+    renderGraph->addPass("ShadowMask", [this](CommandBuffer* cmd) {
+        ProfileGPU(cmd, "ShadowMask");
+        traceShadows(cmd, shadowMaskDescriptors[descriptorSlot], args.shadowMode);
+      })
+      .use(shadowSparse ? shadowSparse : shadowMask, Access::RaytracingWrite)
+      .use(position, Access::RaytracingRead)
+      .use(bvh->getTop(), Access::RaytracingRead)
+      .use(rayList, Access::IndirectRead)
+      .use(rayList, Access::RaytracingRead)
+      .use(rayBuffer, Access::IndirectRead)
+      .use(rayBuffer, Access::RaytracingRead);
+  }
+
+  if(shadowUpsamplePipeline) {
+    renderGraph->addPass("ShadowUpsample", [this](CommandBuffer* cmd) {
+        cmd->bind(shadowUpsamplePipeline);
+        cmd->bind(shadowUpsampleDescriptor);
+        shadowUpsamplePipeline->setConstants(cmd, int(args.shadowMode), 0, vk::ShaderStageFlagBits::eCompute);
+        cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+      })
+      .use(shadowSparse, Access::ComputeRead)
+      .use(position, Access::ComputeRead)
+      .use(normal, Access::ComputeRead)
+      .use(shadowMask, Access::ComputeWrite);
+  }
+
+  if(args.shadowMode == ShadowMode::Temporal) {
+    renderGraph->addPass("ShadowHistory", [this](CommandBuffer* cmd) {
+        cmd->bind(shadowHistoryPipeline);
+        cmd->bind(shadowHistoryDescriptor);
+        cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+      })
+      .use(shadowMask, Access::ComputeRead)
+      .use(shadowDepth, Access::ComputeRead)
+      .use(shadowHistory, Access::ComputeWrite)
+      .use(depthHistory, Access::ComputeWrite);
+  }
+  if(args.shadowMode == ShadowMode::Cache) {
+    renderGraph->addPass("ShadowCacheInsert", [this](CommandBuffer* cmd) { lookupShadowCache(cmd, viewProjection, 1); })
+      .use(rayList, Access::IndirectRead)
+      .use(rayList, Access::ComputeRead)
+      .use(shadowMask, Access::ComputeRead)
+      .use(position, Access::ComputeRead)
+      .use(normal, Access::ComputeRead)
+      .use(shadowCache, Access::ComputeWrite);
+  }
+#endif
+
+  marker();
+
+  auto& lightingPass = renderGraph->addPass("Lighting", [this](CommandBuffer* cmd) {
+      ProfileGPU(cmd, "Lighting");
+      cmd->bind(lightingPipeline);
+      cmd->bind(lightingDescriptors[descriptorSlot]);
+      lightingPipeline->bindDynamic(cmd, lightingFrameDescriptor, 1, {frameDataOffset});
+      if(args.shadowMode == ShadowMode::RayQuery)
+        lightingPipeline->setConstants(cmd, uint(raysCounter), 0, vk::ShaderStageFlagBits::eCompute);
+      cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
+    })
+    .use(accBuffer, Access::ComputeWrite)
+    .use(position, Access::ComputeRead)
+    .use(normal, Access::ComputeRead)
+    .use(color, Access::ComputeRead);
+#if rtx
+  if(args.shadowMode == ShadowMode::RayQuery)
+    lightingPass.use(bvh->getTop(), Access::ComputeRead);
+  else
+    lightingPass.use(shadowMask, Access::ComputeRead);
 #else
-        vp = camera->getProjection() * camera->getView();
+  lightingPass.use(shadowMask, Access::ComputeRead);
 #endif
 
-        gbufferPipeline->setConstants(cmd, vp, 0, vk::ShaderStageFlagBits::eVertex);
+  marker();
 
-        cmd->bind(gbufferDescriptor);
-        model.mesh->draw(cmd);
-      }
-    }
+  renderGraph->addPass("Copy", [this](CommandBuffer* cmd) { swapchain->copy(cmd, accBuffer); })
+    .use(accBuffer, Access::TransferRead);
 
-    profiler->writeMarker(cmd);
+  marker();
 
 #if rtx
-    {
-      ProfileGPU(cmd, "ShadowMask");
-      cmd->bind(shadowMaskPipeline);
-      cmd->bind(shadowMaskDescriptor);
-      shadowMaskPipeline->setConstants(cmd, lightPosition, 0, vk::ShaderStageFlagBits::eRaygenNV);
-      cmd->raytrace(sbt, ivec3(resolution, 1));
-      cmd->debugBarrier();
+  if(args.shadowQuality) {
+    renderGraph->addPass("ShadowReference", [this](CommandBuffer* cmd) {
+        traceShadows(cmd, shadowReferenceDescriptors[descriptorSlot], ShadowMode::Full);
+      })
+      .use(shadowReference, Access::RaytracingWrite)
+      .use(position, Access::RaytracingRead)
+      .use(bvh->getTop(), Access::RaytracingRead);
+
+    renderGraph->addPass("ShadowCompare", [this](CommandBuffer* cmd) { measureShadowQuality(cmd); })
+      .use(shadowMask, Access::ComputeRead)
+      .use(shadowReference, Access::ComputeRead);
+  }
+#endif
+
+  renderGraph->addPass("Counters", [this](CommandBuffer* cmd) {
+    // ray queries count the rays they trace
+    if(args.shadowMode < ShadowMode::Temporal) {
+      auto launchSize = getShadowLaunchSize(args.shadowMode);
+      profiler->setCounter(cmd, raysCounter, launchSize.x * launchSize.y);
     }
+    profiler->setCounter(cmd, barriersCounter, renderGraph->getBarrierCount());
+#if rtx
+    if(uploadsCounter >= 0) profiler->setCounter(cmd, uploadsCounter, bvh->getUploadedCount());
 #endif
+    if(visibleCounter >= 0) profiler->setCounter(cmd, visibleCounter, uint(visibleClusters.size()));
+    if(trianglesCounter >= 0)
+      profiler->setCounter(cmd, trianglesCounter, uint(instanceTransforms.size()) * (model.mesh->getIndexCount() / 3));
+  });
+}
 
-    profiler->writeMarker(cmd);
+#if rtx
+void MainApp::updateBvh(CommandBuffer* cmd) {
+  if(bvh->compact(cmd)) std::fill(std::begin(bvhDescriptorsDirty), std::end(bvhDescriptorsDirty), true);
+  if(args.bvh == 1)
+    bvh->updateTop(cmd);
+  if(args.bvh == 2) {
+    bvh->updateBottom(cmd);
+    bvh->updateTop(cmd);
+  }
+  if(args.bvh == 3) {
+    bvh->rebuildBottom(cmd);
+    bvh->rebuildTop(cmd);
+  }
+}
 
-    {
-      ProfileGPU(cmd, "Lighting");
-      accBuffer->setLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, accBuffer->getFullRange());
-      cmd->bind(lightingPipeline);
-      lightingPipeline->setConstants(cmd, lightPosition, 0, vk::ShaderStageFlagBits::eCompute);
-      lightingPipeline->setConstants(cmd, manipulator->getEye(), sizeof(vec4), vk::ShaderStageFlagBits::eCompute);
+// bvh work of this frame overlaps the gbuffer pass, the main queue waits for it only where rays are traced.
+// the update waits for the previous frame, it still traces against the structures being rewritten
+void MainApp::submitAsync(CommandBuffer* cmd, CommandBuffer* bvhCmd, int slot) {
+  {
+    Scope commandScope(bvhCmd);
+    profiler->beginAsync(bvhCmd);
+    updateBvh(bvhCmd);
+    profiler->endAsync(bvhCmd);
+  }
+  std::vector<vk::Semaphore> wait;
+  std::vector<vk::PipelineStageFlags> waitStages;
+  if(previousFrameDone >= 0) {
+    wait.push_back(frameDone[previousFrameDone]);
+    waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+  }
+  bvhCmd->submit(wait, {bvhReady[slot]}, waitStages);
 
-      cmd->bind(lightingDescriptor);
-      cmd->dispatch(uvec3((resolution.x + 7) / 8, (resolution.y + 7) / 8, 1));
-      accBuffer->setLayout(cmd, vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal,
-        accBuffer->getFullRange());
-      cmd->debugBarrier();
-    }
+  // ray tracing pipeline and ray queries in compute passes
+  auto traceStages = vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader;
+  cmd->submit(swapchain, {bvhReady[slot]}, {frameDone[slot]}, {traceStages});
+  previousFrameDone = slot;
+}
+#endif
+
+// targets created with Aliased memory share one allocation when their passes don't overlap
+void MainApp::allocateTransientMemory() {
+  transientMemory = new TransientMemory(deviceContext);
+  for(Texture* t : {accBuffer, gbuffer->getDepthLayer(), shadowMask, shadowSparse, shadowReference, shadowDepth}) {
+    if(t) transientMemory->add(t, renderGraph->getLifetime(t));
+  }
+  for(Buffer* b : {rayList.get(), rayBuffer.get()}) {
+    if(b->getMemoryType() == Aliased) transientMemory->add(b, renderGraph->getLifetime(b));
+  }
+  transientMemory->allocate();
+
+  for(auto& [a, b] : transientMemory->getAliases())
+    renderGraph->addAlias(a, b);
+  nei_log("{} aliased resource pairs", transientMemory->getAliases().size());
+
+  // framebuffer views need the depth memory bound
+  gbuffer->updateFramebuffer();
+}
+
+void MainApp::draw() {
+  if(window->isClosed()) return;
+  if(!swapchain->isValid()) return;
+
+  int slot = currentFrame;
+  auto& cmd = commandBuffers[slot];
+  currentFrame = (currentFrame + 1) % 4;
+  cmd->wait();
+  if(args.asyncCompute) bvhCommandBuffers[slot]->wait();
+
+#if rtx
+  // the frame which used the sets of this slot has finished, other slots are still in flight. The frame which
+  // compacted traces the replaced top level, it is retired for as many frames as there are slots
+  descriptorSlot = slot;
+  if(bvhDescriptorsDirty[slot]) {
+    updateBvhDescriptors(slot);
+    bvhDescriptorsDirty[slot] = false;
+  }
+  if(bvhCompacting && bvh->isCompactionDone()) {
+    nei_log("BVH memory {} kB after compaction", bvh->getMemorySize() / 1024);
+    if(!args.bvhCache.empty()) bvh->storeCache();
+    bvhCompacting = false;
+  }
+  if(sbt) sbt->nextFrame();
+#endif
 
-    profiler->writeMarker(cmd);
+  viewProjection = getViewProjection();
+  if(args.instanceAnimation > 0) animateInstances(frame.frameId);
+  if(args.frustumClusters > 0) cullClusters();
+
+  // compaction still records work into the frame, replay starts once the structures are final
+  if(args.replay && !bvhCompacting && renderGraph->isSteady()) {
+    drawReplay();
+    return;
+  }
 
-    swapchain->copy(cmd, accBuffer);
+  writeFrameData(slot);
 
-    profiler->writeMarker(cmd);
+  Scope frameScope(swapchain);
+  {
+    Scope commandScope(cmd);
+
+    profiler->beginFrame(cmd, frame.frameId - skipFrames);
+    renderGraph->execute(cmd);
+    profiler->collectCounters(cmd);
     ProfileCollect(cmd);
   }
+#if rtx
+  if(args.asyncCompute)
+    submitAsync(cmd, bvhCommandBuffers[slot], slot);
+  else
+#endif
+    cmd->submit(swapchain);
+
+  prevViewProjection = viewProjection;
+  historyValid = true;
+}
+
+// world space boxes are built once, only moved instances are refreshed.
+// visible boxes come out in ascending order, so the clusters of every instance form one run
+void MainApp::cullClusters() {
+  Profile("frustum cull");
+  uint clusterCount = uint(drawClusters.size());
+  int instanceCount = int(instanceTransforms.size());
+  if(clusterBounds.size() == 0) {
+    clusterBounds.reserve(clusterCount * instanceCount);
+    for(auto& t : instanceTransforms) {
+      for(auto& c : drawClusters) clusterBounds.add(c.bounds.transform(t));
+    }
+  } else if(args.instanceAnimation > 0) {
+    int moved = int(round(args.instanceAnimation * args.instances));
+    for(int i = instanceCount - moved; i < instanceCount; i++) {
+      for(uint c = 0; c < clusterCount; c++)
+        clusterBounds.set(i * clusterCount + c, drawClusters[c].bounds.transform(instanceTransforms[i]));
+    }
+  }
+
+  visibleClusters.clear();
+  Frustum(viewProjection).cull(clusterBounds, visibleClusters);
+
+  visibleBegin.assign(instanceCount + 1, uint(visibleClusters.size()));
+  for(int v = int(visibleClusters.size()) - 1; v >= 0; v--) {
+    uint instance = visibleClusters[v] / clusterCount;
+    visibleBegin[instance] = v;
+    visibleClusters[v] -= instance * clusterCount;
+  }
+  for(int i = instanceCount - 1; i >= 0; i--) visibleBegin[i] = glm::min(visibleBegin[i], visibleBegin[i + 1]);
+}
+
+// draw count is reset and moved instances are uploaded, they are the last ones.
+// occlusion tests against the pyramid of the last frame use the transforms it was drawn with
+void MainApp::uploadCullData(CommandBuffer* cmd) {
+  uint header[4] = {0, 0, 0, 0};
+  drawBuffer->setDataInline(cmd, header, sizeof(header));
+  if(args.instanceAnimation > 0) {
+    uint count = uint(instanceTransforms.size());
+    uint first = count - uint(round(args.instanceAnimation * args.instances));
+    const uint chunk = 65536 / sizeof(mat4); // vkCmdUpdateBuffer limit
+    for(uint i = first; i < count; i += chunk) {
+      uint size = glm::min(chunk, count - i) * sizeof(mat4);
+      instanceBuffer->setDataInline(cmd, &instanceTransforms[i], size, i * sizeof(mat4));
+      prevInstanceBuffer->setDataInline(cmd, &prevInstanceTransforms[i], size, i * sizeof(mat4));
+    }
+  }
+}
+
+// one thread per instance and cluster
+void MainApp::cullClustersGpu(CommandBuffer* cmd) {
+  CullData data;
+  data.vp = viewProjection;
+  data.prevVP = prevViewProjection;
+  data.clusterCount = uint(drawClusters.size());
+  data.drawCount = data.clusterCount * uint(instanceTransforms.size());
+  data.hizLevels = historyValid ? hiZ->getMipLevels() : 0;
+  data.compact = deviceContext->supportsDrawIndirectCount();
+  data.frustumCounter = frustumCulledCounter;
+  data.occlusionCounter = occlusionCulledCounter;
+  data.screenSize = vec2(resolution);
+
+  cmd->bind(cullPipeline);
+  cullPipeline->setUniform(cmd, uniforms, cullDescriptor, 0, data);
+  cmd->dispatch(uvec3((data.drawCount + 63) / 64, 1, 1));
+}
+
+// farthest depth per texel, level 0 from the gbuffer positions of this frame
+void MainApp::buildHiZ(CommandBuffer* cmd) {
+  uvec2 size = hiZ->getSize();
+  cmd->bind(hizDepthPipeline);
+  cmd->bind(hizDepthDescriptor);
+  hizDepthPipeline->setConstants(cmd, viewProjection, 0, vk::ShaderStageFlagBits::eCompute);
+  cmd->dispatch(uvec3((size.x + 7) / 8, (size.y + 7) / 8, 1));
+
+  cmd->bind(hizReducePipeline);
+  for(auto& descriptor : hizReduceDescriptors) {
+    cmd->memoryBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+      vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+    size = max(size / 2u, uvec2(1));
+    cmd->bind(descriptor);
+    cmd->dispatch(uvec3((size.x + 7) / 8, (size.y + 7) / 8, 1));
+  }
+}
+
+// starts the uniform region of the slot, the previous frame using it has finished.
+// frame data is its first allocation, replayed frames find it at the recorded offset
+void MainApp::writeFrameData(int slot) {
+  FrameData data;
+  data.viewProjection = viewProjection;
+  data.lightPosition = vec4(lightPosition, 1);
+  data.camPos = vec4(manipulator->getEye(), 1);
+  uniforms->beginFrame(slot);
+  frameDataOffset = uniforms->push(data);
+}
+
+// static scene, the frame is recorded once per swapchain image and only the frame data changes.
+// tracy gpu zones are not collected from replayed frames
+void MainApp::drawReplay() {
+  Scope frameScope(swapchain);
+  int image = int(swapchain->getCurrentImage());
+  int slot = 4 + image;
+  auto& cmd = replayBuffers[image];
+
+  // queries of the last submission are read before they are reset again
+  if(cmd) {
+    cmd->wait();
+    profiler->resolve(slot);
+  }
+  writeFrameData(slot);
+
+  if(!cmd) {
+    cmd = new CommandBuffer(deviceContext);
+    cmd->begin(vk::CommandBufferUsageFlags());
+    profiler->beginReplay(cmd, slot);
+    renderGraph->execute(cmd);
+    profiler->collectCounters(cmd);
+    cmd->end();
+  }
+  profiler->submitReplay(slot, frame.frameId - skipFrames);
   cmd->submit(swapchain);
 }
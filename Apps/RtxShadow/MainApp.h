@@ -5,6 +5,8 @@
 #include "Loader.h"
 #include "Profiler.h"
 #include "Scene/RaytracingBVH.h"
+#include "Scene/MeshPartition.h"
+#include "Scene/TriangleSplitter.h"
 
 using namespace Nei;
 using namespace Vu;
@@ -12,37 +14,203 @@ using namespace Vu;
 class MainApp: public Nei::SimpleApplication {
 public:
   MainApp(int argc, char** argv);
+  ~MainApp() override;
 
   void update(Nei::AppFrame const& frame) override;
   void draw() override;
 
 protected:
+  struct ShadowConstants {
+    vec3 lightPosition;
+    int mode;
+  };
+
+  struct CacheConstants {
+    vec3 camPos;
+    float pixelScale;
+    uint frame;
+    uint maxAge;
+    uint tableMask;
+    int pass;
+    uint lookupsCounter;
+    uint raysCounter;
+  };
+
+  struct ClassifyConstants {
+    vec3 lightPosition;
+    uint raysCounter;
+    uint skippedCounter;
+    uint coherenceCounter;
+  };
+
+  // camera data read by gbuffer and lighting, written by the host so recorded frames stay valid
+  struct FrameData {
+    mat4 viewProjection;
+    vec4 lightPosition;
+    vec4 camPos;
+  };
+
+  // matches cull.fx
+  struct GpuCluster {
+    vec3 boundsMin;
+    uint firstIndex;
+    vec3 boundsMax;
+    uint indexCount;
+  };
+
+  struct CullData {
+    mat4 vp;
+    mat4 prevVP;
+    uint clusterCount;
+    uint drawCount;
+    int hizLevels;
+    int compact;
+    uint frustumCounter;
+    uint occlusionCounter;
+    vec2 screenSize;
+  };
+
+  struct TemporalData {
+    mat4 vp;
+    mat4 prevVP;
+    ivec4 params; // frame, history valid, refresh period, rays counter
+  };
+
+  void buildRenderGraph();
+  void placeInstances();
+  void animateInstances(int frameId);
+  void allocateTransientMemory();
+  mat4 getViewProjection();
+  ivec3 getShadowLaunchSize(ShadowMode mode) const;
+  void resetRayHeader(CommandBuffer* cmd, Buffer* buffer);
+  void reprojectShadows(CommandBuffer* cmd, mat4 const& vp);
+  void lookupShadowCache(CommandBuffer* cmd, mat4 const& vp, int pass);
+  void classifyShadowRays(CommandBuffer* cmd);
+  void traceShadows(CommandBuffer* cmd, DescriptorSet* descriptor, ShadowMode mode);
+  void measureShadowQuality(CommandBuffer* cmd);
+  void updateBvhDescriptors(int slot);
+  void updateBvh(CommandBuffer* cmd);
+  void submitAsync(CommandBuffer* cmd, CommandBuffer* bvhCmd, int slot);
+  void writeFrameData(int slot);
+  void drawReplay();
+  void cullClusters();
+  void uploadCullData(CommandBuffer* cmd);
+  void cullClustersGpu(CommandBuffer* cmd);
+  void buildHiZ(CommandBuffer* cmd);
+
   const int skipFrames = 60;
+  const int temporalRefresh = 16; // each pixel is retraced at least every N frames
+  const uint rayListHeaderSize = 8 * sizeof(uint);
+  const float cacheCellPixels = 2; // approximate cache cell size in pixels
 
   Args args;
   ModelData model;
+  Ptr<Mesh> raytracingMesh; // model mesh or its split copy, source of the bottom levels
   CameraPath cameraPath;
   vec3 lightPosition = { 0,10,0 };
 
   uvec2 resolution;
 
+  std::vector<vec3> instanceOffsets;
+  std::vector<mat4> instanceTransforms;
+  std::vector<mat4> prevInstanceTransforms; // last frame, the hi-z pyramid was built with them
+
   Ptr<RaytracingBVH> bvh;
+  bool bvhCompacting = false;      // cache and memory log wait for the compacted structures
+  bool bvhDescriptorsDirty[4] = {}; // top level was compacted, per frame slot
   Ptr<ShaderBindingTable> sbt;
   Ptr<GraphicsPipeline> gbufferPipeline;
   Ptr<RaytracingPipeline> shadowMaskPipeline;
   Ptr<ComputePipeline> lightingPipeline;
+  Ptr<ComputePipeline> shadowUpsamplePipeline;
+  Ptr<ComputePipeline> shadowComparePipeline;
+  Ptr<ComputePipeline> shadowReprojectPipeline;
+  Ptr<ComputePipeline> shadowHistoryPipeline;
+  Ptr<ComputePipeline> shadowCachePipeline;
+  Ptr<ComputePipeline> shadowClassifyPipeline;
 
   Ptr<DescriptorSet> gbufferDescriptor;
-  Ptr<DescriptorSet> shadowMaskDescriptor;
-  Ptr<DescriptorSet> lightingDescriptor;
+  Ptr<DescriptorSet> shadowMaskDescriptors[4]; // per frame slot, they hold the top level
+  Ptr<DescriptorSet> shadowUpsampleDescriptor;
+  Ptr<DescriptorSet> shadowReferenceDescriptors[4];
+  Ptr<DescriptorSet> shadowCompareDescriptor;
+  Ptr<DescriptorSet> shadowReprojectDescriptor;
+  Ptr<DescriptorSet> shadowHistoryDescriptor;
+  Ptr<DescriptorSet> shadowCacheDescriptor;
+  Ptr<DescriptorSet> shadowClassifyDescriptor;
+  Ptr<DescriptorSet> lightingDescriptors[4];
 
   Ptr<GBuffer> gbuffer;
   Ptr<Texture2D> shadowMask;
+  Ptr<Texture2D> shadowSparse;    // traced samples for reduced rate modes
+  Ptr<Texture2D> shadowReference; // full rate mask for quality measurement
+  Ptr<Texture2D> shadowDepth;
+  Ptr<Texture2D> shadowHistory;
+  Ptr<Texture2D> depthHistory;
+  Ptr<Buffer> rayList;            // pixels to trace in temporal and cache mode
+  Ptr<Buffer> shadowCache;
+  Ptr<Buffer> rayBuffer;          // classified rays
+  mat4 prevViewProjection;
+  bool historyValid = false;
   Ptr<Texture2D> accBuffer;
   Ptr<Profiler> profiler;
+  Ptr<RenderGraph> renderGraph;
+  Ptr<TransientMemory> transientMemory;
+  mat4 viewProjection;
+
+  int raysCounter = -1;
+  int barriersCounter = -1;
+  int pixelsCounter = -1;
+  int errorCounter = -1;
+  int lookupsCounter = -1;
+  int hitsCounter = -1;
+  int skippedCounter = -1;
+  int coherenceCounter = -1;
+  int uploadsCounter = -1;
+  int visibleCounter = -1;
+  int trianglesCounter = -1;
+  int frustumCulledCounter = -1;
+  int occlusionCulledCounter = -1;
 
   Ptr<CommandBuffer> commandBuffers[4];
   int currentFrame = 0;
+  int descriptorSlot = 0; // slot being recorded, selects the sets holding the top level
+
+  // async compute, bvh updates on the compute queue
+  Ptr<CommandBuffer> bvhCommandBuffers[4];
+  vk::Semaphore bvhReady[4];  // compute to main, before the shadow rays
+  vk::Semaphore frameDone[4]; // main to compute, previous frame no longer traces
+  int previousFrameDone = -1;  // signaled frameDone not waited yet
+
+  // per frame uniforms, one region per command buffer slot and replayed swapchain image
+  Ptr<UniformRing> uniforms;
+  Ptr<DescriptorSet> gbufferFrameDescriptor;
+  Ptr<DescriptorSet> lightingFrameDescriptor;
+  uint32 frameDataOffset = 0;
+  std::vector<Ptr<CommandBuffer>> replayBuffers; // one per swapchain image, recorded once
+
+  // frustum culling, one box per instance and cluster of the gbuffer mesh
+  std::vector<MeshCluster> drawClusters;
+  AABBBatch clusterBounds;
+  std::vector<uint> visibleClusters; // cluster index within the instance
+  std::vector<uint> visibleBegin;    // first visible cluster of every instance and the end
+
+  // gpu culling, draws of visible clusters are written by a compute pass
+  Ptr<GraphicsPipeline> gbufferIndirectPipeline;
+  Ptr<ComputePipeline> cullPipeline;
+  Ptr<ComputePipeline> hizDepthPipeline;
+  Ptr<ComputePipeline> hizReducePipeline;
+  Ptr<DescriptorSet> gbufferIndirectDescriptor;
+  Ptr<DescriptorSet> gbufferIndirectFrameDescriptor;
+  Ptr<DescriptorSet> cullDescriptor;
+  Ptr<DescriptorSet> hizDepthDescriptor;
+  std::vector<Ptr<DescriptorSet>> hizReduceDescriptors; // one per level after the first
+  Ptr<Texture2D> hiZ;           // farthest depth pyramid of the last frame, half resolution
+  Ptr<Buffer> clusterBuffer;
+  Ptr<Buffer> instanceBuffer;
+  Ptr<Buffer> prevInstanceBuffer;
+  Ptr<Buffer> drawBuffer;       // count header and VkDrawIndexedIndirectCommand records
+  const uint drawHeaderSize = 16;
 };
 
 
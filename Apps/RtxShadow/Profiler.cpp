@@ -1,6 +1,8 @@
 #include "Profiler.h"
 
 #include "NeiVu/CommandBuffer.h"
+#include "NeiVu/Buffer.h"
+#include <algorithm>
 
 using namespace Nei;
 
@@ -8,6 +10,16 @@ Profiler::Profiler(DeviceContext* dc):DeviceObject(dc) {
 
 }
 
+int Profiler::addCounter(std::string const& name, int ratioOf, double scale) {
+  nei_assert(!counterBuffer);
+  Counter counter;
+  counter.name = name;
+  counter.ratioOf = ratioOf;
+  counter.scale = scale;
+  counters.push_back(counter);
+  return int(counters.size()) - 1;
+}
+
 void Profiler::init(int markers, int avgFrames, int maxFrames) {
   this->markers=markers;
   this->avgFrames = avgFrames;
@@ -15,6 +27,18 @@ void Profiler::init(int markers, int avgFrames, int maxFrames) {
 
   acc.resize(markers-1);
   std::fill(acc.begin(), acc.end(), 0);
+
+  if(!counters.empty()) {
+    counterBuffer = new Buffer(deviceContext, uint(counters.size() * sizeof(uint)), Buffer::Storage);
+    counterBuffer->setName("ProfilerCounters");
+  }
+}
+
+bool Profiler::addAsyncQueue(int queueIndex, std::string const& name) {
+  auto families = deviceContext->getVkPhysicalDevice().getQueueFamilyProperties();
+  if(queueIndex < 0 || queueIndex >= families.size() || families[queueIndex].timestampValidBits == 0) return false;
+  asyncName = name;
+  return true;
 }
 
 void Profiler::openLog(fs::path const& path) {
@@ -23,34 +47,129 @@ void Profiler::openLog(fs::path const& path) {
     nei_error("Failed to open log for writing! {}", path.string());
     return;
   }
-  stream << "frame,BVH,gBuffer,shadowMask,shading,copy\n";
+  stream << "frame,BVH,gBuffer,shadowMask,shading,copy";
+  if(!asyncName.empty()) stream << "," << asyncName;
+  for(auto& c : counters) stream << "," << c.name;
+  stream << "\n";
 }
 
-void Profiler::beginFrame(Nei::CommandBuffer* cmd, int frameId) {
-  currentFrame = frameId;
-  if (currentFrame >= maxFrames || currentFrame < 0) return;
-  Ptr frame = new Frame;
-  frames.push_back(frame);
+void Profiler::resetCounters(Nei::CommandBuffer* cmd) {
+  if(!counterBuffer) return;
+  cmd->memoryBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+    vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferWrite);
+  (**cmd).fillBuffer(*counterBuffer, 0, VK_WHOLE_SIZE, 0);
+  cmd->memoryBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+    vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+}
 
+Ptr<Profiler::Frame> Profiler::createFrame() {
+  Ptr frame = new Frame;
   auto device = getDevice();
 
+  // extra query marks the end of counter copy
+  frame->querries = counterBuffer ? markers + 1 : markers;
+
   vk::QueryPoolCreateInfo qpci;
   qpci.queryType = vk::QueryType::eTimestamp;
-  qpci.queryCount = markers;
+  qpci.queryCount = frame->querries;
 
   frame->pool = device.createQueryPool(qpci);
 
-  (**cmd).resetQueryPool(frame->pool, 0, markers);
+  if(!asyncName.empty()) {
+    qpci.queryCount = 2;
+    frame->asyncPool = device.createQueryPool(qpci);
+  }
+  return frame;
+}
+
+void Profiler::beginFrame(Nei::CommandBuffer* cmd, int frameId) {
+  currentFrame = frameId;
+  recording = nullptr;
+
+  resetCounters(cmd);
+
+  if (currentFrame >= maxFrames || currentFrame < 0) return;
+  recording = createFrame();
+  recording->frameID = frameId;
+  frames.push_back(recording);
+
+  (**cmd).resetQueryPool(recording->pool, 0, recording->querries);
+}
+
+void Profiler::beginReplay(Nei::CommandBuffer* cmd, int slot) {
+  resetCounters(cmd);
+
+  if(slot >= replayFrames.size()) replayFrames.resize(slot + 1);
+  auto& frame = replayFrames[slot];
+  if(!frame) frame = createFrame();
+  frame->current = 0;
+
+  (**cmd).resetQueryPool(frame->pool, 0, frame->querries);
+  recording = frame;
+}
 
+void Profiler::submitReplay(int slot, int frameId) {
+  currentFrame = frameId;
+  if(frameId >= maxFrames || frameId < 0) return;
+  auto& frame = replayFrames[slot];
+  nei_assert(std::find(frames.begin(), frames.end(), frame) == frames.end());
   frame->frameID = frameId;
-  frame->querries = markers;
+  frames.push_back(frame);
+}
+
+void Profiler::resolve(int slot) {
+  if(slot >= replayFrames.size() || !replayFrames[slot]) return;
+  auto& frame = replayFrames[slot];
+  bool w = wait;
+  wait = true;
+  while(std::find(frames.begin(), frames.end(), frame) != frames.end())
+    checkResults();
+  wait = w;
 }
 
 void Profiler::writeMarker(CommandBuffer* cmd) {
-  if (currentFrame >= maxFrames || currentFrame<0) return;
-  auto& frame = frames.back();
-  auto qIndex = frame->current++;
-  (**cmd).writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, frame->pool, qIndex);
+  if(!recording) return;
+  auto qIndex = recording->current++;
+  (**cmd).writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, recording->pool, qIndex);
+}
+
+void Profiler::beginAsync(Nei::CommandBuffer* cmd) {
+  if(!recording || !recording->asyncPool) return;
+  (**cmd).resetQueryPool(recording->asyncPool, 0, 2);
+  (**cmd).writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, recording->asyncPool, 0);
+}
+
+void Profiler::endAsync(Nei::CommandBuffer* cmd) {
+  if(!recording || !recording->asyncPool) return;
+  (**cmd).writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, recording->asyncPool, 1);
+}
+
+void Profiler::setCounter(Nei::CommandBuffer* cmd, int counter, uint value) {
+  nei_assert(counter >= 0 && counter < counters.size());
+  (**cmd).fillBuffer(*counterBuffer, counter * sizeof(uint), sizeof(uint), value);
+}
+
+void Profiler::collectCounters(Nei::CommandBuffer* cmd) {
+  if (!counterBuffer || !recording) return;
+
+  // replayed frames keep their readback buffer
+  if(!recording->counters)
+    recording->counters = new Buffer(deviceContext, uint(counterBuffer->getSize()), Buffer::Staging, ReadBack);
+
+  cmd->memoryBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+    vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead);
+  cmd->copy(counterBuffer, recording->counters, counterBuffer->getSize());
+  cmd->memoryBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+    vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+  (**cmd).writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, recording->pool, markers);
+}
+
+double Profiler::counterValue(Counter const& counter, bool total) const {
+  auto value = (total ? counter.total : counter.acc) * counter.scale;
+  if(counter.ratioOf < 0) return total ? value : value / avgFrames;
+
+  auto base = total ? counters[counter.ratioOf].total : counters[counter.ratioOf].acc;
+  return base > 0 ? 100. * value / base : 0;
 }
 
 void Profiler::checkResults() {
@@ -65,26 +184,52 @@ void Profiler::checkResults() {
   auto res = device.getQueryPoolResults(frame->pool, 0, frame->querries, sizeof(buffer), buffer,
     sizeof(uint64), flags);
 
+  uint64 async[2] = {};
+  if(res == vk::Result::eSuccess && frame->asyncPool)
+    res = device.getQueryPoolResults(frame->asyncPool, 0, 2, sizeof(async), async, sizeof(uint64), flags);
+
   if(res== vk::Result::eSuccess) {
     nei_log("***");
-    for (int i = 0; i < frame->querries - 1; i++) {
+    for (int i = 0; i < markers - 1; i++) {
       auto t = (buffer[i + 1] - buffer[i]) * 1e-6;
       nei_log("{}ms",t);
       acc[i]+=t;
     }
+    if(frame->asyncPool) {
+      auto t = (async[1] - async[0]) * 1e-6;
+      nei_log("{} {}ms", asyncName, t);
+      asyncAcc += t;
+    }
+
+    if(frame->counters) {
+      auto values = (uint*)frame->counters->map();
+      for(int i = 0; i < counters.size(); i++) {
+        counters[i].acc += values[i];
+        counters[i].total += values[i];
+      }
+      frame->counters->unmap();
+    }
+    finishedFrames++;
 
     if(frame->frameID%avgFrames == avgFrames-1) {
       stream << frame->frameID/avgFrames << ",";
       for(int i=0;i<acc.size();i++) {
-        stream << acc[i]/avgFrames << (i == acc.size()-1 ? "\n":",");  
+        stream << acc[i]/avgFrames << (i == acc.size()-1 && counters.empty() && asyncName.empty() ? "\n":",");
+      }
+      if(!asyncName.empty())
+        stream << asyncAcc/avgFrames << (counters.empty() ? "\n" : ",");
+      for(int i = 0; i < counters.size(); i++) {
+        stream << counterValue(counters[i], false) << (i == counters.size() - 1 ? "\n" : ",");
       }
 
       stream.flush();
       std::fill(acc.begin(),acc.end(),0);
+      asyncAcc = 0;
+      for(auto& c : counters) c.acc = 0;
     }
 
     frames.erase(frames.begin());
-    
+
   }else if(res == vk::Result::eNotReady) {
     nei_log("q not rdy");
   }
@@ -97,6 +242,13 @@ void Profiler::finish() {
   while(!frames.empty())
     checkResults();
 
+  for(auto& c : counters) {
+    if(c.ratioOf < 0)
+      nei_log("{}: total {}, {} per frame", c.name, c.total, finishedFrames ? c.total / finishedFrames : 0);
+    else
+      nei_log("{}: {}%", c.name, counterValue(c, true));
+  }
+
   stream.flush();
   stream.close();
 }
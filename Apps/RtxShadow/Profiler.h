@@ -8,30 +8,78 @@ class Profiler : public Nei::DeviceObject {
 public:
   Profiler(Nei::DeviceContext* dc);
 
+  // counters have to be added before openLog/init, returns counter index
+  // ratioOf - counter is logged as percentage of other counter
+  // scale - applied to logged value, for fixed point counters
+  int addCounter(std::string const& name, int ratioOf = -1, double scale = 1);
+
   void init(int markers, int avgFrames, int maxFrames);
 
+  // work submitted to another queue is timed by its own begin/end pair, logged as an extra column
+  // has to be called before openLog, returns false if the queue has no timestamps
+  bool addAsyncQueue(int queueIndex, std::string const& name);
+
   void openLog(fs::path const& path);
 
   void beginFrame(Nei::CommandBuffer* cmd, int frameId);
 
+  // replayed command buffers record into a persistent frame per slot instead of beginFrame,
+  // submitReplay queues it for readback, resolve reads the last submission before it is submitted again
+  void beginReplay(Nei::CommandBuffer* cmd, int slot);
+  void submitReplay(int slot, int frameId);
+  void resolve(int slot);
+
   void writeMarker(Nei::CommandBuffer* cmd);
+
+  // recorded on the async queue after beginFrame
+  void beginAsync(Nei::CommandBuffer* cmd);
+  void endAsync(Nei::CommandBuffer* cmd);
+
+  // counters are reset in beginFrame, shaders can atomicAdd into counter buffer
+  // collectCounters has to be called after the last marker every frame
+  void setCounter(Nei::CommandBuffer* cmd, int counter, uint value);
+  void collectCounters(Nei::CommandBuffer* cmd);
+  Nei::Buffer* getCounterBuffer() const { return counterBuffer; }
+
   void checkResults();
   void finish();
 
 protected:
-  struct Frame : Nei::Object {
+  struct Frame : Nei::Object, Nei::Pooled<Frame> {
     vk::QueryPool pool;
+    vk::QueryPool asyncPool;
+    Nei::Ptr<Nei::Buffer> counters;
     int frameID;
     int querries;
     int current = 0;
   };
-  
+
+  struct Counter {
+    std::string name;
+    int ratioOf = -1;
+    double scale = 1;
+    double acc = 0;
+    double total = 0;
+  };
+
+  double counterValue(Counter const& counter, bool total) const;
+  void resetCounters(Nei::CommandBuffer* cmd);
+  Nei::Ptr<Frame> createFrame();
+
   bool wait = false;
   int maxFrames = 0;
   int avgFrames = 0;
   int markers = 0;
   int currentFrame = 0;
+  int finishedFrames = 0;
+  std::string asyncName;
+  double asyncAcc = 0;
   std::vector<Nei::Ptr<Frame>> frames;
+  std::vector<Nei::Ptr<Frame>> replayFrames;
+  Nei::Ptr<Frame> recording; // frame receiving markers, null outside of the profiled range
+
+  std::vector<Counter> counters;
+  Nei::Ptr<Nei::Buffer> counterBuffer;
 
   std::vector<double> acc;
   std::ofstream stream;
@@ -0,0 +1,148 @@
+#version 450
+#dynamic 0 0
+
+#comp
+layout(local_size_x = 64) in;
+
+layout(set = 0, binding = 0) uniform CullData {
+  mat4 vp;
+  mat4 prevVP;        // the pyramid was built with it
+  uint clusterCount;
+  uint drawCount;     // instances * clusters
+  int hizLevels;      // 0 without a previous frame
+  int compact;        // 0 writes every draw, culled ones with no instances
+  uint frustumCounter;
+  uint occlusionCounter;
+  vec2 screenSize;
+};
+
+struct Cluster {
+  vec3 boundsMin;
+  uint firstIndex;
+  vec3 boundsMax;
+  uint indexCount;
+};
+
+struct DrawCommand {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout(set = 0, binding = 1) readonly buffer Clusters {
+  Cluster clusters[];
+};
+
+layout(set = 0, binding = 2) readonly buffer Instances {
+  mat4 transforms[];
+};
+
+// count is read by vkCmdDrawIndexedIndirectCount, records start at 16 bytes
+layout(set = 0, binding = 3) buffer Draws {
+  uint visibleCount;
+  uint pad[3];
+  DrawCommand draws[];
+};
+
+layout(set = 0, binding = 4) uniform sampler2D texHiZ;
+
+layout(set = 0, binding = 5) buffer Counters {
+  uint counters[];
+};
+
+// transforms the pyramid was drawn with, moved instances differ from the current ones
+layout(set = 0, binding = 6) readonly buffer PrevInstances {
+  mat4 prevTransforms[];
+};
+
+shared uint groupFrustum;
+shared uint groupOcclusion;
+
+vec3 corner(vec3 bmin, vec3 bmax, int i){
+  return mix(bmin,bmax,vec3(i&1,(i>>1)&1,(i>>2)&1));
+}
+
+// all corners are outside one clip plane
+bool outsideFrustum(vec3 bmin, vec3 bmax, mat4 m){
+  uint outside = 63;
+  for(int i=0;i<8;i++){
+    vec4 clip = m*vec4(corner(bmin,bmax,i),1);
+    uint mask = 0;
+    if(clip.x < -clip.w) mask |= 1;
+    if(clip.x > clip.w) mask |= 2;
+    if(clip.y < -clip.w) mask |= 4;
+    if(clip.y > clip.w) mask |= 8;
+    if(clip.z < -clip.w) mask |= 16;
+    if(clip.z > clip.w) mask |= 32;
+    outside &= mask;
+  }
+  return outside != 0;
+}
+
+// nearest depth of the box behind the farthest depth of the pyramid texels covering its screen rectangle
+bool occluded(vec3 bmin, vec3 bmax, mat4 m){
+  vec3 ndcMin = vec3(1e30);
+  vec3 ndcMax = vec3(-1e30);
+  for(int i=0;i<8;i++){
+    vec4 clip = m*vec4(corner(bmin,bmax,i),1);
+    // crosses the camera plane, no bounded rectangle
+    if(clip.w <= 1e-5) return false;
+    vec3 ndc = clip.xyz/clip.w;
+    ndcMin = min(ndcMin,ndc);
+    ndcMax = max(ndcMax,ndc);
+  }
+
+  vec2 rectMin = clamp(ndcMin.xy*0.5+0.5,0.0,1.0)*screenSize;
+  vec2 rectMax = clamp(ndcMax.xy*0.5+0.5,0.0,1.0)*screenSize;
+  float extent = max(max(rectMax.x-rectMin.x,rectMax.y-rectMin.y),1);
+
+  // level 0 has half the screen resolution, pick the one where the rectangle covers at most 2x2 texels
+  for(int level = max(0,int(ceil(log2(extent)))-1); level < hizLevels; level++){
+    ivec2 levelSize = textureSize(texHiZ,level);
+    ivec2 t0 = min(ivec2(rectMin)>>(level+1),levelSize-1);
+    ivec2 t1 = min(ivec2(rectMax)>>(level+1),levelSize-1);
+    if(any(greaterThan(t1-t0,ivec2(1)))) continue;
+
+    float d = max(max(texelFetch(texHiZ,t0,level).x,texelFetch(texHiZ,ivec2(t1.x,t0.y),level).x),
+                  max(texelFetch(texHiZ,ivec2(t0.x,t1.y),level).x,texelFetch(texHiZ,t1,level).x));
+    return ndcMin.z > d;
+  }
+  return false;
+}
+
+void main() {
+  uint id = gl_GlobalInvocationID.x;
+  if(gl_LocalInvocationIndex == 0){
+    groupFrustum = 0;
+    groupOcclusion = 0;
+  }
+  barrier();
+
+  if(id < drawCount){
+    uint instance = id/clusterCount;
+    Cluster cluster = clusters[id%clusterCount];
+    mat4 model = transforms[instance];
+    uint triangles = cluster.indexCount/3;
+
+    bool visible = true;
+    if(outsideFrustum(cluster.boundsMin,cluster.boundsMax,vp*model)){
+      atomicAdd(groupFrustum,triangles);
+      visible = false;
+    } else if(hizLevels > 0 && occluded(cluster.boundsMin,cluster.boundsMax,prevVP*prevTransforms[instance])){
+      atomicAdd(groupOcclusion,triangles);
+      visible = false;
+    }
+
+    DrawCommand draw = DrawCommand(cluster.indexCount,visible?1u:0u,cluster.firstIndex,0,instance);
+    if(compact == 0) draws[id] = draw;
+    else if(visible) draws[atomicAdd(visibleCount,1)] = draw;
+  }
+
+  barrier();
+  if(gl_LocalInvocationIndex == 0){
+    if(groupFrustum > 0) atomicAdd(counters[frustumCounter],groupFrustum);
+    if(groupOcclusion > 0) atomicAdd(counters[occlusionCounter],groupOcclusion);
+  }
+}
@@ -1,6 +1,7 @@
 #version 450
 #depthTestEnable true
 #cull none
+#dynamic 1 0
 
 #vert
 layout(location = 0) in vec3 aPosition;
@@ -9,8 +10,15 @@ layout(location = 2) in vec2 aTc;
 layout(location = 3) in uint aBone; // unused - all bones identity
 layout(location = 4) in uint aMaterial;
 
-layout(push_constant) uniform PushConstants {
+// written by the host every frame, recorded command buffers can be replayed
+layout(set = 1, binding = 0) uniform FrameData {
   mat4 vp;
+  vec4 lightPos;
+  vec4 camPos;
+};
+
+layout(push_constant) uniform PushConstants {
+  mat4 model;
 };
 
 layout(location = 0) out vec3 vPosition;
@@ -19,10 +27,10 @@ layout(location = 2) out vec2 vTc;
 layout(location = 3) out uint vMaterial;
 
 void main() {
-  vec4 pos = vec4(aPosition,1);  
-  
-  vPosition = pos.xyz;  
-  vNormal = aNormal;
+  vec4 pos = model*vec4(aPosition,1);
+
+  vPosition = pos.xyz;
+  vNormal = mat3(model)*aNormal;
   vTc = aTc;
   vMaterial = aMaterial;
 
@@ -0,0 +1,37 @@
+#version 450
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(push_constant) uniform PushConstants {
+  mat4 vp;
+};
+
+layout(set = 0, binding = 0, rgba32f) uniform image2D texPosition;
+layout(set = 0, binding = 1, rgba16f) uniform image2D texNormal;
+layout(set = 0, binding = 2, r32f) uniform image2D texHiZ;
+
+// normalized device depth, sky pixels are at the far plane
+float depth(ivec2 p){
+  if(imageLoad(texNormal,p).xyz==vec3(0,0,0)) return 1;
+  vec4 clip = vp*vec4(imageLoad(texPosition,p).xyz,1);
+  return clip.z/clip.w;
+}
+
+// first level of the pyramid, farthest depth of every 2x2 block
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(texHiZ);
+  if(any(greaterThanEqual(id,size))) return;
+
+  // odd sizes fold the last row and column into the last texel
+  ivec2 sourceSize = imageSize(texPosition);
+  ivec2 first = id*2;
+  ivec2 last = min(first+1+ivec2(equal(id,size-1))*(sourceSize&1),sourceSize-1);
+
+  float d = -1;
+  for(int y=first.y;y<=last.y;y++){
+    for(int x=first.x;x<=last.x;x++) d = max(d,depth(ivec2(x,y)));
+  }
+  imageStore(texHiZ,id,vec4(d,0,0,0));
+}
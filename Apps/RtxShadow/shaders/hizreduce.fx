@@ -0,0 +1,25 @@
+#version 450
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0, r32f) uniform image2D texSource;
+layout(set = 0, binding = 1, r32f) uniform image2D texTarget;
+
+// next level of the pyramid, farthest depth of every 2x2 block
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(texTarget);
+  if(any(greaterThanEqual(id,size))) return;
+
+  // odd sizes fold the last row and column into the last texel
+  ivec2 sourceSize = imageSize(texSource);
+  ivec2 first = id*2;
+  ivec2 last = min(first+1+ivec2(equal(id,size-1))*(sourceSize&1),sourceSize-1);
+
+  float d = -1;
+  for(int y=first.y;y<=last.y;y++){
+    for(int x=first.x;x<=last.x;x++) d = max(d,imageLoad(texSource,ivec2(x,y)).x);
+  }
+  imageStore(texTarget,id,vec4(d,0,0,0));
+}
@@ -1,13 +1,13 @@
 #version 450
+#dynamic 1 0
 
 #comp
 layout(local_size_x = 8, local_size_y = 8) in;
 
-layout(push_constant) uniform PushConstants {
-  vec3 lightPos;
-  float pad;
-  vec3 camPos;
-  float pad1;
+layout(set = 1, binding = 0) uniform FrameData {
+  mat4 vp;
+  vec4 lightPos;
+  vec4 camPos;
 };
 
 layout(set = 0, binding = 0, rgba8) uniform image2D texAcc;
@@ -33,8 +33,8 @@ void main() {
   float shadowMask = imageLoad(texShadowMask,id).x;
   //shadowMask = 1;
 
-  vec3 lightDir = normalize(lightPos-position);
-  vec3 viewDir = normalize(camPos-position);
+  vec3 lightDir = normalize(lightPos.xyz-position);
+  vec3 viewDir = normalize(camPos.xyz-position);
 
   vec3 kd = shadowMask*0.8*diffuse*max(0,dot(lightDir,normal));
   vec3 ka = 0.2*diffuse;
@@ -0,0 +1,79 @@
+#version 460
+#extension GL_EXT_ray_query : require
+#dynamic 1 0
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 1, binding = 0) uniform FrameData {
+  mat4 vp;
+  vec4 lightPos;
+  vec4 camPos;
+};
+
+layout(set = 0, binding = 0, rgba8) uniform image2D texAcc;
+layout(set = 0, binding = 1, rgba32f ) uniform image2D texPosition;
+layout(set = 0, binding = 2, rgba16f ) uniform image2D texNormal;
+layout(set = 0, binding = 3, rgba8) uniform image2D texDiffuse;
+layout(set = 0, binding = 4) uniform accelerationStructureEXT bvh;
+
+float traceShadow(vec3 position, vec3 dir, float tmax){
+  uint flags = gl_RayFlagsOpaqueEXT|gl_RayFlagsTerminateOnFirstHitEXT;
+  float tmin = 0.001;
+
+  rayQueryEXT query;
+  rayQueryInitializeEXT(query, bvh, flags, 0xff, position, tmin, dir, tmax);
+  while(rayQueryProceedEXT(query)) {}
+
+  return rayQueryGetIntersectionTypeEXT(query, true) == gl_RayQueryCommittedIntersectionNoneEXT ? 1 : 0;
+}
+
+layout(push_constant) uniform PushConstants {
+  uint raysCounter;
+};
+
+layout(set = 0, binding = 5) buffer Counters {
+  uint counters[];
+};
+
+shared uint groupRays;
+
+// returns if a ray was traced
+bool shade(ivec2 id) {
+  vec3 normal = imageLoad(texNormal,id).xyz;
+  if(normal==vec3(0,0,0)){
+    imageStore(texAcc,id,vec4(0.2,0.2,0.2,1));
+    return false;
+  }
+
+  vec3 position = imageLoad(texPosition,id).xyz;
+  vec3 diffuse = imageLoad(texDiffuse,id).xyz;
+
+  vec3 lightDir = normalize(lightPos.xyz-position);
+  vec3 viewDir = normalize(camPos.xyz-position);
+
+  // back facing pixels have no diffuse term, no ray needed
+  float ndotl = max(0,dot(lightDir,normal));
+  bool trace = ndotl > 0;
+  float shadowMask = trace ? traceShadow(position, lightDir, length(lightPos.xyz-position)) : 0;
+
+  vec3 kd = shadowMask*0.8*diffuse*ndotl;
+  vec3 ka = 0.2*diffuse;
+
+  vec4 acc = vec4(kd+ka,0);
+  imageStore(texAcc,id,acc);
+  return trace;
+}
+
+// no early returns, the whole group reaches the barriers
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+  if(gl_LocalInvocationIndex == 0) groupRays = 0;
+  barrier();
+
+  ivec2 size = imageSize(texAcc);
+  if(all(lessThan(id,size)) && shade(id)) atomicAdd(groupRays,1);
+  barrier();
+
+  if(gl_LocalInvocationIndex == 0 && groupRays > 0) atomicAdd(counters[raysCounter],groupRays);
+}
@@ -0,0 +1,171 @@
+#version 450
+
+#comp
+layout(local_size_x = 64) in;
+
+layout(push_constant) uniform PushConstants {
+  vec3 camPos;
+  float pixelScale; // cell size per unit of distance from camera
+  uint frame;
+  uint maxAge;
+  uint tableMask;
+  int pass;         // 0 = lookup, 1 = insert traced pixels
+  uint counterLookups; // hits are counted in the next counter
+  uint counterRays;
+};
+
+layout(set = 0, binding = 0, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 1, rgba32f) uniform image2D texPosition;
+layout(set = 0, binding = 2, rgba16f) uniform image2D texNormal;
+
+// entry - key, (frame << 1) | visibility, key 0 is empty, payload busy while an insert owns the entry
+layout(set = 0, binding = 3) buffer Cache {
+  uvec2 entries[];
+};
+
+layout(set = 0, binding = 4) buffer RayList {
+  uint rayCount;
+  uint rayHeight;
+  uint rayDepth;
+  uint groupsX;
+  uint groupsY;
+  uint groupsZ;
+  uint pad[2];
+  uint pixels[];
+};
+
+layout(set = 0, binding = 5) buffer Counters {
+  uint counters[];
+};
+
+const uint probes = 4;
+const uint busy = 0xffffffffU;
+
+uint hash(uint x){
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+// key from quantized position, cell level (from distance) and normal direction
+uvec2 cacheKey(vec3 position, vec3 normal){
+  float cell = max(distance(position,camPos)*pixelScale,1e-4);
+  int level = int(floor(log2(cell)));
+  ivec3 p = ivec3(floor(position/exp2(level)));
+
+  vec3 a = abs(normal);
+  uint axis = a.x > a.y && a.x > a.z ? 0 : (a.y > a.z ? 1 : 2);
+  uint side = normal[axis] < 0 ? 1 : 0;
+
+  uint h = hash(uint(p.x) + hash(uint(p.y) + hash(uint(p.z) + hash(uint(level+64)*8 + axis*2 + side))));
+  uint key = hash(h ^ 0x9e3779b9U) | 1;
+  return uvec2(h,key);
+}
+
+bool valid(uvec2 entry){
+  return entry.y != busy && frame - (entry.y >> 1) <= maxAge;
+}
+
+shared uint groupCount;
+shared uint groupBase;
+shared uint groupLookups;
+shared uint groupHits;
+
+void lookup(){
+  uint local = gl_LocalInvocationIndex;
+  ivec2 id = ivec2(gl_WorkGroupID.xy*8 + uvec2(local%8,local/8));
+  ivec2 size = imageSize(texShadowMask);
+
+  if(local == 0){
+    groupCount = 0;
+    groupLookups = 0;
+    groupHits = 0;
+  }
+  barrier();
+
+  bool trace = false;
+  uint slot = 0;
+  if(all(lessThan(id,size))){
+    vec3 normal = imageLoad(texNormal,id).xyz;
+    if(normal==vec3(0,0,0)){
+      imageStore(texShadowMask,id,vec4(1,0,0,0));
+    } else {
+      vec3 position = imageLoad(texPosition,id).xyz;
+      uvec2 key = cacheKey(position,normal);
+      atomicAdd(groupLookups,1);
+
+      trace = true;
+      for(uint i=0;i<probes;i++){
+        uint index = (key.x+i)&tableMask;
+        uvec2 entry = entries[index];
+        if(entry.x == key.y && valid(entry)){
+          uint visibility = entry.y&1;
+          atomicMax(entries[index].y,(frame<<1)|visibility);
+          imageStore(texShadowMask,id,vec4(visibility,0,0,0));
+          atomicAdd(groupHits,1);
+          trace = false;
+          break;
+        }
+      }
+      if(trace) slot = atomicAdd(groupCount,1);
+    }
+  }
+
+  barrier();
+  if(local == 0){
+    if(groupCount > 0){
+      groupBase = atomicAdd(rayCount,groupCount);
+      atomicMax(groupsX,min((groupBase+groupCount+63)/64,65535u));
+      atomicAdd(counters[counterRays],groupCount);
+    }
+    atomicAdd(counters[counterLookups],groupLookups);
+    atomicAdd(counters[counterLookups+1],groupHits);
+  }
+  barrier();
+
+  if(trace) pixels[groupBase+slot] = (uint(id.y)<<16)|uint(id.x);
+}
+
+void insert(){
+  for(uint i=gl_GlobalInvocationID.x;i<rayCount;i+=gl_NumWorkGroups.x*64){
+    uint packed = pixels[i];
+    ivec2 id = ivec2(packed&0xffff,packed>>16);
+
+    vec3 position = imageLoad(texPosition,id).xyz;
+    vec3 normal = imageLoad(texNormal,id).xyz;
+    uint visibility = imageLoad(texShadowMask,id).x > 0.5 ? 1 : 0;
+    uvec2 key = cacheKey(position,normal);
+
+    // same key, empty slot or the oldest entry is replaced
+    uint target = key.x&tableMask;
+    uint oldest = 0;
+    for(uint p=0;p<probes;p++){
+      uint index = (key.x+p)&tableMask;
+      uvec2 entry = entries[index];
+      if(entry.x == key.y || entry.x == 0 || !valid(entry)){
+        target = index;
+        break;
+      }
+      uint age = frame - (entry.y >> 1);
+      if(age > oldest){
+        oldest = age;
+        target = index;
+      }
+    }
+
+    // the entry is claimed by swapping its payload to busy, only the owner writes key and payload,
+    // so a key is never paired with the payload of another insert
+    uint expected = entries[target].y;
+    if(expected == busy || atomicCompSwap(entries[target].y,expected,busy) != expected) continue;
+    atomicExchange(entries[target].x,key.y);
+    atomicExchange(entries[target].y,(frame<<1)|visibility);
+  }
+}
+
+void main() {
+  if(pass == 0) lookup();
+  else insert();
+}
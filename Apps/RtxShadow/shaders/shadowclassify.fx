@@ -0,0 +1,117 @@
+#version 450
+
+#comp
+layout(local_size_x = 64) in;
+
+layout(push_constant) uniform PushConstants {
+  vec3 lightPosition;
+  uint raysCounter;
+  uint skippedCounter;
+  uint coherenceCounter;
+};
+
+layout(set = 0, binding = 0, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 1, rgba32f) uniform image2D texPosition;
+layout(set = 0, binding = 2, rgba16f) uniform image2D texNormal;
+
+struct Ray {
+  vec4 origin;    // xyz, tmax
+  vec4 direction; // xyz, packed pixel
+};
+
+// header is laid out as indirect commands - trace (rayCount,1,1), dispatch (groupsX,1,1)
+layout(set = 0, binding = 3) buffer Rays {
+  uint rayCount;
+  uint rayHeight;
+  uint rayDepth;
+  uint groupsX;
+  uint groupsY;
+  uint groupsZ;
+  uint pad[2];
+  Ray rays[];
+};
+
+layout(set = 0, binding = 4) buffer Counters {
+  uint counters[];
+};
+
+shared uint scan[64];
+shared vec3 directions[64];
+shared uint groupBase;
+shared uint groupSkipped;
+shared uint groupCoherence;
+
+void main() {
+  // threads walk the 8x8 tile in morton order
+  uint i = gl_LocalInvocationIndex;
+  uvec2 morton = uvec2((i&1)|((i>>1)&2)|((i>>2)&4), ((i>>1)&1)|((i>>2)&2)|((i>>3)&4));
+  ivec2 id = ivec2(gl_WorkGroupID.xy*8 + morton);
+  ivec2 size = imageSize(texShadowMask);
+
+  if(i == 0){
+    groupSkipped = 0;
+    groupCoherence = 0;
+  }
+  barrier();
+
+  uint ray = 0;
+  vec3 position = vec3(0);
+  vec3 dir = vec3(0);
+  float tmax = 0;
+
+  if(all(lessThan(id,size))){
+    vec3 normal = imageLoad(texNormal,id).xyz;
+    position = imageLoad(texPosition,id).xyz;
+    dir = lightPosition-position;
+    tmax = length(dir);
+    dir /= tmax;
+
+    if(normal==vec3(0,0,0)){
+      imageStore(texShadowMask,id,vec4(1,0,0,0));
+    } else if(dot(normal,dir) <= 0){
+      imageStore(texShadowMask,id,vec4(0,0,0,0));
+      atomicAdd(groupSkipped,1);
+    } else {
+      ray = 1;
+    }
+  }
+
+  // inclusive prefix sum keeps the morton order in the compacted rays, a ray goes to scan[i]-1
+  scan[i] = ray;
+  directions[i] = ray == 1 ? dir : vec3(0);
+  barrier();
+  for(uint offset=1;offset<64;offset<<=1){
+    uint v = i >= offset ? scan[i-offset] : 0;
+    barrier();
+    scan[i] += v;
+    barrier();
+  }
+  for(uint s=32;s>0;s>>=1){
+    if(i < s) directions[i] += directions[i+s];
+    barrier();
+  }
+
+  uint total = scan[63];
+  if(i == 0 && total > 0){
+    groupBase = atomicAdd(rayCount,total);
+    atomicMax(groupsX,min((groupBase+total+63)/64,65535u));
+  }
+  barrier();
+
+  if(ray == 1){
+    uint index = groupBase+scan[i]-1;
+    rays[index].origin = vec4(position,tmax);
+    rays[index].direction = vec4(dir,uintBitsToFloat((uint(id.y)<<16)|uint(id.x)));
+
+    // cosine to mean direction of the group
+    float coherence = dot(dir,normalize(directions[0]));
+    atomicAdd(groupCoherence,uint(max(coherence,0)*100+0.5));
+  }
+  barrier();
+
+  if(i == 0){
+    atomicAdd(counters[raysCounter],total);
+    atomicAdd(counters[skippedCounter],groupSkipped);
+    atomicAdd(counters[coherenceCounter],groupCoherence);
+  }
+}
@@ -0,0 +1,32 @@
+#version 450
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(push_constant) uniform PushConstants {
+  int counter;
+};
+
+layout(set = 0, binding = 0, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 1, r8) uniform image2D texReference;
+layout(set = 0, binding = 2) buffer Counters {
+  uint counters[];
+};
+
+shared uint groupErrors;
+
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+  if(gl_LocalInvocationIndex == 0) groupErrors = 0;
+  barrier();
+
+  ivec2 size = imageSize(texShadowMask);
+  if(all(lessThan(id,size))){
+    float mask = imageLoad(texShadowMask,id).x;
+    float reference = imageLoad(texReference,id).x;
+    if(abs(mask-reference) > 0.5) atomicAdd(groupErrors,1);
+  }
+
+  barrier();
+  if(gl_LocalInvocationIndex == 0 && groupErrors > 0) atomicAdd(counters[counter],groupErrors);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 1, r32f) uniform image2D texDepth;
+layout(set = 0, binding = 2, r8) uniform image2D texShadowHistory;
+layout(set = 0, binding = 3, r32f) uniform image2D texDepthHistory;
+
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+
+  ivec2 size = imageSize(texShadowMask);
+  if(any(greaterThanEqual(id,size))) return;
+
+  imageStore(texShadowHistory,id,imageLoad(texShadowMask,id));
+  imageStore(texDepthHistory,id,imageLoad(texDepth,id));
+}
@@ -1,25 +1,105 @@
+// RT_KHR is defined by FxLoader for VK_KHR_ray_tracing_pipeline
+#ifdef RT_KHR
+#extension GL_EXT_ray_tracing : require
+#define accelerationStructureRT accelerationStructureEXT
+#define rayPayloadRT rayPayloadEXT
+#define rayPayloadInRT rayPayloadInEXT
+#define LaunchIDRT gl_LaunchIDEXT
+#define LaunchSizeRT gl_LaunchSizeEXT
+#define RayFlagsOpaqueRT gl_RayFlagsOpaqueEXT
+#define RayFlagsSkipClosestHitShaderRT gl_RayFlagsSkipClosestHitShaderEXT
+#define RayFlagsTerminateOnFirstHitRT gl_RayFlagsTerminateOnFirstHitEXT
+#define traceRT traceRayEXT
+#else
 #extension GL_NV_ray_tracing : require
+#define accelerationStructureRT accelerationStructureNV
+#define rayPayloadRT rayPayloadNV
+#define rayPayloadInRT rayPayloadInNV
+#define LaunchIDRT gl_LaunchIDNV
+#define LaunchSizeRT gl_LaunchSizeNV
+#define RayFlagsOpaqueRT gl_RayFlagsOpaqueNV
+#define RayFlagsSkipClosestHitShaderRT gl_RayFlagsSkipClosestHitShaderNV
+#define RayFlagsTerminateOnFirstHitRT gl_RayFlagsTerminateOnFirstHitNV
+#define traceRT traceNV
+#endif
 
 #depth 1
 
 #rgen
 
 layout(binding = 0, set = 0, r8) uniform image2D texShadowMask;
-layout(binding = 1, set = 0) uniform accelerationStructureNV bvh;
+layout(binding = 1, set = 0) uniform accelerationStructureRT bvh;
 layout(binding = 2, set = 0, rgba32f) uniform image2D texPosition;
+layout(binding = 3, set = 0) buffer RayList {
+  uint rayCount;
+  uint header[7];
+  uint pixels[];
+};
+
+struct Ray {
+  vec4 origin;    // xyz, tmax
+  vec4 direction; // xyz, packed pixel
+};
+
+layout(binding = 4, set = 0) buffer Rays {
+  uint classifiedCount;
+  uint classifiedHeader[7];
+  Ray rays[];
+};
 
 layout(push_constant) uniform PushConstants {
   vec3 lightPosition;
+  int mode; // 0 = full, 1 = half resolution, 2 = checkerboard, 3,4 = pixel list, 5 = ray list
 };
 
-layout(location = 0) rayPayloadNV float mask;
+layout(location = 0) rayPayloadRT float mask;
+
+void traceRay(vec3 position, vec3 dir, float tmax){
+  uint flags = RayFlagsOpaqueRT|RayFlagsSkipClosestHitShaderRT|RayFlagsTerminateOnFirstHitRT;
+  uint cullMask = 0xff;
+  float tmin = 0.001;
+
+  mask = 0;
+  traceRT(bvh, flags, cullMask, 0 /*sbtRecordOffset*/, 0 /*sbtRecordStride*/,
+      0 /*missIndex*/, position, tmin, dir, tmax, 0 /*payload*/);
+}
 
 void main(){
-  ivec2 id = ivec2(gl_LaunchIDNV.xy);
+  ivec2 launch = ivec2(LaunchIDRT.xy);
 
-  vec3 position = imageLoad(texPosition,id).xyz;
+  // classified rays, sky and back facing pixels are already resolved
+  if(mode == 5){
+    uint index = launch.y*LaunchSizeRT.x + launch.x;
+    if(index >= classifiedCount) return;
+    Ray ray = rays[index];
+    uint packed = floatBitsToUint(ray.direction.w);
+    traceRay(ray.origin.xyz, ray.direction.xyz, ray.origin.w);
+    imageStore(texShadowMask,ivec2(packed&0xffff,packed>>16),vec4(mask,0,0,0));
+    return;
+  }
+
+  // pixel to trace and where the result is stored
+  ivec2 pixel = launch;
+  ivec2 id = launch;
+  if(mode == 1){
+    pixel = launch*2;
+  } else if(mode == 2){
+    pixel = ivec2(launch.x*2 + (launch.y&1), launch.y);
+    id = pixel;
+  } else if(mode == 3 || mode == 4){
+    // indirect launches are rayCount wide, conservative ones have work in the first rayCount threads only
+    uint index = launch.y*LaunchSizeRT.x + launch.x;
+    if(index >= rayCount) return;
+    uint packed = pixels[index];
+    pixel = ivec2(packed&0xffff,packed>>16);
+    id = pixel;
+  }
+
+  if(any(greaterThanEqual(pixel,imageSize(texPosition)))) return;
+
+  vec3 position = imageLoad(texPosition,pixel).xyz;
   vec3 dir = normalize(lightPosition-position);
-  
+
   // no geometry in gbuffer
   if(position==vec3(0,0,0)){
     mask = 1;
@@ -27,20 +107,12 @@ void main(){
     return;
   }
 
-  uint flags = gl_RayFlagsOpaqueNV|gl_RayFlagsSkipClosestHitShaderNV|gl_RayFlagsTerminateOnFirstHitNV;
-  uint cullMask = 0xff;
-  float tmin = 0.001;
-  float tmax = length(lightPosition-position);
-
-  mask = 0;
-  traceNV(bvh, flags, cullMask, 0 /*sbtRecordOffset*/, 0 /*sbtRecordStride*/,
-      0 /*missIndex*/, position, tmin, dir, tmax, 0 /*payload*/);
-
+  traceRay(position, dir, length(lightPosition-position));
   imageStore(texShadowMask,id,vec4(mask,0,0,0));
 }
 
 #rmiss
-layout(location = 0) rayPayloadInNV float mask;
+layout(location = 0) rayPayloadInRT float mask;
 
 void main(){
   mask = 1;
@@ -0,0 +1,101 @@
+#version 450
+#dynamic 0 0
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform Temporal {
+  mat4 vp;
+  mat4 prevVP;
+  ivec4 params; // x = frame, y = history valid, z = refresh period, w = rays counter
+};
+
+layout(set = 0, binding = 1, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 2, r32f) uniform image2D texDepth;
+layout(set = 0, binding = 3, r8) uniform image2D texShadowHistory;
+layout(set = 0, binding = 4, r32f) uniform image2D texDepthHistory;
+layout(set = 0, binding = 5, rgba32f) uniform image2D texPosition;
+
+// header is laid out as indirect commands - trace (rayCount,1,1), dispatch (groupsX,1,1)
+layout(set = 0, binding = 6) buffer RayList {
+  uint rayCount;
+  uint rayHeight;
+  uint rayDepth;
+  uint groupsX;
+  uint groupsY;
+  uint groupsZ;
+  uint pad[2];
+  uint pixels[];
+};
+
+layout(set = 0, binding = 7) buffer Counters {
+  uint counters[];
+};
+
+shared uint groupCount;
+shared uint groupBase;
+
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(texShadowMask);
+
+  if(gl_LocalInvocationIndex == 0) groupCount = 0;
+  barrier();
+
+  bool trace = false;
+  uint local = 0;
+
+  if(all(lessThan(id,size))){
+    vec3 position = imageLoad(texPosition,id).xyz;
+    float depth = 0;
+
+    if(position==vec3(0,0,0)){
+      imageStore(texShadowMask,id,vec4(1,0,0,0));
+    } else {
+      depth = (vp*vec4(position,1)).w;
+
+      vec4 prev = prevVP*vec4(position,1);
+      ivec2 prevId = ivec2((prev.xy/prev.w*0.5+0.5)*vec2(size));
+      trace = params.y == 0 || prev.w <= 0 || any(lessThan(prevId,ivec2(0))) || any(greaterThanEqual(prevId,size));
+
+      // disocclusion
+      if(!trace){
+        float prevDepth = imageLoad(texDepthHistory,prevId).x;
+        trace = abs(prevDepth-prev.w) > 0.01*prev.w;
+      }
+
+      // shadow edge in history
+      float history = 0;
+      if(!trace){
+        float minMask = 1;
+        float maxMask = 0;
+        for(int y=-1;y<=1;y++){
+          for(int x=-1;x<=1;x++){
+            float m = imageLoad(texShadowHistory,clamp(prevId+ivec2(x,y),ivec2(0),size-1)).x;
+            minMask = min(minMask,m);
+            maxMask = max(maxMask,m);
+          }
+        }
+        history = imageLoad(texShadowHistory,prevId).x;
+        trace = maxMask-minMask > 0.5;
+      }
+
+      // periodic refresh so errors don't persist
+      trace = trace || (id.x+id.y*5+params.x)%params.z == 0;
+
+      if(trace) local = atomicAdd(groupCount,1);
+      else imageStore(texShadowMask,id,vec4(history,0,0,0));
+    }
+    imageStore(texDepth,id,vec4(depth,0,0,0));
+  }
+
+  barrier();
+  if(gl_LocalInvocationIndex == 0 && groupCount > 0){
+    groupBase = atomicAdd(rayCount,groupCount);
+    atomicMax(groupsX,(groupBase+groupCount+63)/64);
+    atomicAdd(counters[params.w],groupCount);
+  }
+  barrier();
+
+  if(trace) pixels[groupBase+local] = (uint(id.y)<<16)|uint(id.x);
+}
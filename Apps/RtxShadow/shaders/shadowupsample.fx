@@ -0,0 +1,88 @@
+#version 450
+
+#comp
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(push_constant) uniform PushConstants {
+  int mode; // 1 = half resolution, 2 = checkerboard
+};
+
+layout(set = 0, binding = 0, r8) uniform image2D texShadowMask;
+layout(set = 0, binding = 1, r8) uniform image2D texSparseMask;
+layout(set = 0, binding = 2, rgba32f) uniform image2D texPosition;
+layout(set = 0, binding = 3, rgba16f) uniform image2D texNormal;
+
+// how much sample belongs to surface of the pixel
+float weight(vec3 position, vec3 normal, ivec2 sample){
+  vec3 samplePosition = imageLoad(texPosition,sample).xyz;
+  vec3 sampleNormal = imageLoad(texNormal,sample).xyz;
+  if(sampleNormal==vec3(0,0,0)) return 0;
+
+  vec3 d = samplePosition-position;
+  float planeDistance = abs(dot(normal,d))/(length(d)+1e-4);
+  float wPlane = max(0,1-4*planeDistance);
+  float wNormal = pow(max(0,dot(normal,normalize(sampleNormal))),8);
+  return wPlane*wNormal;
+}
+
+void main() {
+  ivec2 id = ivec2(gl_GlobalInvocationID.xy);
+
+  ivec2 size = imageSize(texShadowMask);
+  if(any(greaterThanEqual(id,size))) return;
+
+  vec3 normal = imageLoad(texNormal,id).xyz;
+  if(normal==vec3(0,0,0)){
+    imageStore(texShadowMask,id,vec4(1,0,0,0));
+    return;
+  }
+  normal = normalize(normal);
+  vec3 position = imageLoad(texPosition,id).xyz;
+
+  float mask = 0;
+  float sum = 0;
+  // fallback if no sample is on the same surface
+  float nearest = 0;
+
+  if(mode == 1){
+    if(all(equal(id&1,ivec2(0)))){
+      imageStore(texShadowMask,id,imageLoad(texSparseMask,id/2));
+      return;
+    }
+
+    ivec2 base = max((id-1)/2,ivec2(0));
+    vec2 f = (vec2(id)-vec2(base*2))*0.5;
+    nearest = imageLoad(texSparseMask,min((id+1)/2,(size-1)/2)).x;
+    for(int y=0;y<2;y++){
+      for(int x=0;x<2;x++){
+        ivec2 c = min(base+ivec2(x,y),(size-1)/2);
+        float bilinear = (x==0?1-f.x:f.x)*(y==0?1-f.y:f.y);
+        float w = bilinear*weight(position,normal,c*2);
+        mask += w*imageLoad(texSparseMask,c).x;
+        sum += w;
+      }
+    }
+  } else {
+    if(((id.x+id.y)&1)==0){
+      imageStore(texShadowMask,id,imageLoad(texSparseMask,id));
+      return;
+    }
+
+    const ivec2 offsets[4] = ivec2[](ivec2(-1,0),ivec2(1,0),ivec2(0,-1),ivec2(0,1));
+    float count = 0;
+    for(int i=0;i<4;i++){
+      ivec2 c = id+offsets[i];
+      if(any(lessThan(c,ivec2(0))) || any(greaterThanEqual(c,size))) continue;
+      float w = weight(position,normal,c);
+      float s = imageLoad(texSparseMask,c).x;
+      mask += w*s;
+      sum += w;
+      nearest += s;
+      count++;
+    }
+    nearest /= max(count,1);
+  }
+
+  mask = sum > 1e-3 ? mask/sum : nearest;
+  imageStore(texShadowMask,id,vec4(mask,0,0,0));
+}
@@ -0,0 +1 @@
+bin\release\MicroBench.exe culling -n 4000000 -i 20
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\MicroBench.exe pools -n 1000000 -i 20
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\MicroBench.exe transforms -n 1000000 -g 4 -i 20
\ No newline at end of file
@@ -15,6 +15,7 @@ Application::Application(int argc, char** argv) {
   globalMessenger = new Messenger;
   gui = Gui::getInstance();
   fileSystem = new VirtualFileSystem;
+  threadPool = new ThreadPool;
   glfwInit();
 }
 
@@ -35,6 +36,8 @@ int Application::run() {
     while(!shouldQuit) {
       /* Poll for and process events */
       glfwPollEvents();
+      // messages posted by worker threads since the last frame
+      globalMessenger->dispatchQueued();
 
       auto now = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double> dt = now - lastFrame;
@@ -59,6 +62,7 @@ int Application::run() {
   } catch(std::system_error const& er) {
     nei_fatal("Fatal exception: {}",er.what());
   }
+  globalMessenger->dispatchQueued();
   SEND(AppMessage{AppMessage::AppExit});
   return returnCode;
 }
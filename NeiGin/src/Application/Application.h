@@ -9,6 +9,7 @@
 
 #define WAIT_JOBS() Application::getInstance()->getThreadPool()->waitIdle()
 #define SEND(X) Application::getInstance()->getMessenger()->send(X)
+#define POST(X) Application::getInstance()->getMessenger()->post(X)
 #define LISTEN(T,...) Application::getInstance()->getMessenger()->addListener<T>(__VA_ARGS__)
 #define LISTEN2(T,...) Application::getInstance()->getMessenger()->addListener<T>([&](T const& msg){__VA_ARGS__})
 
@@ -37,6 +38,8 @@ namespace Nei {
     Ptr<Gui>& getGui() { return gui; }
     VirtualFileSystem* getFileSystem() { return fileSystem; }
     AssetManager* getAssetManager() { return assetManager; }
+    // workers for per frame jobs, one thread per core with the main thread
+    ThreadPool* getThreadPool() { return threadPool; }
 
     static Application* getInstance();
 
@@ -49,6 +52,7 @@ namespace Nei {
     Ptr<Gui> gui;
     Ptr<VirtualFileSystem> fileSystem;
     Ptr<AssetManager> assetManager;
+    Ptr<ThreadPool> threadPool;
 
     static Application* globalInstance;
 
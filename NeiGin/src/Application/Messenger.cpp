@@ -2,5 +2,34 @@
 
 using namespace Nei;
 
+namespace {
+  std::mutex typeMutex;
+  std::map<std::string, int> typeIds;
+}
+
 Messenger::Messenger() {
 }
+
+Messenger::~Messenger() {
+  while(auto msg = queue.pop()) delete msg;
+}
+
+int Messenger::registerType(char const* name) {
+  std::lock_guard lock(typeMutex);
+  auto it = typeIds.try_emplace(name, int(typeIds.size())).first;
+  return it->second;
+}
+
+void Messenger::removeListener(int id) {
+  for(auto& v : listeners) {
+    v.erase(std::remove_if(v.begin(), v.end(),
+      [&](Ptr<BaseListener> const& l) { return l->getId() == id; }), v.end());
+  }
+}
+
+void Messenger::dispatchQueued() {
+  while(auto msg = queue.pop()) {
+    msg->send(this);
+    delete msg;
+  }
+}
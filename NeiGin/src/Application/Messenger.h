@@ -1,7 +1,7 @@
 #pragma once
 
 #include "NeiGinBase.h"
-#include <typeindex>
+#include "MpscQueue.h"
 
 namespace Nei {
   class BaseListener : public Object {
@@ -12,47 +12,80 @@ namespace Nei {
   };
 
   template <typename T>
-  class Listener : public BaseListener {
+  class Listener : public BaseListener, public Pooled<Listener<T>> {
   public:
-    Listener(std::function<void(T const&)> callback, int id): callback(callback), id(id) { }
+    Listener(std::function<void(T const&)> callback, int id): callback(callback) { this->id = id; }
 
     void operator()(T const& msg) {
       if(callback) callback(msg);
     }
 
   protected:
-    int id;
     std::function<void(T const&)> callback;
   };
 
-  class Messenger : public Object {
+  // Listeners are kept in a flat table indexed by message type id, send is a plain loop without lookups or casts.
+  // addListener, removeListener, send and dispatchQueued belong to the main thread, post can be called from any.
+  class NEIGIN_EXPORT Messenger : public Object {
   public:
     Messenger();
+    virtual ~Messenger();
 
     template <typename T>
     int addListener(std::function<void(T const&)> callback) {
       int id = idGen++;
-      listeners[std::type_index(typeid( T))].push_back(new Listener<T>(callback,id));
+      int type = getTypeId<T>();
+      if(int(listeners.size()) <= type) listeners.resize(type + 1);
+      listeners[type].push_back(new Listener<T>(callback, id));
       return id;
     }
 
-    void removeListener(int id) {
-      for(auto& [k, v] : listeners) {
-        v.erase(std::remove_if(v.begin(), v.end(),
-          [&](Ptr<BaseListener> const& l) { return l->getId() == id; }), v.end());
-      }
-    }
+    void removeListener(int id);
 
     template <typename T>
     void send(T const& msg) {
-      for(auto& l : listeners[std::type_index(typeid( T))]) {
-        (*l->as<Listener<T>>())(msg);
+      int type = getTypeId<T>();
+      if(type >= int(listeners.size())) return;
+      // by index, listeners may add listeners
+      for(size_t i = 0; i < listeners[type].size(); i++) {
+        (*static_cast<Listener<T>*>(listeners[type][i].get()))(msg);
       }
     }
 
+    // queued until the next dispatchQueued, messages of one thread keep their order
+    template <typename T>
+    void post(T const& msg) {
+      queue.push(new PostedMessage<T>(msg));
+    }
+
+    // sends posted messages, Application::run calls it once per frame before AppFrame
+    void dispatchQueued();
+
+    // ids are handed out on first use, the same in every module
+    template <typename T>
+    static int getTypeId() {
+      static int id = registerType(typeid(T).name());
+      return id;
+    }
+
   protected:
+    static int registerType(char const* name);
+
+    struct Posted : MpscNode {
+      virtual ~Posted() = default;
+      virtual void send(Messenger* messenger) = 0;
+    };
+
+    template <typename T>
+    struct PostedMessage : Posted, Pooled<PostedMessage<T>> {
+      PostedMessage(T const& msg): msg(msg) { }
+      void send(Messenger* messenger) override { messenger->send(msg); }
+      T msg;
+    };
+
     int idGen = 0;
-    std::map<std::type_index, std::vector<Ptr<BaseListener>>> listeners;
+    std::vector<std::vector<Ptr<BaseListener>>> listeners;  // by type id
+    MpscQueue<Posted> queue;
   };
 
 }
@@ -47,7 +47,7 @@ Ptr<Texture2D> AssetManager::loadTexture2D(fs::path const& path, Ptr<TransferBuf
     }
     tex = new Texture2D(deviceContext, img->getSize(), imageToVkFormat(img->getFormat(), false));
     tex->setDataAsync(tb, img->getData());
-    tex->generateMipMaps(tb->getCommandBuffer());
+    tex->generateMipMaps(tb->getMainCommandBuffer());
 
     if(wait) {
       tb->end();
@@ -73,7 +73,7 @@ Ptr<Texture2D> AssetManager::loadTexture2D(void* data, uint size, std::string co
     }
     tex = new Texture2D(deviceContext, img->getSize(), imageToVkFormat(img->getFormat(), false));
     tex->setDataAsync(tb, img->getData());
-    tex->generateMipMaps(tb->getCommandBuffer());
+    tex->generateMipMaps(tb->getMainCommandBuffer());
 
     if(wait) {
       tb->end();
@@ -99,7 +99,7 @@ Ptr<TextureCube> AssetManager::loadTextureCube(fs::path path[6], Ptr<TransferBuf
 
     tex->setDataAsync(tb, img->getData(), i);
   }
-  tex->generateMipMaps(tb->getCommandBuffer());
+  tex->generateMipMaps(tb->getMainCommandBuffer());
 
   if(wait) {
     tb->end();
@@ -122,7 +122,7 @@ Ptr<Texture2D> AssetManager::createDummy(uvec2 const& size, Ptr<TransferBuffer>
   }
   Ptr tex = new Texture2D(deviceContext, img->getSize(), imageToVkFormat(img->getFormat(), false));
   tex->setDataAsync(tb, img->getData());
-  tex->generateMipMaps(tb->getCommandBuffer());
+  tex->generateMipMaps(tb->getMainCommandBuffer());
 
   if(wait) {
     tb->end();
@@ -92,8 +92,9 @@ void MeshBuffer::createFromMeshes(std::vector<Ptr<Mesh>>& meshes, Ptr<TransferBu
   if (indexSize)
     cmd->copy(stage, indexBuffer, indexSize, vertexSize, 0);
 
-  //vertexBuffer->transferOwnership(cmd, deviceContext->getTransferQueueIndex(), deviceContext->getMainQueueIndex());
-  //indexBuffer->transferOwnership(cmd, deviceContext->getTransferQueueIndex(), deviceContext->getMainQueueIndex());
+  tb->release(vertexBuffer);
+  if (indexSize)
+    tb->release(indexBuffer);
 
   if (wait) {
     tb->end();
@@ -7,3 +7,51 @@ AABB::AABB() {
 
 AABB::AABB(vec3 const& min, vec3 const& max): min(min), max(max) {
 }
+
+// extents of the rotated and scaled box projected on the new axes
+AABB AABB::transform(mat4 const& m) const {
+  if(!isValid()) return *this;
+  vec3 center = vec3(m * vec4((min + max) * 0.5f, 1));
+  vec3 extent = (max - min) * 0.5f;
+  vec3 newExtent = abs(vec3(m[0])) * extent.x + abs(vec3(m[1])) * extent.y + abs(vec3(m[2])) * extent.z;
+  return AABB(center - newExtent, center + newExtent);
+}
+
+uint AABBBatch::add(AABB const& box) {
+  if(count % Lanes == 0) {
+    uint padded = count + Lanes;
+    for(int a = 0; a < 3; a++) {
+      min[a].resize(padded, FLT_MAX);
+      max[a].resize(padded, -FLT_MAX);
+    }
+  }
+  set(count, box);
+  return count++;
+}
+
+void AABBBatch::set(uint i, AABB const& box) {
+  for(int a = 0; a < 3; a++) {
+    min[a][i] = box.min[a];
+    max[a][i] = box.max[a];
+  }
+}
+
+AABB AABBBatch::get(uint i) const {
+  return AABB(vec3(min[0][i], min[1][i], min[2][i]), vec3(max[0][i], max[1][i], max[2][i]));
+}
+
+void AABBBatch::clear() {
+  for(int a = 0; a < 3; a++) {
+    min[a].clear();
+    max[a].clear();
+  }
+  count = 0;
+}
+
+void AABBBatch::reserve(uint count) {
+  uint padded = (count + Lanes - 1) / Lanes * Lanes;
+  for(int a = 0; a < 3; a++) {
+    min[a].reserve(padded);
+    max[a].reserve(padded);
+  }
+}
@@ -20,9 +20,34 @@ namespace Nei{
       extend(aabb.max);
     }
 
+    // bounds of the transformed box
+    AABB transform(mat4 const& m) const;
+
     vec3 min=vec3(FLT_MAX, FLT_MAX, FLT_MAX);
     vec3 max=vec3(-FLT_MAX,-FLT_MAX,-FLT_MAX);
   };
+
+  // Boxes stored as one array per coordinate for SIMD kernels like Frustum::cull.
+  // Arrays are padded to a multiple of Lanes with empty boxes.
+  class NEIGIN_EXPORT AABBBatch {
+  public:
+    static constexpr uint Lanes = 8;
+
+    uint add(AABB const& box);
+    void set(uint i, AABB const& box);
+    AABB get(uint i) const;
+    void clear();
+    void reserve(uint count);
+
+    uint size() const { return count; }
+    float const* getMin(int axis) const { return min[axis].data(); }
+    float const* getMax(int axis) const { return max[axis].data(); }
+
+  protected:
+    std::vector<float> min[3];
+    std::vector<float> max[3];
+    uint count = 0;
+  };
 };
 
 
@@ -0,0 +1,127 @@
+#include "Frustum.h"
+#include "AABB.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define NEI_FRUSTUM_AVX2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NEI_TARGET_AVX2
+#else
+#define NEI_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+using namespace Nei;
+
+namespace {
+  // p-vertex test, the corner furthest along the plane normal has to be in front of it
+  void cullScalar(vec4 const* planes, AABBBatch const& boxes, uint begin, uint end, std::vector<uint>& visible) {
+    float const* min[3] = {boxes.getMin(0), boxes.getMin(1), boxes.getMin(2)};
+    float const* max[3] = {boxes.getMax(0), boxes.getMax(1), boxes.getMax(2)};
+    for(uint i = begin; i < end; i++) {
+      bool inside = true;
+      for(int p = 0; p < 6 && inside; p++) {
+        vec4 const& plane = planes[p];
+        float d = plane.w;
+        for(int a = 0; a < 3; a++) d += plane[a] * (plane[a] >= 0 ? max[a][i] : min[a][i]);
+        inside = d >= 0;
+      }
+      if(inside) visible.push_back(i);
+    }
+  }
+
+#if NEI_FRUSTUM_AVX2
+  // 8 boxes per iteration, the coordinate array used for each axis is picked per plane
+  NEI_TARGET_AVX2 void cullAvx2(vec4 const* planes, AABBBatch const& boxes, std::vector<uint>& visible) {
+    float const* corner[6][3];
+    __m256 normal[6][3];
+    __m256 offset[6];
+    for(int p = 0; p < 6; p++) {
+      for(int a = 0; a < 3; a++) {
+        corner[p][a] = planes[p][a] >= 0 ? boxes.getMax(a) : boxes.getMin(a);
+        normal[p][a] = _mm256_set1_ps(planes[p][a]);
+      }
+      offset[p] = _mm256_set1_ps(planes[p].w);
+    }
+
+    uint count = boxes.size();
+    uint blocks = count / AABBBatch::Lanes;
+    __m256 zero = _mm256_setzero_ps();
+    for(uint b = 0; b < blocks; b++) {
+      uint i = b * AABBBatch::Lanes;
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for(int p = 0; p < 6; p++) {
+        __m256 d = offset[p];
+        d = _mm256_fmadd_ps(normal[p][0], _mm256_loadu_ps(corner[p][0] + i), d);
+        d = _mm256_fmadd_ps(normal[p][1], _mm256_loadu_ps(corner[p][1] + i), d);
+        d = _mm256_fmadd_ps(normal[p][2], _mm256_loadu_ps(corner[p][2] + i), d);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+      }
+      uint mask = uint(_mm256_movemask_ps(inside));
+      while(mask) {
+        uint lane = 0;
+        while(!(mask & (1u << lane))) lane++;
+        visible.push_back(i + lane);
+        mask &= mask - 1;
+      }
+    }
+    cullScalar(planes, boxes, blocks * AABBBatch::Lanes, count, visible);
+  }
+#endif
+}
+
+// Gribb and Hartmann, planes are sums and differences of the rows of the matrix.
+// The near plane uses row 3 + row 2 which holds for -1..1 and is conservative for 0..1 depth.
+Frustum::Frustum(mat4 const& viewProjection) {
+  mat4 m = transpose(viewProjection);
+  planes[0] = m[3] + m[0];
+  planes[1] = m[3] - m[0];
+  planes[2] = m[3] + m[1];
+  planes[3] = m[3] - m[1];
+  planes[4] = m[3] + m[2];
+  planes[5] = m[3] - m[2];
+  for(auto& p : planes) p /= length(vec3(p));
+}
+
+bool Frustum::intersects(AABB const& box) const {
+  for(auto& p : planes) {
+    vec3 corner = vec3(p.x >= 0 ? box.max.x : box.min.x, p.y >= 0 ? box.max.y : box.min.y, p.z >= 0 ? box.max.z : box.min.z);
+    if(dot(vec3(p), corner) + p.w < 0) return false;
+  }
+  return true;
+}
+
+void Frustum::cull(AABBBatch const& boxes, std::vector<uint>& visible, Kernel kernel) const {
+  if(kernel == Kernel::Auto) kernel = hasAvx2() ? Kernel::Avx2 : Kernel::Scalar;
+#if NEI_FRUSTUM_AVX2
+  if(kernel == Kernel::Avx2 && hasAvx2()) {
+    cullAvx2(planes, boxes, visible);
+    return;
+  }
+#endif
+  cullScalar(planes, boxes, 0, boxes.size(), visible);
+}
+
+// avx2 and fma, the os has to save the ymm registers
+bool Frustum::hasAvx2() {
+#if NEI_FRUSTUM_AVX2
+  static bool supported = [] {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if(!fma || !osxsave || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "NeiGinBase.h"
+
+namespace Nei {
+  class AABB;
+  class AABBBatch;
+
+  // Six normalized planes facing inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all
+  class NEIGIN_EXPORT Frustum {
+  public:
+    enum class Kernel {
+      Auto,   // AVX2 when the cpu supports it
+      Scalar,
+      Avx2
+    };
+
+    Frustum() = default;
+    explicit Frustum(mat4 const& viewProjection);
+
+    bool intersects(AABB const& box) const;
+
+    // appends indices of boxes which intersect the frustum, in ascending order
+    void cull(AABBBatch const& boxes, std::vector<uint>& visible, Kernel kernel = Kernel::Auto) const;
+
+    static bool hasAvx2();
+
+    vec4 planes[6];
+  };
+};
@@ -15,10 +15,13 @@
 #include "Gui/Gui.h"
 
 #include "Math/Transform.h"
+#include "Math/AABB.h"
+#include "Math/Frustum.h"
 #include "Scene/Camera.h"
 #include "Scene/OrbitManipulator.h"
 #include "Scene/Mesh.h"
 #include "Scene/Light.h"
+#include "Scene/TransformHierarchy.h"
 
 #include "IO/VirtualFileSystem.h"
 
@@ -16,6 +16,8 @@ namespace Nei {
   // Math
   class Transform;
   class AABB;
+  class AABBBatch;
+  class Frustum;
 
   // Assets
   class Image;
@@ -41,6 +43,9 @@ namespace Nei {
   class ModelInstance;
   class Model;
   class Mesh;
+  class MeshPartition;
+  class TriangleSplitter;
+  class TransformHierarchy;
 
   class Material;
   class PBRMaterial;
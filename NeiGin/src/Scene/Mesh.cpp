@@ -4,6 +4,7 @@
 #include "Assets/MeshBuffer.h"
 #include "NeiVu/TransferBuffer.h"
 #include "Material.h"
+#include "MeshPartition.h"
 
 using namespace Nei;
 
@@ -39,6 +40,23 @@ void Mesh::draw(CommandBuffer* cmd, uint instanceCount) {
     cmd->draw(vertexCount, instanceCount);
 }
 
+void Mesh::draw(CommandBuffer* cmd, std::vector<MeshCluster> const& clusters, uint const* visible, uint count,
+                uint instanceCount) {
+  if(count == 0) return;
+  bind(cmd);
+  uint first = clusters[visible[0]].firstIndex;
+  uint end = first + clusters[visible[0]].indexCount;
+  for(uint i = 1; i < count; i++) {
+    auto& cluster = clusters[visible[i]];
+    if(cluster.firstIndex != end) {
+      cmd->drawIndexed(end - first, instanceCount, first);
+      first = cluster.firstIndex;
+    }
+    end = cluster.firstIndex + cluster.indexCount;
+  }
+  cmd->drawIndexed(end - first, instanceCount, first);
+}
+
 void Mesh::upload() {
   meshBuffer = new MeshBuffer(deviceContext);
   meshBuffer->createFromMesh(this);
@@ -65,10 +83,10 @@ void Mesh::setMaterials(std::vector<Ptr<Material>> const& materials) {
   this->materials = materials;
 }
 
-Ptr<Buffer> Mesh::getVertexBuffer() const {
+Ref<Buffer> Mesh::getVertexBuffer() const {
   return meshBuffer->getVertexBuffer();
 }
 
-Ptr<Buffer> Mesh::getIndexBuffer() const {
+Ref<Buffer> Mesh::getIndexBuffer() const {
   return meshBuffer->getIndexBuffer();
 }
@@ -5,6 +5,8 @@
 #include "Material.h"
 
 namespace Nei{
+  struct MeshCluster;
+
   class NEIGIN_EXPORT Mesh : public Node{
   public:
     Mesh(DeviceContext* dc);
@@ -16,6 +18,9 @@ namespace Nei{
        
     void bind(CommandBuffer* cmd);
     void draw(CommandBuffer* cmd, uint instanceCount = 1);
+    // draws only the listed clusters (see MeshPartition), indices ascending so neighbouring ranges are merged
+    void draw(CommandBuffer* cmd, std::vector<MeshCluster> const& clusters, uint const* visible, uint count,
+              uint instanceCount = 1);
 
     void upload();
     
@@ -40,10 +45,10 @@ namespace Nei{
     void setMaterials(std::vector<Ptr<Material>> const& materials);
     auto& getMaterials() const { return materials; }
 
-    Ptr<Buffer> getVertexBuffer()const;
+    Ref<Buffer> getVertexBuffer()const;
     uint getVertexBufferOffset()const {return vertexBufferOffset;}
 
-    Ptr<Buffer> getIndexBuffer()const;
+    Ref<Buffer> getIndexBuffer()const;
     uint getIndexBufferOffset()const{return indexBufferOffset;}
 
   protected:
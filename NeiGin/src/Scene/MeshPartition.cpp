@@ -0,0 +1,186 @@
+#include "MeshPartition.h"
+#include "Mesh.h"
+
+#include <queue>
+
+using namespace Nei;
+
+namespace {
+  const int sahBins = 32;
+
+  struct Triangle {
+    vec3 centroid;
+    AABB bounds;
+    uint index;
+  };
+
+  struct Range {
+    uint first;
+    uint count;
+    AABB bounds;
+    AABB centroids;
+  };
+
+  float area(AABB const& b) {
+    if(!b.isValid()) return 0;
+    vec3 d = b.max - b.min;
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  void measure(std::vector<Triangle> const& triangles, Range& range) {
+    range.bounds = AABB();
+    range.centroids = AABB();
+    for(uint i = range.first; i < range.first + range.count; i++) {
+      range.bounds.extend(triangles[i].bounds);
+      range.centroids.extend(triangles[i].centroid);
+    }
+  }
+
+  // returns number of triangles in the left part, 0 if the range can't be split
+  uint splitMedian(std::vector<Triangle>& triangles, Range const& range) {
+    vec3 extent = range.centroids.max - range.centroids.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    auto begin = triangles.begin() + range.first;
+    auto mid = begin + range.count / 2;
+    std::nth_element(begin, mid, begin + range.count, [axis](Triangle const& a, Triangle const& b) {
+      return a.centroid[axis] < b.centroid[axis];
+    });
+    return range.count / 2;
+  }
+
+  uint splitSah(std::vector<Triangle>& triangles, Range const& range) {
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestBin = 0;
+
+    for(int axis = 0; axis < 3; axis++) {
+      float lo = range.centroids.min[axis];
+      float extent = range.centroids.max[axis] - lo;
+      if(extent <= 0) continue;
+
+      AABB bins[sahBins];
+      uint counts[sahBins] = {};
+      for(uint i = range.first; i < range.first + range.count; i++) {
+        int b = glm::min(sahBins - 1, int((triangles[i].centroid[axis] - lo) / extent * sahBins));
+        bins[b].extend(triangles[i].bounds);
+        counts[b]++;
+      }
+
+      // sweep from the right, then evaluate every plane from the left
+      float rightArea[sahBins];
+      uint rightCount[sahBins];
+      AABB acc;
+      uint count = 0;
+      for(int b = sahBins - 1; b > 0; b--) {
+        acc.extend(bins[b]);
+        count += counts[b];
+        rightArea[b] = area(acc);
+        rightCount[b] = count;
+      }
+
+      acc = AABB();
+      count = 0;
+      for(int b = 0; b < sahBins - 1; b++) {
+        acc.extend(bins[b]);
+        count += counts[b];
+        if(count == 0 || rightCount[b + 1] == 0) continue;
+        float cost = area(acc) * count + rightArea[b + 1] * rightCount[b + 1];
+        if(cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestBin = b;
+        }
+      }
+    }
+
+    if(bestAxis < 0) return splitMedian(triangles, range);
+
+    float lo = range.centroids.min[bestAxis];
+    float extent = range.centroids.max[bestAxis] - lo;
+    auto begin = triangles.begin() + range.first;
+    auto mid = std::partition(begin, begin + range.count, [&](Triangle const& t) {
+      return glm::min(sahBins - 1, int((t.centroid[bestAxis] - lo) / extent * sahBins)) <= bestBin;
+    });
+    return uint(mid - begin);
+  }
+}
+
+std::vector<MeshCluster> MeshPartition::split(Mesh* mesh, int clusters, Method method) {
+  auto stride = mesh->getVertexLayout().stride;
+  auto vertices = static_cast<uint8*>(mesh->vertexPtr());
+  auto indices = mesh->indexPtr();
+  uint triangleCount = mesh->getIndexCount() / 3;
+
+  // position is the first vertex attribute
+  auto position = [&](uint index) { return *reinterpret_cast<vec3*>(vertices + index * stride); };
+
+  std::vector<Triangle> triangles(triangleCount);
+  for(uint i = 0; i < triangleCount; i++) {
+    auto& t = triangles[i];
+    t.index = i;
+    for(int k = 0; k < 3; k++) t.bounds.extend(position(indices[i * 3 + k]));
+    t.centroid = (t.bounds.min + t.bounds.max) * 0.5f;
+  }
+
+  // always split the range with the highest surface area cost
+  auto cost = [](Range const& r) { return area(r.bounds) * r.count; };
+  auto compare = [&](Range const& a, Range const& b) { return cost(a) < cost(b); };
+  std::priority_queue<Range, std::vector<Range>, decltype(compare)> queue(compare);
+  std::vector<Range> done;
+
+  Range root = {0, triangleCount};
+  measure(triangles, root);
+  queue.push(root);
+
+  while(!queue.empty() && int(queue.size() + done.size()) < clusters) {
+    auto range = queue.top();
+    queue.pop();
+
+    uint left = range.count < 2 ? 0 : method == Method::Sah ? splitSah(triangles, range) : splitMedian(triangles, range);
+    if(left == 0 || left == range.count) {
+      done.push_back(range);
+      continue;
+    }
+
+    Range a = {range.first, left};
+    Range b = {range.first + left, range.count - left};
+    measure(triangles, a);
+    measure(triangles, b);
+    queue.push(a);
+    queue.push(b);
+  }
+  while(!queue.empty()) {
+    done.push_back(queue.top());
+    queue.pop();
+  }
+
+  std::sort(done.begin(), done.end(), [](Range const& a, Range const& b) { return a.first < b.first; });
+
+  // triangles of a cluster are contiguous in the new index order
+  std::vector<uint32> reordered(triangleCount * 3);
+  for(uint i = 0; i < triangleCount; i++) {
+    for(int k = 0; k < 3; k++) reordered[i * 3 + k] = indices[triangles[i].index * 3 + k];
+  }
+  memcpy(indices, reordered.data(), reordered.size() * sizeof(uint32));
+
+  std::vector<MeshCluster> ret;
+  for(auto& r : done) {
+    MeshCluster c;
+    c.firstIndex = r.first * 3;
+    c.indexCount = r.count * 3;
+    c.bounds = r.bounds;
+    ret.push_back(c);
+  }
+  return ret;
+}
+
+float MeshPartition::overlap(std::vector<MeshCluster> const& clusters) {
+  AABB all;
+  float sum = 0;
+  for(auto& c : clusters) {
+    all.extend(c.bounds);
+    sum += area(c.bounds);
+  }
+  float total = area(all);
+  return total > 0 ? sum / total : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "NeiGinBase.h"
+#include "Math/AABB.h"
+
+namespace Nei {
+  struct MeshCluster {
+    uint firstIndex = 0;
+    uint indexCount = 0;
+    AABB bounds;
+  };
+
+  // Splits a triangle list into spatially coherent clusters, each cluster gets its own bottom level BVH
+  // so nodes don't span the whole scene. Mesh indices are reordered so every cluster is a contiguous range,
+  // the mesh has to be uploaded again afterwards.
+  class NEIGIN_EXPORT MeshPartition {
+  public:
+    enum class Method {
+      Sah,   // binned surface area heuristic over triangle centroids
+      Median // centroid median on the longest axis
+    };
+
+    static std::vector<MeshCluster> split(Mesh* mesh, int clusters, Method method = Method::Sah);
+
+    // sum of cluster surface areas relative to the whole mesh, 1 means no overlap and no empty space
+    static float overlap(std::vector<MeshCluster> const& clusters);
+  };
+};
@@ -3,30 +3,59 @@
 #include "Mesh.h"
 #include "NeiVu/Buffer.h"
 #include "Assets/MeshBuffer.h"
+#include "NeiVu/DeviceContext.h"
+#include <fstream>
+#include <algorithm>
 
 using namespace Nei;
 
-RaytracingBVH::RaytracingBVH(DeviceContext* dc): DeviceObject(dc) { }
+namespace {
+  // fnv-1a
+  uint64 hash(void const* data, size_t size, uint64 h = 14695981039346656037ull) {
+    auto bytes = (uint8 const*)data;
+    for(size_t i = 0; i < size; i++) h = (h ^ bytes[i]) * 1099511628211ull;
+    return h;
+  }
+}
+
+RaytracingBVH::RaytracingBVH(DeviceContext* dc, AccelerationStructure::Api api): DeviceObject(dc), api(api) { }
 
 RaytracingBVH::~RaytracingBVH() { }
 
+void RaytracingBVH::setHostBuild(ThreadPool* pool, int threads) {
+  if(threads > 0 && (api != AccelerationStructure::Api::KHR || !deviceContext->supportsHostBuilds())) {
+    nei_warning("Host BVH builds need KHR acceleration structures and host commands, building on device");
+    threads = 0;
+  }
+  hostThreads = threads;
+  hostPool = pool;
+}
+
 void RaytracingBVH::buildTop(CommandBuffer* cmd) {
-  mat4 tr(1);
-  vk::GeometryInstance instance;
-  memcpy(instance.transform, &tr, sizeof(instance.transform));
-  instance.instanceId = instances.size();
-  instance.mask = 0xFF;
-  instance.instanceOffset = 0;
-  instance.flags = uint(vk::GeometryInstanceFlagBitsNV::eTriangleCullDisable);
-  instance.accelerationStructureHandle = bottomLevel->getHandle();
-  instances.push_back(instance);
+  buildHostPending(cmd);
+  if(instances.empty()) {
+    for(int i = 0; i < bottomLevels.size(); i++) addInstance(i);
+  }
+
+  for(int i = 0; i < instances.size(); i++)
+    instances[i].accelerationStructureHandle = bottomLevels[instanceBottoms[i]]->getHandle();
+  dirtyInstances.clear();
+  std::fill(dirtyFrames.begin(), dirtyFrames.end(), 0);
 
-  topLevel = new AccelerationStructure(deviceContext);
+  topLevel = new AccelerationStructure(deviceContext, api);
   topLevel->setUpdatable(updatableTop);
+  topLevel->setCompactable(compactTop);
+  topLevel->setFramesInFlight(framesInFlight);
   topLevel->build(cmd, instances);
+  uploadedCount = int(instances.size());
+  topQueried = false;
+}
+
+int RaytracingBVH::buildBottom(CommandBuffer* cmd, Mesh* mesh) {
+  return buildBottom(cmd, mesh, 0, mesh->getIndexCount());
 }
 
-void RaytracingBVH::buildBottom(CommandBuffer* cmd, Mesh* mesh) {
+int RaytracingBVH::buildBottom(CommandBuffer* cmd, Mesh* mesh, uint firstIndex, uint indexCount) {
   vk::GeometryNV geometry;
   geometry.geometryType = vk::GeometryTypeNV::eTriangles;
   geometry.geometry.triangles.vertexData = *mesh->getVertexBuffer();
@@ -36,42 +65,242 @@ void RaytracingBVH::buildBottom(CommandBuffer* cmd, Mesh* mesh) {
   assert(mesh->getVertexLayout().attributes[0].format == vk::Format::eR32G32B32Sfloat);
   geometry.geometry.triangles.vertexFormat = vk::Format::eR32G32B32Sfloat;
   geometry.geometry.triangles.indexData = *mesh->getIndexBuffer();
-  geometry.geometry.triangles.indexOffset = mesh->getIndexBufferOffset();
-  geometry.geometry.triangles.indexCount = mesh->getIndexCount();
+  geometry.geometry.triangles.indexOffset = mesh->getIndexBufferOffset() + firstIndex * sizeof(uint32);
+  geometry.geometry.triangles.indexCount = indexCount;
   geometry.geometry.triangles.indexType = vk::IndexType::eUint32;
   geometry.geometry.triangles.transformData = nullptr;
   geometry.geometry.triangles.transformOffset = 0;
   geometry.flags = vk::GeometryFlagBitsNV::eOpaque;
-  geometries.push_back(geometry);
+  geometries.push_back({geometry});
 
-  bottomLevel = new AccelerationStructure(deviceContext);
+  Ptr bottomLevel = new AccelerationStructure(deviceContext, api);
   bottomLevel->setUpdatable(updatableBottom);
-  bottomLevel->build(cmd, geometries);
+  bottomLevel->setCompactable(compactBottom);
+  bottomLevel->setFramesInFlight(framesInFlight);
+  bottomLevels.push_back(bottomLevel);
+  int bottom = int(bottomLevels.size()) - 1;
+
+  // updatable structures are rebuilt from geometry and need scratch, never cached
+  bool cacheable = !cacheDirectory.empty() && api == AccelerationStructure::Api::KHR && !updatableBottom;
+  cacheKeys.push_back(cacheable ? cacheKey(mesh, firstIndex, indexCount) : "");
+  cached.push_back(false);
+
+  if(loadCache(bottom)) return bottom;
+
+  if(hostThreads > 0 && !updatableBottom) {
+    AccelerationStructure::HostTriangles data;
+    data.vertices = mesh->vertexPtr();
+    data.indices = mesh->indexPtr() + firstIndex;
+    bottomLevel->prepareHost(geometries.back(), {data});
+    hostPending.push_back(bottomLevel);
+  } else {
+    bottomLevel->build(cmd, geometries.back());
+  }
+  // host builds finish in buildTop, before the command buffer is submitted
+  if(compactBottom) bottomLevel->queryCompactedSize(cmd);
+  return bottom;
 }
 
 void RaytracingBVH::rebuildTop(CommandBuffer* cmd) {
-  topLevel->rebuild(cmd,instances);
+  if(!swapUploaded) uploadInstances();
+  swapUploaded = false;
+  topLevel->rebuild(cmd);
 }
 
 void RaytracingBVH::rebuildBottom(CommandBuffer* cmd) {
-  bottomLevel->rebuild(cmd,geometries);
+  for(int i = 0; i < bottomLevels.size(); i++)
+    bottomLevels[i]->rebuild(cmd, geometries[i]);
 }
 
 void RaytracingBVH::updateTop(CommandBuffer* cmd) {
   nei_assert(updatableTop);
-  topLevel->update(cmd,instances);
+  if(!swapUploaded) uploadInstances();
+  swapUploaded = false;
+  topLevel->update(cmd);
 }
 
 void RaytracingBVH::updateBottom(CommandBuffer* cmd) {
   nei_assert(updatableBottom);
-  bottomLevel->update(cmd,geometries);
+  for(int i = 0; i < bottomLevels.size(); i++)
+    bottomLevels[i]->update(cmd, geometries[i]);
 }
 
+int RaytracingBVH::addInstance(int bottom, mat4 const& transform, uint mask) {
+  nei_assert(!topLevel && bottom < bottomLevels.size());
+  vk::GeometryInstance instance;
+  instance.instanceId = uint(instances.size());
+  instance.mask = mask;
+  instance.instanceOffset = 0;
+  instance.flags = uint(vk::GeometryInstanceFlagBitsNV::eTriangleCullDisable);
+  instance.accelerationStructureHandle = 0;
+  instances.push_back(instance);
+  instanceBottoms.push_back(bottom);
+  dirtyFrames.push_back(0);
+
+  setTransform(int(instances.size()) - 1, transform);
+  return int(instances.size()) - 1;
+}
+
+void RaytracingBVH::setTransform(int instance, mat4 const& transform) {
+  // 3x4 row major
+  mat4 rows = transpose(transform);
+  memcpy(instances[instance].transform, &rows, sizeof(instances[instance].transform));
+  markDirty(instance);
+}
+
+void RaytracingBVH::setMask(int instance, uint mask) {
+  instances[instance].mask = mask;
+  markDirty(instance);
+}
 
 AccelerationStructure* RaytracingBVH::getTop() const {
   return topLevel;
 }
 
-void RaytracingBVH::compactBottom() {
-  bottomLevel->compact();
+uint64 RaytracingBVH::getMemorySize() const {
+  uint64 size = topLevel ? topLevel->getSize() : 0;
+  for(auto& b : bottomLevels) size += b->getSize();
+  return size;
+}
+
+bool RaytracingBVH::compact(CommandBuffer* cmd) {
+  swapUploaded = false;
+  bool bottomsChanged = false;
+  for(auto& b : bottomLevels) bottomsChanged |= b->compact(cmd);
+
+  // compacted bottom levels have new handles, top level is rebuilt before it is compacted itself
+  if(bottomsChanged) {
+    for(int i = 0; i < instances.size(); i++) {
+      instances[i].accelerationStructureHandle = bottomLevels[instanceBottoms[i]]->getHandle();
+      markDirty(i);
+    }
+    rebuildTop(cmd);
+    swapUploaded = true;
+  }
+
+  if(compactTop && !topQueried && !isBottomCompactionPending()) {
+    topLevel->queryCompactedSize(cmd);
+    topQueried = true;
+  }
+  return topLevel->compact(cmd);
+}
+
+bool RaytracingBVH::isCompactionDone() const {
+  if(compactTop && !topQueried) return false;
+  if(!topLevel->isCompactionDone()) return false;
+  for(auto& b : bottomLevels)
+    if(!b->isCompactionDone()) return false;
+  return true;
+}
+
+bool RaytracingBVH::isBottomCompactionPending() const {
+  for(auto& b : bottomLevels)
+    if(b->isCompactionPending()) return true;
+  return false;
+}
+
+void RaytracingBVH::setCache(fs::path const& directory) {
+  nei_assert(bottomLevels.empty());
+  if(api != AccelerationStructure::Api::KHR) {
+    nei_warning("BVH cache needs KHR acceleration structures, disabled");
+    return;
+  }
+  cacheDirectory = directory;
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+}
+
+void RaytracingBVH::storeCache() {
+  int stored = 0;
+  for(int i = 0; i < bottomLevels.size(); i++) {
+    if(cached[i] || cacheKeys[i].empty()) continue;
+    auto data = bottomLevels[i]->serialize();
+    auto path = cacheDirectory / (cacheKeys[i] + ".bvh");
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      nei_error("Failed to open BVH cache for writing! {}", path.string());
+      continue;
+    }
+    file.write((char const*)data.data(), data.size());
+    cached[i] = true;
+    stored++;
+  }
+  if(stored) nei_log("BVH cache stored {} bottom levels", stored);
+}
+
+int RaytracingBVH::getCachedCount() const {
+  return int(std::count(cached.begin(), cached.end(), true));
+}
+
+// vertex data, index range and device, the blob itself carries the driver version
+std::string RaytracingBVH::cacheKey(Mesh* mesh, uint firstIndex, uint indexCount) {
+  auto it = meshHashes.find(mesh);
+  if(it == meshHashes.end()) {
+    auto h = hash(mesh->vertexPtr(), size_t(mesh->getVertexCount()) * mesh->getVertexLayout().stride);
+    it = meshHashes.emplace(mesh, h).first;
+  }
+
+  vk::PhysicalDeviceIDProperties idProps;
+  vk::PhysicalDeviceProperties2 props;
+  props.pNext = &idProps;
+  deviceContext->getVkPhysicalDevice().getProperties2(&props);
+
+  uint64 h = it->second;
+  h = hash(mesh->indexPtr() + firstIndex, indexCount * sizeof(uint32), h);
+  h = hash(&firstIndex, sizeof(firstIndex), h);
+  h = hash(idProps.deviceUUID.data(), VK_UUID_SIZE, h);
+  h = hash(&props.properties.driverVersion, sizeof(uint32), h);
+  return fmt::format("{:016x}", h);
+}
+
+bool RaytracingBVH::loadCache(int bottom) {
+  if(cacheKeys[bottom].empty()) return false;
+  auto path = cacheDirectory / (cacheKeys[bottom] + ".bvh");
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if(!file.is_open()) return false;
+
+  std::vector<uint8> data(size_t(file.tellg()));
+  file.seekg(0);
+  file.read((char*)data.data(), data.size());
+
+  if(!bottomLevels[bottom]->deserialize(data)) {
+    nei_warning("BVH cache rejected by driver, rebuilding {}", path.string());
+    return false;
+  }
+  cached[bottom] = true;
+  return true;
+}
+
+void RaytracingBVH::buildHostPending(CommandBuffer* cmd) {
+  AccelerationStructure::buildHost(deviceContext, hostPending, hostPool, hostThreads);
+  // host visible memory is read over the bus by every ray. The compacted copy is device local already and
+  // its queried size belongs to the host built structure, so only uncompacted levels are cloned
+  if(!compactBottom && !hostPending.empty()) {
+    uint64 size = 0;
+    for(auto b : hostPending) {
+      b->copyToDevice(cmd);
+      size += b->getSize();
+    }
+    nei_log("Host BVH {} bottom levels copied to device local memory, {} kB", hostPending.size(), size / 1024);
+  }
+  hostPending.clear();
+}
+
+void RaytracingBVH::markDirty(int instance) {
+  if(!topLevel) return;
+  if(dirtyFrames[instance] == 0) dirtyInstances.push_back(instance);
+  dirtyFrames[instance] = framesInFlight;
+}
+
+// every ring slot receives the change once, instances left untouched are not copied
+void RaytracingBVH::uploadInstances() {
+  auto mapped = topLevel->mapInstances();
+  uploadedCount = int(dirtyInstances.size());
+
+  int kept = 0;
+  for(auto i : dirtyInstances) {
+    mapped[i] = instances[i];
+    if(--dirtyFrames[i] > 0) dirtyInstances[kept++] = i;
+  }
+  dirtyInstances.resize(kept);
 }
@@ -17,15 +17,32 @@ namespace Nei{
 
   class NEIGIN_EXPORT RaytracingBVH : public DeviceObject{
   public:
-    RaytracingBVH(DeviceContext* dc);
+    RaytracingBVH(DeviceContext* dc, AccelerationStructure::Api api = AccelerationStructure::Api::NV);
     virtual ~RaytracingBVH();
 
     void setUpdatable(bool top, bool bottom){
       updatableTop=top;
       updatableBottom=bottom;}
-    
+
+    // levels are compacted in the background, see compact, set before building
+    void setCompaction(bool top, bool bottom){
+      compactTop=top;
+      compactBottom=bottom;}
+
+    // static KHR bottom levels are built by the cpu on up to threads jobs of the pool, 0 builds on the device
+    // host builds run batched in buildTop and are then copied to device local memory. With bottom compaction
+    // the compacted copy moves them instead
+    void setHostBuild(ThreadPool* pool, int threads);
+
+    // instance data of frames still in flight is not overwritten, set before buildTop
+    void setFramesInFlight(int frames) { framesInFlight = frames; }
+
+    // one identity instance per bottom level if no instances were added
     void buildTop(CommandBuffer* cmd);
-    void buildBottom(CommandBuffer* cmd, Mesh* mesh);
+    // returns bottom level index
+    int buildBottom(CommandBuffer* cmd, Mesh* mesh);
+    // triangles from an index range, see MeshPartition
+    int buildBottom(CommandBuffer* cmd, Mesh* mesh, uint firstIndex, uint indexCount);
 
     void rebuildTop(CommandBuffer* cmd);
     void rebuildBottom(CommandBuffer* cmd);
@@ -33,17 +50,67 @@ namespace Nei{
     void updateTop(CommandBuffer* cmd);
     void updateBottom(CommandBuffer* cmd);
 
+    // instance count is fixed by buildTop, changed instances are uploaded by the next top rebuild/update
+    int addInstance(int bottom, mat4 const& transform = mat4(1), uint mask = 0xFF);
+    void setTransform(int instance, mat4 const& transform);
+    void setMask(int instance, uint mask);
+    int getInstanceCount() const { return int(instances.size()); }
+    // instances written by the last top rebuild/update
+    int getUploadedCount() const { return uploadedCount; }
+
     AccelerationStructure* getTop() const;
+    int getBottomCount() const { return int(bottomLevels.size()); }
+    // structure buffers of all levels, scratch not included
+    uint64 getMemorySize() const;
+
+    // call once per frame before the top level is updated, swaps in compacted structures as their sizes arrive
+    // bottom level swaps rebuild the top level, which is compacted once the bottom levels are. A top level
+    // update or rebuild in the same frame reuses the ring slot written by it, instances changed in between
+    // are uploaded in the next frame
+    // returns true when the top level handle changed and descriptors using it have to be rewritten
+    bool compact(CommandBuffer* cmd);
+    // all compacted structures swapped in and the replaced ones freed
+    bool isCompactionDone() const;
 
-    void compactBottom();
+    // static KHR bottom levels are loaded from the directory instead of built, set before buildBottom
+    // blobs are keyed by geometry and device, rejected blobs are rebuilt and overwritten
+    void setCache(fs::path const& directory);
+    // writes bottom levels which were built, call once isCompactionDone
+    void storeCache();
+    int getCachedCount() const;
   protected:
+    void markDirty(int instance);
+    void uploadInstances();
+    std::string cacheKey(Mesh* mesh, uint firstIndex, uint indexCount);
+    bool loadCache(int bottom);
+    bool isBottomCompactionPending() const;
+    void buildHostPending(CommandBuffer* cmd);
+
+    AccelerationStructure::Api api;
     bool updatableTop = false;
     bool updatableBottom = false;
+    bool compactTop = false;
+    bool compactBottom = false;
+    bool topQueried = false;
+    bool swapUploaded = false; // compact wrote the ring slot of this frame
+    int framesInFlight = 1;
+    int hostThreads = 0;
+    Ptr<ThreadPool> hostPool;
+    std::vector<AccelerationStructure*> hostPending;
     std::vector<vk::GeometryInstance> instances;
-    std::vector<vk::GeometryNV> geometries;
+    std::vector<int> instanceBottoms;
+    std::vector<int> dirtyFrames; // ring slots still holding old instance data
+    std::vector<int> dirtyInstances;
+    int uploadedCount = 0;
+    std::vector<std::vector<vk::GeometryNV>> geometries;
 
     Ptr<AccelerationStructure> topLevel;
-    Ptr<AccelerationStructure> bottomLevel;
+    std::vector<Ptr<AccelerationStructure>> bottomLevels;
+
+    fs::path cacheDirectory;
+    std::vector<std::string> cacheKeys; // per bottom level, empty if not cacheable
+    std::vector<bool> cached;           // loaded from or already written to cache
+    std::map<Mesh*, uint64> meshHashes;
   };
 };
 
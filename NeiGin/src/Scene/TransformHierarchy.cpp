@@ -0,0 +1,128 @@
+#include "TransformHierarchy.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE__)
+#include <xmmintrin.h>
+#define NEI_TRANSFORM_SSE 1
+#endif
+
+using namespace Nei;
+
+namespace {
+  // out = a * b, glm matrices are column major, every column of out is a combination of the columns of a
+  void multiply(mat4 const& a, mat4 const& b, mat4& out) {
+#if NEI_TRANSFORM_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for(int c = 0; c < 4; c++) {
+      __m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+      r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+      r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+      r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+      _mm_storeu_ps(&out[c][0], r);
+    }
+#else
+    out = a * b;
+#endif
+  }
+}
+
+int TransformHierarchy::add(int parentNode, mat4 const& m) {
+  nei_assert(parentNode < int(index.size()));
+  int handle = int(index.size());
+  int d = parentNode == NoParent ? 0 : depth[parentNode] + 1;
+  if(!handles.empty() && d < depth[handles.back()]) unsorted = true;
+
+  depth.push_back(d);
+  index.push_back(int(handles.size()));
+  handles.push_back(handle);
+  parent.push_back(parentNode == NoParent ? NoParent : index[parentNode]);
+  local.push_back(m);
+  world.push_back(m);
+  dirty.push_back(1);
+  updated.push_back(0);
+  levelsDirty = true;
+  return handle;
+}
+
+void TransformHierarchy::clear() {
+  *this = TransformHierarchy();
+}
+
+void TransformHierarchy::setLocal(int node, mat4 const& m) {
+  int i = index[node];
+  local[i] = m;
+  dirty[i] = 1;
+}
+
+// stable by depth, handles keep their relative order within a level
+void TransformHierarchy::sort() {
+  int count = getSize();
+  if(unsorted) {
+    std::vector<int> order = handles;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depth[a] < depth[b]; });
+
+    std::vector<int> sortedIndex(count);
+    for(int i = 0; i < count; i++) sortedIndex[order[i]] = i;
+
+    auto permute = [&](auto& array) {
+      std::remove_reference_t<decltype(array)> sorted(count);
+      for(int i = 0; i < count; i++) sorted[i] = array[index[order[i]]];
+      array.swap(sorted);
+    };
+    permute(local);
+    permute(world);
+    permute(parent);
+    permute(dirty);
+    permute(updated);
+    for(auto& p : parent) {
+      if(p != NoParent) p = sortedIndex[handles[p]];
+    }
+
+    handles.swap(order);
+    index.swap(sortedIndex);
+    unsorted = false;
+  }
+
+  levels.clear();
+  for(int i = 0; i < count; i++) {
+    while(int(levels.size()) <= depth[handles[i]]) levels.push_back(i);
+  }
+  levels.push_back(count);
+  levelsDirty = false;
+}
+
+void TransformHierarchy::updateRange(int begin, int end) {
+  for(int i = begin; i < end; i++) {
+    int p = parent[i];
+    bool changed = dirty[i] || (p != NoParent && updated[p]);
+    updated[i] = changed;
+    dirty[i] = 0;
+    if(!changed) continue;
+
+    if(p == NoParent) world[i] = local[i];
+    else multiply(world[p], local[i], world[i]);
+  }
+}
+
+void TransformHierarchy::update(ThreadPool* pool, int minBatch) {
+  if(levelsDirty) sort();
+
+  int threads = pool ? pool->getThreadCount() : 1;
+  for(int l = 0; l + 1 < int(levels.size()); l++) {
+    int begin = levels[l];
+    int end = levels[l + 1];
+    int batches = glm::clamp((end - begin) / glm::max(1, minBatch), 1, threads);
+    if(batches == 1) {
+      updateRange(begin, end);
+      continue;
+    }
+
+    // a level only reads world matrices of the previous one
+    int step = (end - begin + batches - 1) / batches;
+    pool->parallelFor(batches, [&](int b) {
+      updateRange(begin + b * step, glm::min(end, begin + (b + 1) * step));
+    });
+  }
+}
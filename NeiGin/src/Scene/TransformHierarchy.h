@@ -0,0 +1,49 @@
+#pragma once
+
+#include "NeiGinBase.h"
+
+namespace Nei {
+  // Flattened alternative to Node::updateTransform for large hierarchies. Local and world matrices live in
+  // separate arrays sorted by depth, so parents always come before their children. update walks one depth
+  // level at a time, nodes of a level only read world matrices of the previous one and are split into jobs.
+  // Nodes are addressed by the handle returned from add, it stays valid when the arrays are reordered.
+  class NEIGIN_EXPORT TransformHierarchy {
+  public:
+    static constexpr int NoParent = -1;
+
+    // parent has to be added first
+    int add(int parent = NoParent, mat4 const& local = mat4(1));
+    void clear();
+
+    void setLocal(int node, mat4 const& local);
+    mat4 const& getLocal(int node) const { return local[index[node]]; }
+    mat4 const& getWorld(int node) const { return world[index[node]]; }
+
+    // world matrix changed in the last update, local or any parent matrix was set
+    bool wasUpdated(int node) const { return updated[index[node]] != 0; }
+
+    // levels are split into batches of at least minBatch nodes for the pool, null updates on the calling thread
+    void update(ThreadPool* pool = nullptr, int minBatch = 4096);
+
+    int getSize() const { return int(parent.size()); }
+    int getDepth() const { return int(levels.size()) - 1; }
+
+  protected:
+    void sort();
+    void updateRange(int begin, int end);
+
+    // sorted by depth
+    std::vector<mat4> local;
+    std::vector<mat4> world;
+    std::vector<int> parent;   // sorted index, NoParent for roots
+    std::vector<uint8> dirty;  // local set since the last update
+    std::vector<uint8> updated;
+
+    std::vector<int> levels;   // first sorted index of every depth and the end
+    std::vector<int> index;    // handle to sorted index
+    std::vector<int> handles;  // sorted index to handle
+    std::vector<int> depth;    // per handle
+    bool unsorted = false;     // a node was added above the deepest level
+    bool levelsDirty = false;  // nodes were added since the last update
+  };
+};
@@ -0,0 +1,168 @@
+#include "TriangleSplitter.h"
+#include "Mesh.h"
+#include "Math/AABB.h"
+
+#include <array>
+#include <map>
+#include <queue>
+#include <tuple>
+
+using namespace Nei;
+
+namespace {
+  // triangle to box area below which a triangle counts as degenerate, relative so it holds at any scene scale
+  constexpr float degenerateArea = 1e-6f;
+
+  float boxArea(vec3 const& a, vec3 const& b, vec3 const& c) {
+    vec3 d = max(max(a, b), c) - min(min(a, b), c);
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+
+  float triangleArea(vec3 const& a, vec3 const& b, vec3 const& c) {
+    return 0.5f * length(cross(b - a, c - a));
+  }
+}
+
+Ptr<Mesh> TriangleSplitter::split(DeviceContext* dc, Mesh* mesh, float budget, float ratio, Stats* stats) {
+  auto stride = mesh->getVertexLayout().stride;
+  auto src = static_cast<uint8*>(mesh->vertexPtr());
+
+  // new vertices are appended, only position (first attribute) is interpolated
+  std::vector<uint8> vertices(src, src + size_t(mesh->getVertexCount()) * stride);
+  std::vector<uint32> indices(mesh->indexPtr(), mesh->indexPtr() + mesh->getIndexCount());
+  auto position = [&](uint index) -> vec3& { return *reinterpret_cast<vec3*>(vertices.data() + size_t(index) * stride); };
+
+  auto score = [&](uint triangle) {
+    auto& a = position(indices[triangle * 3]);
+    auto& b = position(indices[triangle * 3 + 1]);
+    auto& c = position(indices[triangle * 3 + 2]);
+    return boxArea(a, b, c);
+  };
+  auto needsSplit = [&](uint triangle) {
+    auto& a = position(indices[triangle * 3]);
+    auto& b = position(indices[triangle * 3 + 1]);
+    auto& c = position(indices[triangle * 3 + 2]);
+    float box = boxArea(a, b, c);
+    float area = triangleArea(a, b, c);
+    // degenerate triangles stay degenerate when split, they would only use up the budget
+    if(area <= degenerateArea * box) return false;
+    return box > ratio * area;
+  };
+  auto sahProxy = [&]() {
+    AABB scene;
+    double sum = 0;
+    for(uint t = 0; t < indices.size() / 3; t++) {
+      for(int k = 0; k < 3; k++) scene.extend(position(indices[t * 3 + k]));
+      sum += score(t);
+    }
+    vec3 d = scene.max - scene.min;
+    double total = 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    return total > 0 ? float(sum / total) : 0.f;
+  };
+
+  uint inputTriangles = uint(indices.size() / 3);
+  float sahBefore = sahProxy();
+
+  // triangles by edge, keyed by the ordered end positions so edges along uv or normal seams are found as well
+  using EdgeKey = std::array<float, 6>;
+  auto edgeKey = [&](uint a, uint b) {
+    vec3 p = position(a);
+    vec3 q = position(b);
+    if(std::tie(q.x, q.y, q.z) < std::tie(p.x, p.y, p.z)) std::swap(p, q);
+    return EdgeKey{p.x, p.y, p.z, q.x, q.y, q.z};
+  };
+  std::map<EdgeKey, std::vector<uint>> edges;
+  auto addEdges = [&](uint t) {
+    for(int k = 0; k < 3; k++) edges[edgeKey(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3])].push_back(t);
+  };
+  auto removeEdges = [&](uint t) {
+    for(int k = 0; k < 3; k++) {
+      auto& list = edges[edgeKey(indices[t * 3 + k], indices[t * 3 + (k + 1) % 3])];
+      list.erase(std::find(list.begin(), list.end(), t));
+    }
+  };
+  for(uint t = 0; t < inputTriangles; t++) addEdges(t);
+
+  // largest boxes first, they contribute most to the cost
+  std::priority_queue<std::pair<float, uint>> queue;
+  for(uint t = 0; t < inputTriangles; t++)
+    if(needsSplit(t)) queue.push({score(t), t});
+
+  uint extra = uint(budget * inputTriangles);
+  while(extra > 0 && !queue.empty()) {
+    auto [queued, t] = queue.top();
+    queue.pop();
+    // triangles split as a neighbour were queued again with their new box
+    if(queued != score(t)) continue;
+
+    // longest edge is split at its midpoint
+    uint i[3] = {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+    int edge = 0;
+    float longest = 0;
+    for(int k = 0; k < 3; k++) {
+      float l = distance(position(i[k]), position(i[(k + 1) % 3]));
+      if(l > longest) {
+        longest = l;
+        edge = k;
+      }
+    }
+
+    // every triangle on the edge is split at the same point, otherwise the bvh mesh gets t-junctions and rays
+    // leak through the cracks. The midpoint is computed from the ordered key, identical for all of them
+    EdgeKey key = edgeKey(i[edge], i[(edge + 1) % 3]);
+    std::vector<uint> shared = edges[key];
+    if(shared.size() > extra) break;
+    vec3 mid = (vec3(key[0], key[1], key[2]) + vec3(key[3], key[4], key[5])) * 0.5f;
+
+    // midpoint vertex by edge, neighbours sharing the vertices share it as well
+    std::map<std::pair<uint, uint>, uint> midpoints;
+    for(uint s : shared) {
+      int k = 0;
+      while(edgeKey(indices[s * 3 + k], indices[s * 3 + (k + 1) % 3]) != key) k++;
+      uint a = indices[s * 3 + k];
+      uint b = indices[s * 3 + (k + 1) % 3];
+      uint c = indices[s * 3 + (k + 2) % 3];
+
+      auto [it, created] = midpoints.try_emplace({std::min(a, b), std::max(a, b)}, uint(vertices.size() / stride));
+      uint m = it->second;
+      if(created) {
+        vertices.resize(vertices.size() + stride);
+        memcpy(vertices.data() + size_t(m) * stride, vertices.data() + size_t(a) * stride, stride);
+        position(m) = mid;
+      }
+
+      // winding is kept, a-m-c replaces the triangle and m-b-c is appended
+      removeEdges(s);
+      indices[s * 3] = a;
+      indices[s * 3 + 1] = m;
+      indices[s * 3 + 2] = c;
+      uint n = uint(indices.size() / 3);
+      indices.push_back(m);
+      indices.push_back(b);
+      indices.push_back(c);
+      addEdges(s);
+      addEdges(n);
+      extra--;
+
+      if(needsSplit(s)) queue.push({score(s), s});
+      if(needsSplit(n)) queue.push({score(n), n});
+    }
+  }
+
+  Ptr out = new Mesh(dc);
+  out->setVertexLayout(mesh->getVertexLayout());
+  out->setVertices(vertices.data(), uint(vertices.size() / stride));
+  out->setIndices(indices.data(), uint(indices.size()));
+  out->upload();
+
+  Stats s;
+  s.inputTriangles = inputTriangles;
+  s.outputTriangles = uint(indices.size() / 3);
+  s.sahBefore = sahBefore;
+  s.sahAfter = sahProxy();
+  nei_log("Triangle split {} -> {} triangles, SAH leaf cost {} -> {}", s.inputTriangles, s.outputTriangles,
+    s.sahBefore, s.sahAfter);
+  if(stats) *stats = s;
+
+  return out;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "NeiGinBase.h"
+
+namespace Nei {
+  // Long thin triangles have boxes much larger than themselves, the driver BVH then overlaps badly.
+  // Such triangles are split at their longest edge until the extra triangle budget is used up.
+  // Output is a separate mesh for the bottom level build, rasterization keeps the original.
+  class NEIGIN_EXPORT TriangleSplitter {
+  public:
+    struct Stats {
+      uint inputTriangles = 0;
+      uint outputTriangles = 0;
+      // sum of triangle box areas relative to the scene box, leaf term of the SAH cost
+      float sahBefore = 0;
+      float sahAfter = 0;
+    };
+
+    // budget - extra triangles as fraction of the input, ratio - box to triangle area above which splitting starts
+    static Ptr<Mesh> split(DeviceContext* dc, Mesh* mesh, float budget, float ratio = 8, Stats* stats = nullptr);
+  };
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+
+namespace Nei {
+  struct MpscNode {
+    std::atomic<MpscNode*> next = nullptr;
+  };
+
+  // Intrusive multi producer single consumer queue (Vyukov). push is wait free and can be called from any thread,
+  // pop only from the consumer. Nodes derive from MpscNode and stay owned by the caller.
+  template <typename T>
+  class MpscQueue {
+  public:
+    MpscQueue(): head(&stub), tail(&stub) { }
+
+    MpscQueue(MpscQueue const&) = delete;
+    MpscQueue& operator=(MpscQueue const&) = delete;
+
+    void push(T* node) {
+      push(static_cast<MpscNode*>(node));
+    }
+
+    // null when empty or while a producer is between its two stores, the node shows up in a later pop
+    T* pop() {
+      MpscNode* last = tail;
+      MpscNode* next = last->next.load(std::memory_order_acquire);
+      if(last == &stub) {
+        if(!next) return nullptr;
+        tail = next;
+        last = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+      if(next) {
+        tail = next;
+        return static_cast<T*>(last);
+      }
+      if(last != head.load(std::memory_order_acquire)) return nullptr;
+
+      // last is the only node, the stub goes behind it so last can be handed out
+      push(&stub);
+      next = last->next.load(std::memory_order_acquire);
+      if(next) {
+        tail = next;
+        return static_cast<T*>(last);
+      }
+      return nullptr;
+    }
+
+  protected:
+    void push(MpscNode* node) {
+      node->next.store(nullptr, std::memory_order_relaxed);
+      MpscNode* prev = head.exchange(node, std::memory_order_acq_rel);
+      prev->next.store(node, std::memory_order_release);
+    }
+
+    MpscNode stub;
+    std::atomic<MpscNode*> head;  // last pushed, producers
+    MpscNode* tail;               // next to pop, consumer
+  };
+};
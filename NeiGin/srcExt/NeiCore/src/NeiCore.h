@@ -29,6 +29,8 @@ namespace fs = std::filesystem;
 
 #include "Object.h"
 #include "Ptr.h"
+#include "Pool.h"
+#include "ThreadPool.h"
 
 #include "Log.h"
 #include "Profiler.h"
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "Pool.h"
+
+#include <algorithm>
+#include <map>
+#include "Log.h"
+
+using namespace Nei;
+
+namespace {
+  constexpr size_t chunkSize = 64 * 1024;
+  constexpr int minBlocksPerChunk = 32;
+  constexpr int maxBatch = 64;
+
+  // pools live until the process exits, threads may still free into them from their exit handlers
+  struct Registry {
+    std::mutex mutex;
+    std::vector<ObjectPool*> pools;
+    std::map<std::string, ObjectPool*> byName;
+  };
+
+  Registry& getRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+  }
+
+  thread_local bool threadCachesReleased = false;
+}
+
+// caches of every thread are registered for getCached, the mutex guards the vector against resizes only.
+// cached blocks of an exiting thread go back to the shared lists
+struct ObjectPool::ThreadCaches {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Cache>> caches;
+
+  // guarded by the registry mutex
+  static std::vector<ThreadCaches*>& getThreads() {
+    static auto threads = new std::vector<ThreadCaches*>;
+    return *threads;
+  }
+
+  ThreadCaches() {
+    std::lock_guard lock(getRegistry().mutex);
+    getThreads().push_back(this);
+  }
+
+  ~ThreadCaches() {
+    {
+      std::lock_guard lock(getRegistry().mutex);
+      auto& threads = getThreads();
+      threads.erase(std::find(threads.begin(), threads.end(), this));
+    }
+    for(auto& c : caches) {
+      if(c && c->getCount()) c->pool->flush(*c, c->getCount());
+    }
+    threadCachesReleased = true;
+  }
+};
+
+ObjectPool* ObjectPool::get(char const* name, size_t size, size_t alignment) {
+  auto& registry = getRegistry();
+  std::lock_guard lock(registry.mutex);
+  auto& pool = registry.byName[name];
+  if(!pool) {
+    pool = new ObjectPool(name, size, alignment, int(registry.pools.size()));
+    registry.pools.push_back(pool);
+  }
+  nei_assertm(pool->blockSize >= size, "ObjectPool type size differs between modules");
+  return pool;
+}
+
+std::vector<ObjectPool*> ObjectPool::getPools() {
+  auto& registry = getRegistry();
+  std::lock_guard lock(registry.mutex);
+  return registry.pools;
+}
+
+void ObjectPool::logStats() {
+  for(auto pool : getPools()) {
+    nei_log("Pool {}: {} B blocks, {} in use, {} cached, {} peak, {} allocated", pool->getName(),
+      pool->getBlockSize(), pool->getInUse(), pool->getCached(), pool->getPeak(), pool->getCapacity());
+  }
+}
+
+size_t ObjectPool::getCached() const {
+  std::lock_guard lock(getRegistry().mutex);
+  size_t cached = 0;
+  for(auto thread : ThreadCaches::getThreads()) {
+    std::lock_guard threadLock(thread->mutex);
+    if(index < int(thread->caches.size()) && thread->caches[index]) cached += thread->caches[index]->getCount();
+  }
+  return cached;
+}
+
+// both counts move while threads run, the difference is clamped
+size_t ObjectPool::getInUse() const {
+  size_t cached = getCached();
+  size_t outside = live;
+  return outside > cached ? outside - cached : 0;
+}
+
+ObjectPool::ObjectPool(char const* name, size_t size, size_t alignment, int index): name(name),
+  alignment(std::max(alignment, alignof(Block))), index(index) {
+  blockSize = (std::max(size, sizeof(Block)) + this->alignment - 1) / this->alignment * this->alignment;
+  blocksPerChunk = std::max(minBlocksPerChunk, int(chunkSize / blockSize));
+  batch = std::min(maxBatch, blocksPerChunk / 2);
+}
+
+void* ObjectPool::allocate() {
+  Block* block;
+  Cache* cache = getCache();
+  if(cache) {
+    int count = cache->getCount();
+    if(!cache->head) cache->head = takeShared(batch, count);
+    block = cache->head;
+    cache->head = block->next;
+    cache->setCount(count - 1);
+  } else {
+    int taken;
+    block = takeShared(1, taken);
+  }
+  return block;
+}
+
+void ObjectPool::deallocate(void* p) {
+  Block* block = static_cast<Block*>(p);
+  Cache* cache = getCache();
+  if(!cache) {
+    std::lock_guard lock(mutex);
+    block->next = shared;
+    shared = block;
+    live--;
+    return;
+  }
+
+  block->next = cache->head;
+  cache->head = block;
+  int count = cache->getCount() + 1;
+  cache->setCount(count);
+  // keep one batch for the next allocations, blocks freed by other threads than the allocating one flow back
+  if(count >= 2 * batch) flush(*cache, batch);
+}
+
+ObjectPool::Cache* ObjectPool::getCache() {
+  if(threadCachesReleased) return nullptr;
+  thread_local ThreadCaches threadCaches;
+  auto& caches = threadCaches.caches;
+  if(int(caches.size()) <= index || !caches[index]) {
+    std::lock_guard lock(threadCaches.mutex);
+    if(int(caches.size()) <= index) caches.resize(index + 1);
+    caches[index] = std::make_unique<Cache>();
+    caches[index]->pool = this;
+  }
+  return caches[index].get();
+}
+
+ObjectPool::Block* ObjectPool::takeShared(int count, int& taken) {
+  std::lock_guard lock(mutex);
+  if(!shared) {
+    auto chunk = static_cast<char*>(::operator new(blockSize * blocksPerChunk, std::align_val_t(alignment)));
+    chunks.push_back(chunk);
+    for(int i = blocksPerChunk - 1; i >= 0; i--) {
+      auto block = reinterpret_cast<Block*>(chunk + i * blockSize);
+      block->next = shared;
+      shared = block;
+    }
+    capacity += blocksPerChunk;
+  }
+
+  Block* head = shared;
+  Block* tail = shared;
+  taken = 1;
+  while(taken < count && tail->next) {
+    tail = tail->next;
+    taken++;
+  }
+  shared = tail->next;
+  tail->next = nullptr;
+  live += taken;
+  peak = std::max<size_t>(peak, live);
+  return head;
+}
+
+void ObjectPool::flush(Cache& cache, int count) {
+  Block* head = cache.head;
+  Block* tail = head;
+  for(int i = 1; i < count; i++) tail = tail->next;
+  cache.head = tail->next;
+  cache.setCount(cache.getCount() - count);
+
+  std::lock_guard lock(mutex);
+  tail->next = shared;
+  shared = head;
+  live -= count;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include "Export.h"
+
+namespace Nei {
+  // Fixed size blocks for all objects of one type. Every thread caches a few free blocks and exchanges them with
+  // the shared free list in batches, most allocations and frees take no lock. Blocks come from chunks which are
+  // never returned to the system, the pool keeps the peak size of its type.
+  class NEICORE_EXPORT ObjectPool {
+  public:
+    // pool of the type, shared by all modules
+    static ObjectPool* get(char const* name, size_t size, size_t alignment);
+    static std::vector<ObjectPool*> getPools();
+    static void logStats();
+
+    void* allocate();
+    void deallocate(void* p);
+
+    std::string const& getName() const { return name; }
+    size_t getBlockSize() const { return blockSize; }
+    // blocks outside the shared list, in use or cached by a thread. Counted per batch, allocations stay free of
+    // shared atomics
+    size_t getLive() const { return live; }
+    size_t getPeak() const { return peak; }
+    // blocks parked in thread caches, a snapshot taken while other threads keep running
+    size_t getCached() const;
+    // blocks held by objects, live without the cached ones
+    size_t getInUse() const;
+    // blocks carved from chunks so far
+    size_t getCapacity() const { return capacity; }
+
+  protected:
+    ObjectPool(char const* name, size_t size, size_t alignment, int index);
+
+    struct Block {
+      Block* next;
+    };
+
+    // count is written by the owning thread only, relaxed stores keep it readable for getCached
+    struct Cache {
+      ObjectPool* pool = nullptr;
+      Block* head = nullptr;
+      std::atomic<int> count = 0;
+
+      int getCount() const { return count.load(std::memory_order_relaxed); }
+      void setCount(int n) { count.store(n, std::memory_order_relaxed); }
+    };
+
+    struct ThreadCaches;
+
+    // null after the thread released its caches on exit, blocks then go through the shared list
+    Cache* getCache();
+    // takes up to count blocks from the shared list, carves a new chunk when it is empty
+    Block* takeShared(int count, int& taken);
+    void flush(Cache& cache, int count);
+
+    std::string name;
+    size_t blockSize;
+    size_t alignment;
+    int index;
+    int batch;
+    int blocksPerChunk;
+
+    std::mutex mutex;
+    Block* shared = nullptr;
+    std::vector<void*> chunks;
+
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak = 0;
+    std::atomic<size_t> capacity = 0;
+  };
+
+  // Opt in for small Object types which are created often, class X : public Object, public Pooled<X>.
+  // Derived types of different size fall back to the global allocator, the virtual destructor passes their size.
+  template <typename T>
+  class Pooled {
+  public:
+    static void* operator new(size_t size) {
+      if(size != sizeof(T)) return ::operator new(size);
+      return getPool()->allocate();
+    }
+
+    static void operator delete(void* p, size_t size) {
+      if(!p) return;
+      if(size != sizeof(T)) {
+        ::operator delete(p);
+        return;
+      }
+      getPool()->deallocate(p);
+    }
+
+    static ObjectPool* getPool() {
+      static ObjectPool* pool = ObjectPool::get(typeid(T).name(), sizeof(T), alignof(T));
+      return pool;
+    }
+  };
+};
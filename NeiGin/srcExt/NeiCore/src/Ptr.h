@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include "Object.h"
 #include "Log.h"
 
@@ -24,11 +25,17 @@ namespace Nei {
     }
 
     template <typename B>
-    Ptr(Ptr<B>& o): ptr(o.ptr) {
+    Ptr(Ptr<B> const& o): ptr(o.ptr) {
       if (ptr)
         ptr->ref();
     }
 
+    // takes the reference over, no atomic traffic
+    template <typename B>
+    Ptr(Ptr<B>&& o) noexcept: ptr(o.ptr) {
+      o.ptr = nullptr;
+    }
+
     ~Ptr() {
       clear();
     }
@@ -63,11 +70,34 @@ namespace Nei {
     }
 
     template<typename U>
-    Ptr& operator=(Ptr<U>& obj) {
+    Ptr& operator=(Ptr<U> const& obj) {
       set(static_cast<T*>(obj.ptr));
       return *this;
     }
 
+    Ptr& operator=(Ptr&& obj) noexcept {
+      if (this != &obj) {
+        clear();
+        ptr = obj.ptr;
+        obj.ptr = nullptr;
+      }
+      return *this;
+    }
+
+    template<typename U>
+    Ptr& operator=(Ptr<U>&& obj) noexcept {
+      clear();
+      ptr = static_cast<T*>(obj.ptr);
+      obj.ptr = nullptr;
+      return *this;
+    }
+
+    // gives up ownership without unref, the caller owns one reference
+    T* release() {
+      T* ret = ptr;
+      ptr = nullptr;
+      return ret;
+    }
 
     operator T*() const {
       return ptr;
@@ -125,6 +155,44 @@ namespace Nei {
 
     T* ptr = nullptr;
   };
+
+  // Borrowed, non owning view of an Object. Copies are plain pointer copies, so it is meant for parameters,
+  // return values and members which never outlive an owning Ptr, e.g. state tracked while recording
+  template <typename T>
+  class Ref {
+  public:
+    constexpr Ref(T* obj = nullptr): ptr(obj) { }
+
+    template <typename B>
+    Ref(Ptr<B> const& o): ptr(o.get()) { }
+
+    template <typename B>
+    Ref(Ref<B> const& o): ptr(o.get()) { }
+
+    // new owning reference
+    Ptr<T> lock() const {
+      return Ptr<T>(ptr);
+    }
+
+    operator T*() const {
+      return ptr;
+    }
+
+    T* operator->() const {
+      return ptr;
+    }
+
+    T* get() const {
+      return ptr;
+    }
+
+    T& operator*() const {
+      return *ptr;
+    }
+
+  protected:
+    T* ptr = nullptr;
+  };
 };
 
 namespace std {
@@ -132,7 +200,15 @@ namespace std {
   {
     std::size_t operator()(Nei::Ptr<T> const& s) const noexcept
     {
-      return s.ptr;
+      return std::hash<T*>()(s.get());
+    }
+  };
+
+  template<typename T> struct hash<Nei::Ref<T>>
+  {
+    std::size_t operator()(Nei::Ref<T> const& s) const noexcept
+    {
+      return std::hash<T*>()(s.get());
     }
   };
 }
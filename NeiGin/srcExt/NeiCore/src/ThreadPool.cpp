@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace Nei;
+
+namespace {
+  thread_local bool insideJob = false;
+}
+
+ThreadPool::ThreadPool(int threads) {
+  if(threads <= 0) threads = std::max(1, int(std::thread::hardware_concurrency()));
+  for(int i = 1; i < threads; i++) workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for(auto& w : workers) w.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  if(workers.empty()) {
+    job();
+    return;
+  }
+  {
+    std::lock_guard lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::waitIdle() {
+  std::unique_lock lock(mutex);
+  idle.wait(lock, [this]() { return jobs.empty() && running == 0; });
+}
+
+void ThreadPool::parallelFor(int count, std::function<void(int)> const& job) {
+  int helpers = std::min(count, getThreadCount()) - 1;
+  if(helpers <= 0 || insideJob) {
+    for(int i = 0; i < count; i++) job(i);
+    return;
+  }
+
+  // indices are taken by whoever is free, the caller waits only for the helpers of this loop
+  std::atomic<int> next = 0;
+  int done = 0;
+  std::mutex doneMutex;
+  std::condition_variable doneSignal;
+  auto loop = [&]() {
+    for(int i = next++; i < count; i = next++) job(i);
+  };
+
+  for(int h = 0; h < helpers; h++) {
+    submit([&]() {
+      loop();
+      std::lock_guard lock(doneMutex);
+      if(++done == helpers) doneSignal.notify_one();
+    });
+  }
+  loop();
+  std::unique_lock lock(doneMutex);
+  doneSignal.wait(lock, [&]() { return done == helpers; });
+}
+
+void ThreadPool::work() {
+  insideJob = true;
+  std::unique_lock lock(mutex);
+  for(;;) {
+    wake.wait(lock, [this]() { return stop || !jobs.empty(); });
+    if(jobs.empty()) return;
+
+    auto job = std::move(jobs.front());
+    jobs.pop_front();
+    running++;
+    lock.unlock();
+    job();
+    lock.lock();
+    running--;
+    if(jobs.empty() && running == 0) idle.notify_all();
+  }
+}
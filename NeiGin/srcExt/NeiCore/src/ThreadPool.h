@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Object.h"
+
+namespace Nei {
+  // Persistent worker threads. parallelFor spreads short loops over the workers and the calling thread,
+  // submit queues independent jobs which waitIdle waits for.
+  class NEICORE_EXPORT ThreadPool : public Object {
+  public:
+    // threads including the caller of parallelFor, 0 = hardware concurrency
+    explicit ThreadPool(int threads = 0);
+    virtual ~ThreadPool();
+
+    int getThreadCount() const { return int(workers.size()) + 1; }
+
+    void submit(std::function<void()> job);
+    void waitIdle();
+
+    // job(i) for every i below count, returns when all are done. The caller takes part, nested calls from
+    // a job run without waiting for other workers
+    void parallelFor(int count, std::function<void(int)> const& job);
+
+  protected:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> jobs;
+    int running = 0;
+    bool stop = false;
+  };
+};
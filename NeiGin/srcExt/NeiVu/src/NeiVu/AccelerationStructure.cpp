@@ -4,24 +4,37 @@
 #include "CommandBuffer.h"
 #include "MemoryManager.h"
 
+#include <thread>
+
 using namespace Nei::Vu;
-AccelerationStructure::AccelerationStructure(DeviceContext* dc): DeviceObject(dc) { }
+AccelerationStructure::AccelerationStructure(DeviceContext* dc, Api api): DeviceObject(dc), api(api) {
+  if(api == Api::KHR) nei_assert(dc->isExtensionEnabled(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME));
+}
 
 AccelerationStructure::~AccelerationStructure() {
+  if(mappedInstances) bufferInstances->unmap();
   auto device = deviceContext->getVkDevice();
-  auto dispatch = deviceContext->getDispatch();
+  auto& dispatch = deviceContext->getDispatch();
+  for(auto& r : retired) destroy(r);
+  if(compactionQuery) device.destroyQueryPool(compactionQuery);
   if(structure) device.destroyAccelerationStructureNV(structure, nullptr, dispatch);
+  if(structureKHR) device.destroyAccelerationStructureKHR(structureKHR, nullptr, dispatch);
 }
 
 void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries) {
+  if(api == Api::KHR) {
+    setGeometriesKHR(geometries);
+    createKHR(vk::AccelerationStructureTypeKHR::eBottomLevel);
+    buildKHR(cmd, false);
+    return;
+  }
+
   auto device = deviceContext->getVkDevice();
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eBottomLevel;
-  asinfo.flags = updatable
-                   ? vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate
-                   : vk::BuildAccelerationStructureFlagBitsNV::eAllowCompaction;
+  asinfo.flags = getFlagsNV();
   asinfo.geometryCount = (uint)geometries.size();
   asinfo.pGeometries = geometries.data();
   asinfo.instanceCount = 0;
@@ -67,14 +80,19 @@ void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryNV
 }
 
 void AccelerationStructure::rebuild(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries) {
+  nei_assert(!compacted);
+  if(api == Api::KHR) {
+    setGeometriesKHR(geometries);
+    buildKHR(cmd, false);
+    return;
+  }
+
   auto device = deviceContext->getVkDevice();
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eBottomLevel;
-  asinfo.flags = updatable
-    ? vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate
-    : vk::BuildAccelerationStructureFlagBitsNV::eAllowCompaction;
+  asinfo.flags = getFlagsNV();
   asinfo.geometryCount = (uint)geometries.size();
   asinfo.pGeometries = geometries.data();
   asinfo.instanceCount = 0;
@@ -86,12 +104,18 @@ void AccelerationStructure::rebuild(CommandBuffer* cmd, std::vector<vk::Geometry
 
 void AccelerationStructure::update(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries) {
   nei_assert(updatable);
+  if(api == Api::KHR) {
+    setGeometriesKHR(geometries);
+    buildKHR(cmd, true);
+    return;
+  }
+
   auto device = deviceContext->getVkDevice();
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eBottomLevel;
-  asinfo.flags = vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate;
+  asinfo.flags = getFlagsNV();
   asinfo.geometryCount = (uint)geometries.size();
   asinfo.pGeometries = geometries.data();
   asinfo.instanceCount = 0;
@@ -102,14 +126,30 @@ void AccelerationStructure::update(CommandBuffer* cmd, std::vector<vk::GeometryN
 }
 
 void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances) {
+  // every slot starts with all instances
+  instanceCount = uint(instances.size());
+  instanceSlot = 0;
+  auto slotSize = instances.size() * sizeof(vk::GeometryInstance);
+  bufferInstances = new Buffer(deviceContext, uint(slotSize * framesInFlight),
+    api == Api::KHR ? Buffer::Type::AccelerationInput : Buffer::Type::Raytracing, Stream);
+  mappedInstances = (vk::GeometryInstance*)bufferInstances->map();
+  for(int i = 0; i < framesInFlight; i++)
+    memcpy(mappedInstances + i * instanceCount, instances.data(), slotSize);
+
+  if(api == Api::KHR) {
+    setInstancesKHR();
+    createKHR(vk::AccelerationStructureTypeKHR::eTopLevel);
+    buildKHR(cmd, false);
+    return;
+  }
+
   auto device = deviceContext->getVkDevice();
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eTopLevel;
-  asinfo.flags = {};
-  if(updatable) asinfo.flags |= vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate;
-  asinfo.instanceCount = (uint)instances.size();
+  asinfo.flags = getFlagsNV();
+  asinfo.instanceCount = instanceCount;
 
   vk::AccelerationStructureCreateInfoNV asci;
   asci.info = asinfo;
@@ -132,11 +172,6 @@ void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryIn
   buffer = new Buffer(deviceContext, uint(memReqObject.memoryRequirements.size), Buffer::Type::Raytracing);
   auto scratchSize = glm::max(memReqBuild.memoryRequirements.size, memReqUpdate.memoryRequirements.size);
   bufferScratch = new Buffer(deviceContext, uint(scratchSize), Buffer::Type::Raytracing);
-  bufferInstances = new Buffer(deviceContext, uint(instances.size() * sizeof(vk::GeometryInstance)),
-    Buffer::Type::Raytracing,
-    Stream);
-
-  bufferInstances->setData(instances.data(), uint(instances.size() * sizeof(vk::GeometryInstance)));
 
   auto& allocation = buffer->getAllocation();
   vk::BindAccelerationStructureMemoryInfoNV bindInfo;
@@ -147,8 +182,8 @@ void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryIn
   bindInfo.pDeviceIndices = nullptr;
   device.bindAccelerationStructureMemoryNV(bindInfo, dispatch);
 
-  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, 0, false, structure, nullptr, *bufferScratch, 0,
-    dispatch);
+  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, getInstanceOffset(), false, structure, nullptr,
+    *bufferScratch, 0, dispatch);
   barrier(cmd);
 
   // handle
@@ -156,98 +191,376 @@ void AccelerationStructure::build(CommandBuffer* cmd, std::vector<vk::GeometryIn
 }
 
 void AccelerationStructure::rebuild(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances) {
-  auto device = deviceContext->getVkDevice();
+  nei_assert(instances.size() == instanceCount);
+  memcpy(mapInstances(), instances.data(), instances.size() * sizeof(vk::GeometryInstance));
+  rebuild(cmd);
+}
+
+void AccelerationStructure::update(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances) {
+  nei_assert(instances.size() == instanceCount);
+  memcpy(mapInstances(), instances.data(), instances.size() * sizeof(vk::GeometryInstance));
+  update(cmd);
+}
+
+vk::GeometryInstance* AccelerationStructure::mapInstances() {
+  instanceSlot = (instanceSlot + 1) % framesInFlight;
+  return mappedInstances + instanceSlot * instanceCount;
+}
+
+void AccelerationStructure::rebuild(CommandBuffer* cmd) {
+  nei_assert(!compacted);
+  if(api == Api::KHR) {
+    setInstancesKHR();
+    buildKHR(cmd, false);
+    return;
+  }
+
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eTopLevel;
-  asinfo.flags = {};
-  if (updatable) asinfo.flags |= vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate;
-  asinfo.instanceCount = (uint)instances.size();
-  
-  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, 0, false, structure, nullptr, *bufferScratch, 0,
-    dispatch);
+  asinfo.flags = getFlagsNV();
+  asinfo.instanceCount = instanceCount;
+
+  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, getInstanceOffset(), false, structure, nullptr,
+    *bufferScratch, 0, dispatch);
   barrier(cmd);
 }
 
-void AccelerationStructure::update(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances) {
+void AccelerationStructure::update(CommandBuffer* cmd) {
   nei_assert(updatable);
-  auto device = deviceContext->getVkDevice();
+  if(api == Api::KHR) {
+    setInstancesKHR();
+    buildKHR(cmd, true);
+    return;
+  }
+
   auto& dispatch = deviceContext->getDispatch();
 
   vk::AccelerationStructureInfoNV asinfo;
   asinfo.type = vk::AccelerationStructureTypeNV::eTopLevel;
-  asinfo.flags = vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate;
-  asinfo.instanceCount = (uint)instances.size();
+  asinfo.flags = getFlagsNV();
+  asinfo.instanceCount = instanceCount;
+
+  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, getInstanceOffset(), true, structure, structure,
+    *bufferScratch, 0, dispatch);
+  barrier(cmd);
+}
+
+vk::DeviceSize AccelerationStructure::getInstanceOffset() const {
+  return vk::DeviceSize(instanceSlot) * instanceCount * sizeof(vk::GeometryInstance);
+}
 
-  // skip instance data copy - it is always one instance with identity transform
+void AccelerationStructure::prepareHost(std::vector<vk::GeometryNV> const& geometries,
+                                        std::vector<HostTriangles> const& data) {
+  nei_assert(api == Api::KHR && !updatable && geometries.size() == data.size());
+  setGeometriesKHR(geometries);
+  for(int i = 0; i < geometriesKHR.size(); i++) {
+    auto& triangles = geometriesKHR[i].geometry.triangles;
+    triangles.vertexData.hostAddress = data[i].vertices;
+    triangles.indexData.hostAddress = data[i].indices;
+  }
+  createKHR(vk::AccelerationStructureTypeKHR::eBottomLevel, true);
+}
 
-  (**cmd).buildAccelerationStructureNV(asinfo, *bufferInstances, 0, true, structure, structure, *bufferScratch, 0,
+void AccelerationStructure::buildHost(DeviceContext* dc, std::vector<AccelerationStructure*> const& structures,
+                                      ThreadPool* pool, int threads) {
+  if(structures.empty()) return;
+  auto device = dc->getVkDevice();
+  auto& dispatch = dc->getDispatch();
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> infos;
+  std::vector<vk::AccelerationStructureBuildRangeInfoKHR const*> ranges;
+  for(auto s : structures) {
+    vk::AccelerationStructureBuildGeometryInfoKHR info;
+    info.type = s->typeKHR;
+    info.flags = s->flagsKHR;
+    info.mode = vk::BuildAccelerationStructureModeKHR::eBuild;
+    info.dstAccelerationStructure = s->structureKHR;
+    info.geometryCount = uint(s->geometriesKHR.size());
+    info.pGeometries = s->geometriesKHR.data();
+    info.scratchData.hostAddress = s->hostScratch.data();
+    infos.push_back(info);
+    ranges.push_back(s->rangesKHR.data());
+  }
+
+  auto operation = device.createDeferredOperationKHR(nullptr, dispatch);
+  auto result = device.buildAccelerationStructuresKHR(operation, uint(infos.size()), infos.data(), ranges.data(),
     dispatch);
-  barrier(cmd);
+
+  int workers = 1;
+  if(result == vk::Result::eOperationDeferredKHR) {
+    auto join = [&]() {
+      for(;;) {
+        auto r = device.deferredOperationJoinKHR(operation, dispatch);
+        if(r == vk::Result::eThreadIdleKHR) std::this_thread::yield();
+        else break; // success, thread done or error
+      }
+    };
+
+    workers = glm::min(threads, int(device.getDeferredOperationMaxConcurrencyKHR(operation, dispatch)));
+    workers = glm::max(1, glm::min(workers, pool ? pool->getThreadCount() : 1));
+    if(workers > 1) pool->parallelFor(workers, [&](int) { join(); });
+    else join();
+    result = device.getDeferredOperationResultKHR(operation, dispatch);
+  }
+  device.destroyDeferredOperationKHR(operation, nullptr, dispatch);
+
+  if(result != vk::Result::eSuccess && result != vk::Result::eOperationNotDeferredKHR)
+    nei_error("Host BVH build failed! {}", vk::to_string(result));
+
+  for(auto s : structures) std::vector<uint8>().swap(s->hostScratch);
+
+  auto end = std::chrono::high_resolution_clock::now();
+  nei_log("Host BVH build {} structures on {} threads {} ms", structures.size(), workers,
+    std::chrono::duration<double, std::milli>(end - start).count());
 }
 
-void AccelerationStructure::compact() {
-  nei_assert(!updatable);
+void AccelerationStructure::copyToDevice(CommandBuffer* cmd) {
+  nei_assert(api == Api::KHR && hostScratch.empty());
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+
+  Retired old;
+  old.structureKHR = structureKHR;
+  old.buffer = buffer;
+  old.frames = framesInFlight;
+
+  buffer = new Buffer(deviceContext, uint(old.buffer->getSize()), Buffer::Type::AccelerationStorage);
+  vk::AccelerationStructureCreateInfoKHR asci;
+  asci.buffer = *buffer;
+  asci.size = buffer->getSize();
+  asci.type = typeKHR;
+  structureKHR = device.createAccelerationStructureKHR(asci, nullptr, dispatch);
+
+  // host writes are visible to the device at submit, no barrier in front of the copy
+  vk::CopyAccelerationStructureInfoKHR copyInfo;
+  copyInfo.src = old.structureKHR;
+  copyInfo.dst = structureKHR;
+  copyInfo.mode = vk::CopyAccelerationStructureModeKHR::eClone;
+  (**cmd).copyAccelerationStructureKHR(copyInfo, dispatch);
+  barrier(cmd);
+  retired.push_back(std::move(old));
+
+  vk::AccelerationStructureDeviceAddressInfoKHR addressInfo;
+  addressInfo.accelerationStructure = structureKHR;
+  handle = device.getAccelerationStructureAddressKHR(addressInfo, dispatch);
+}
 
+std::vector<uint8> AccelerationStructure::serialize() {
+  nei_assert(api == Api::KHR && typeKHR == vk::AccelerationStructureTypeKHR::eBottomLevel);
   auto device = deviceContext->getVkDevice();
   auto& dispatch = deviceContext->getDispatch();
 
   vk::QueryPoolCreateInfo qpci;
-  qpci.queryType = vk::QueryType::eAccelerationStructureCompactedSizeNV;
+  qpci.queryType = vk::QueryType::eAccelerationStructureSerializationSizeKHR;
   qpci.queryCount = 1;
   auto pool = device.createQueryPool(qpci);
 
   Ptr cmd = deviceContext->getSingleUseCommandBuffer();
   cmd->begin();
   (**cmd).resetQueryPool(pool, 0, 1);
-  (**cmd).writeAccelerationStructuresPropertiesNV(1, &structure, vk::QueryType::eAccelerationStructureCompactedSizeNV,
-    pool, 0, dispatch);
-
+  (**cmd).writeAccelerationStructuresPropertiesKHR(1, &structureKHR,
+    vk::QueryType::eAccelerationStructureSerializationSizeKHR, pool, 0, dispatch);
   cmd->end();
   cmd->submit();
 
-  uint64 data;
-  device.getQueryPoolResults(pool, 0, 1, sizeof(uint64), &data, sizeof(uint64),
+  uint64 size;
+  device.getQueryPoolResults(pool, 0, 1, sizeof(uint64), &size, sizeof(uint64),
     vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
   device.destroyQueryPool(pool);
 
-  nei_log("BVH Bottom compacted {} kB", data/1024);
+  Ptr<Buffer> serialized = new Buffer(deviceContext, uint(size), Buffer::Type::AccelerationInput, ReadBack);
 
-  vk::AccelerationStructureCreateInfoNV info;
-  info.compactedSize = data;
-  info.info.type = vk::AccelerationStructureTypeNV::eBottomLevel;
-  info.info.flags = {};
+  vk::CopyAccelerationStructureToMemoryInfoKHR copyInfo;
+  copyInfo.src = structureKHR;
+  copyInfo.dst.deviceAddress = serialized->getDeviceAddress();
+  copyInfo.mode = vk::CopyAccelerationStructureModeKHR::eSerialize;
 
-  auto compacted = device.createAccelerationStructureNV(info, nullptr, dispatch);
+  cmd->begin();
+  (**cmd).copyAccelerationStructureToMemoryKHR(copyInfo, dispatch);
+  cmd->end();
+  cmd->submit();
 
-  vk::AccelerationStructureMemoryRequirementsInfoNV memInfo;
-  memInfo.accelerationStructure = structure;
-  memInfo.type = vk::AccelerationStructureMemoryRequirementsTypeNV::eObject;
-  auto memReqObject = device.getAccelerationStructureMemoryRequirementsNV(memInfo, dispatch);
+  std::vector<uint8> data(size);
+  memcpy(data.data(), serialized->map(), size);
+  serialized->unmap();
+  return data;
+}
 
-  auto compactedBuffer = new Buffer(deviceContext, uint(memReqObject.memoryRequirements.size),
-    Buffer::Type::Raytracing);
+bool AccelerationStructure::deserialize(std::vector<uint8> const& data) {
+  nei_assert(api == Api::KHR && !structureKHR);
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
 
-  auto& allocation = compactedBuffer->getAllocation();
-  vk::BindAccelerationStructureMemoryInfoNV bindInfo;
-  bindInfo.accelerationStructure = compacted;
-  bindInfo.memory = allocation.memory;
-  bindInfo.memoryOffset = allocation.offset;
-  bindInfo.deviceIndexCount = 0;
-  bindInfo.pDeviceIndices = nullptr;
-  device.bindAccelerationStructureMemoryNV(bindInfo, dispatch);
+  // header - driver uuid, compatibility uuid, serialized size, deserialized size, handle count
+  const size_t headerSize = 2 * VK_UUID_SIZE + 3 * sizeof(uint64);
+  if(data.size() < headerSize) return false;
+
+  vk::AccelerationStructureVersionInfoKHR versionInfo;
+  versionInfo.pVersionData = data.data();
+  auto compatibility = device.getAccelerationStructureCompatibilityKHR(versionInfo, dispatch);
+  if(compatibility != vk::AccelerationStructureCompatibilityKHR::eCompatible) return false;
+
+  uint64 header[3];
+  memcpy(header, data.data() + 2 * VK_UUID_SIZE, sizeof(header));
+  if(header[0] != data.size() || header[2] != 0) return false;
 
+  Ptr<Buffer> serialized = new Buffer(deviceContext, uint(data.size()), Buffer::Type::AccelerationInput, Stream);
+  serialized->setData(data.data(), uint(data.size()));
+
+  typeKHR = vk::AccelerationStructureTypeKHR::eBottomLevel;
+  buffer = new Buffer(deviceContext, uint(header[1]), Buffer::Type::AccelerationStorage);
+
+  vk::AccelerationStructureCreateInfoKHR asci;
+  asci.buffer = *buffer;
+  asci.size = header[1];
+  asci.type = typeKHR;
+  structureKHR = device.createAccelerationStructureKHR(asci, nullptr, dispatch);
+
+  vk::CopyMemoryToAccelerationStructureInfoKHR copyInfo;
+  copyInfo.src.deviceAddress = serialized->getDeviceAddress();
+  copyInfo.dst = structureKHR;
+  copyInfo.mode = vk::CopyAccelerationStructureModeKHR::eDeserialize;
+
+  Ptr cmd = deviceContext->getSingleUseCommandBuffer();
   cmd->begin();
-  (**cmd).copyAccelerationStructureNV(compacted, structure, vk::CopyAccelerationStructureModeNV::eCompact, dispatch);
+  (**cmd).copyMemoryToAccelerationStructureKHR(copyInfo, dispatch);
   cmd->end();
   cmd->submit();
 
-  device.destroyAccelerationStructureNV(structure, nullptr, dispatch);
+  vk::AccelerationStructureDeviceAddressInfoKHR addressInfo;
+  addressInfo.accelerationStructure = structureKHR;
+  handle = device.getAccelerationStructureAddressKHR(addressInfo, dispatch);
+  return true;
+}
 
-  buffer = compactedBuffer;
-  structure = compacted;
-  device.getAccelerationStructureHandleNV(structure, sizeof(uint64), &handle, dispatch);
+vk::BuildAccelerationStructureFlagsNV AccelerationStructure::getFlagsNV() const {
+  vk::BuildAccelerationStructureFlagsNV flags;
+  if(updatable) flags |= vk::BuildAccelerationStructureFlagBitsNV::eAllowUpdate;
+  if(compactable) flags |= vk::BuildAccelerationStructureFlagBitsNV::eAllowCompaction;
+  return flags;
+}
+
+void AccelerationStructure::queryCompactedSize(CommandBuffer* cmd) {
+  nei_assert(compactable && !compacted && compaction == Compaction::None);
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+
+  vk::QueryPoolCreateInfo qpci;
+  qpci.queryType = api == Api::KHR
+                     ? vk::QueryType::eAccelerationStructureCompactedSizeKHR
+                     : vk::QueryType::eAccelerationStructureCompactedSizeNV;
+  qpci.queryCount = 1;
+  compactionQuery = device.createQueryPool(qpci);
+
+  // build barrier is already recorded
+  (**cmd).resetQueryPool(compactionQuery, 0, 1);
+  if(api == Api::KHR)
+    (**cmd).writeAccelerationStructuresPropertiesKHR(1, &structureKHR, qpci.queryType, compactionQuery, 0, dispatch);
+  else
+    (**cmd).writeAccelerationStructuresPropertiesNV(1, &structure, qpci.queryType, compactionQuery, 0, dispatch);
+  compaction = Compaction::Queried;
+}
+
+bool AccelerationStructure::compact(CommandBuffer* cmd) {
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+
+  // structures replaced framesInFlight calls ago are no longer used by any frame
+  for(auto& r : retired) r.frames--;
+  while(!retired.empty() && retired.front().frames <= 0) {
+    destroy(retired.front());
+    retired.erase(retired.begin());
+  }
+
+  if(compaction != Compaction::Queried) return false;
+
+  uint64 size;
+  auto result = device.getQueryPoolResults(compactionQuery, 0, 1, sizeof(uint64), &size, sizeof(uint64),
+    vk::QueryResultFlagBits::e64);
+  if(result != vk::Result::eSuccess) return false;
+
+  device.destroyQueryPool(compactionQuery);
+  compactionQuery = nullptr;
+  compaction = Compaction::Done;
+
+  nei_log("BVH {} compacted {} kB -> {} kB", bufferInstances ? "Top" : "Bottom", getSize() / 1024, size / 1024);
+
+  Retired old;
+  old.structure = structure;
+  old.structureKHR = structureKHR;
+  old.buffer = buffer;
+  old.frames = framesInFlight;
+  retired.push_back(std::move(old));
+
+  // builds and updates of previous frames finish before the copy
+  barrier(cmd);
+
+  if(api == Api::KHR) {
+    buffer = new Buffer(deviceContext, uint(size), Buffer::Type::AccelerationStorage);
+
+    vk::AccelerationStructureCreateInfoKHR asci;
+    asci.buffer = *buffer;
+    asci.size = size;
+    asci.type = typeKHR;
+    structureKHR = device.createAccelerationStructureKHR(asci, nullptr, dispatch);
+
+    vk::CopyAccelerationStructureInfoKHR copyInfo;
+    copyInfo.src = old.structureKHR;
+    copyInfo.dst = structureKHR;
+    copyInfo.mode = vk::CopyAccelerationStructureModeKHR::eCompact;
+    (**cmd).copyAccelerationStructureKHR(copyInfo, dispatch);
+
+    vk::AccelerationStructureDeviceAddressInfoKHR addressInfo;
+    addressInfo.accelerationStructure = structureKHR;
+    handle = device.getAccelerationStructureAddressKHR(addressInfo, dispatch);
+  } else {
+    vk::AccelerationStructureCreateInfoNV info;
+    info.compactedSize = size;
+    info.info.type = bufferInstances ? vk::AccelerationStructureTypeNV::eTopLevel
+                                     : vk::AccelerationStructureTypeNV::eBottomLevel;
+    info.info.flags = getFlagsNV();
+    structure = device.createAccelerationStructureNV(info, nullptr, dispatch);
+
+    vk::AccelerationStructureMemoryRequirementsInfoNV memInfo;
+    memInfo.accelerationStructure = structure;
+    memInfo.type = vk::AccelerationStructureMemoryRequirementsTypeNV::eObject;
+    auto memReqObject = device.getAccelerationStructureMemoryRequirementsNV(memInfo, dispatch);
+    buffer = new Buffer(deviceContext, uint(memReqObject.memoryRequirements.size), Buffer::Type::Raytracing);
+
+    auto& allocation = buffer->getAllocation();
+    vk::BindAccelerationStructureMemoryInfoNV bindInfo;
+    bindInfo.accelerationStructure = structure;
+    bindInfo.memory = allocation.memory;
+    bindInfo.memoryOffset = allocation.offset;
+    device.bindAccelerationStructureMemoryNV(bindInfo, dispatch);
+
+    (**cmd).copyAccelerationStructureNV(structure, old.structure, vk::CopyAccelerationStructureModeNV::eCompact,
+      dispatch);
+    device.getAccelerationStructureHandleNV(structure, sizeof(uint64), &handle, dispatch);
+  }
+
+  // updates build into the copy, scratch stays
+  barrier(cmd);
+  compacted = true;
+  return true;
+}
+
+bool AccelerationStructure::isCompactionDone() const {
+  return compaction != Compaction::Queried && retired.empty();
+}
+
+void AccelerationStructure::destroy(Retired const& r) {
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+  if(r.structure) device.destroyAccelerationStructureNV(r.structure, nullptr, dispatch);
+  if(r.structureKHR) device.destroyAccelerationStructureKHR(r.structureKHR, nullptr, dispatch);
+}
+
+uint64 AccelerationStructure::getSize() const {
+  return buffer ? buffer->getSize() : 0;
 }
 
 void AccelerationStructure::barrier(CommandBuffer* cmd) {
@@ -258,3 +571,123 @@ void AccelerationStructure::barrier(CommandBuffer* cmd) {
     vk::AccessFlagBits::eAccelerationStructureReadNV | vk::AccessFlagBits::
     eAccelerationStructureWriteNV);
 }
+
+// NV geometry description is kept as the common input, buffers are translated to device addresses
+void AccelerationStructure::setGeometriesKHR(std::vector<vk::GeometryNV> const& geometries) {
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+
+  auto address = [&](vk::Buffer buffer) {
+    vk::BufferDeviceAddressInfo info;
+    info.buffer = buffer;
+    return device.getBufferAddress(info, dispatch);
+  };
+
+  geometriesKHR.clear();
+  rangesKHR.clear();
+  for(auto& g : geometries) {
+    auto& t = g.geometry.triangles;
+    nei_assert(g.geometryType == vk::GeometryTypeNV::eTriangles);
+
+    vk::AccelerationStructureGeometryTrianglesDataKHR triangles;
+    triangles.vertexFormat = t.vertexFormat;
+    triangles.vertexData.deviceAddress = address(t.vertexData) + t.vertexOffset;
+    triangles.vertexStride = t.vertexStride;
+    triangles.maxVertex = t.vertexCount - 1;
+    triangles.indexType = t.indexType;
+    triangles.indexData.deviceAddress = address(t.indexData) + t.indexOffset;
+
+    vk::AccelerationStructureGeometryKHR geometry;
+    geometry.geometryType = vk::GeometryTypeKHR::eTriangles;
+    geometry.geometry.setTriangles(triangles);
+    geometry.flags = vk::GeometryFlagsKHR(uint(g.flags));
+    geometriesKHR.push_back(geometry);
+
+    vk::AccelerationStructureBuildRangeInfoKHR range;
+    range.primitiveCount = t.indexCount / 3;
+    rangesKHR.push_back(range);
+  }
+
+  typeKHR = vk::AccelerationStructureTypeKHR::eBottomLevel;
+  flagsKHR = vk::BuildAccelerationStructureFlagsKHR(uint(getFlagsNV()));
+}
+
+// instance layout is shared by NV and KHR
+void AccelerationStructure::setInstancesKHR() {
+  vk::AccelerationStructureGeometryInstancesDataKHR data;
+  data.arrayOfPointers = false;
+  data.data.deviceAddress = bufferInstances->getDeviceAddress() + getInstanceOffset();
+
+  vk::AccelerationStructureGeometryKHR geometry;
+  geometry.geometryType = vk::GeometryTypeKHR::eInstances;
+  geometry.geometry.setInstances(data);
+  geometriesKHR = {geometry};
+
+  vk::AccelerationStructureBuildRangeInfoKHR range;
+  range.primitiveCount = instanceCount;
+  rangesKHR = {range};
+
+  typeKHR = vk::AccelerationStructureTypeKHR::eTopLevel;
+  flagsKHR = vk::BuildAccelerationStructureFlagsKHR(uint(getFlagsNV()));
+}
+
+void AccelerationStructure::createKHR(vk::AccelerationStructureTypeKHR type, bool host) {
+  auto device = deviceContext->getVkDevice();
+  auto& dispatch = deviceContext->getDispatch();
+  nei_assert(type == typeKHR);
+
+  vk::AccelerationStructureBuildGeometryInfoKHR info;
+  info.type = typeKHR;
+  info.flags = flagsKHR;
+  info.geometryCount = uint(geometriesKHR.size());
+  info.pGeometries = geometriesKHR.data();
+
+  std::vector<uint> primitiveCounts;
+  for(auto& r : rangesKHR) primitiveCounts.push_back(r.primitiveCount);
+
+  auto buildType = host ? vk::AccelerationStructureBuildTypeKHR::eHost : vk::AccelerationStructureBuildTypeKHR::eDevice;
+  auto sizes = device.getAccelerationStructureBuildSizesKHR(buildType, info, primitiveCounts, dispatch);
+
+  nei_log("{} BVH object {}kB scratch {}kB update {}kB",
+    type == vk::AccelerationStructureTypeKHR::eTopLevel ? "Top" : "Bottom", sizes.accelerationStructureSize / 1024,
+    sizes.buildScratchSize / 1024, sizes.updateScratchSize / 1024);
+
+  // host builds write the structure through a mapping, scratch lives in host memory
+  auto scratchSize = glm::max(sizes.buildScratchSize, sizes.updateScratchSize);
+  if(host) {
+    buffer = new Buffer(deviceContext, uint(sizes.accelerationStructureSize), Buffer::Type::AccelerationStorage, Stream);
+    hostScratch.resize(scratchSize);
+  } else {
+    buffer = new Buffer(deviceContext, uint(sizes.accelerationStructureSize), Buffer::Type::AccelerationStorage);
+    bufferScratch = new Buffer(deviceContext, uint(scratchSize), Buffer::Type::AccelerationScratch);
+  }
+
+  vk::AccelerationStructureCreateInfoKHR asci;
+  asci.buffer = *buffer;
+  asci.size = sizes.accelerationStructureSize;
+  asci.type = typeKHR;
+  structureKHR = device.createAccelerationStructureKHR(asci, nullptr, dispatch);
+
+  vk::AccelerationStructureDeviceAddressInfoKHR addressInfo;
+  addressInfo.accelerationStructure = structureKHR;
+  handle = device.getAccelerationStructureAddressKHR(addressInfo, dispatch);
+}
+
+void AccelerationStructure::buildKHR(CommandBuffer* cmd, bool update) {
+  auto& dispatch = deviceContext->getDispatch();
+
+  vk::AccelerationStructureBuildGeometryInfoKHR info;
+  info.type = typeKHR;
+  info.flags = flagsKHR;
+  info.mode = update ? vk::BuildAccelerationStructureModeKHR::eUpdate : vk::BuildAccelerationStructureModeKHR::eBuild;
+  info.srcAccelerationStructure = update ? structureKHR : nullptr;
+  info.dstAccelerationStructure = structureKHR;
+  info.geometryCount = uint(geometriesKHR.size());
+  info.pGeometries = geometriesKHR.data();
+  info.scratchData.deviceAddress = bufferScratch->getDeviceAddress();
+
+  auto ranges = rangesKHR.data();
+  (**cmd).buildAccelerationStructuresKHR(1, &info, &ranges, dispatch);
+  barrier(cmd);
+}
+
@@ -24,33 +24,113 @@ namespace vk {
 namespace Nei::Vu {
   class NEIVU_EXPORT AccelerationStructure : public DeviceObject {
   public:
-    AccelerationStructure(DeviceContext* dc);
+    // KHR is required for ray queries and host builds
+    using Api = RaytracingApi;
+    enum class Compaction { None, Queried, Done };
+
+    AccelerationStructure(DeviceContext* dc, Api api = Api::NV);
     virtual ~AccelerationStructure();
 
     vk::AccelerationStructureNV operator*() const { return structure; }
     operator vk::AccelerationStructureNV() const { return structure; }
+    vk::AccelerationStructureKHR getVkStructureKHR() const { return structureKHR; }
+
+    Api getApi() const { return api; }
 
+    // NV handle or KHR device address, both are used as instance reference
     uint64 getHandle() const {return handle;}
 
     void setUpdatable(bool updatable) {this->updatable=updatable;}
+    // adds the compaction flag to builds, set before build
+    void setCompactable(bool compactable) {this->compactable=compactable;}
+
+    // structure buffer size, shrinks after compact
+    uint64 getSize() const;
 
     void build(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries);
     void rebuild(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries);
     void update(CommandBuffer* cmd, std::vector<vk::GeometryNV> const& geometries);
 
+    // top level instances live in a persistently mapped ring, one slot per frame in flight
+    // structures replaced by compaction are kept for as many frames
+    void setFramesInFlight(int frames) { framesInFlight = frames; }
     void build(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances);
     void rebuild(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances);
     void update(CommandBuffer* cmd, std::vector<vk::GeometryInstance> const& instances);
 
-    void compact();
+    // advances to the next ring slot, it still holds the instances written frames in flight ago
+    vk::GeometryInstance* mapInstances();
+    // top level from the current ring slot
+    void rebuild(CommandBuffer* cmd);
+    void update(CommandBuffer* cmd);
+
+    // non blocking compaction, the size query is recorded behind the build
+    void queryCompactedSize(CommandBuffer* cmd);
+    // call once per frame, records the compacting copy as soon as the queried size is available
+    // returns true when the structure and its handle were replaced, updates work on the compacted copy
+    // but full rebuilds no longer fit
+    bool compact(CommandBuffer* cmd);
+    // no size query pending and no replaced structure alive
+    bool isCompactionDone() const;
+    bool isCompactionPending() const { return compaction == Compaction::Queried; }
+
+    // KHR bottom levels built on the host, geometry is read from host pointers instead of the buffers
+    struct HostTriangles {
+      void const* vertices = nullptr; // first vertex referenced by the geometry
+      void const* indices = nullptr;  // first index of the geometry
+    };
+    // creates the structure in host visible memory, built by buildHost
+    void prepareHost(std::vector<vk::GeometryNV> const& geometries, std::vector<HostTriangles> const& data);
+    // one deferred operation for all structures, joined by up to threads jobs of the pool
+    static void buildHost(DeviceContext* dc, std::vector<AccelerationStructure*> const& structures, ThreadPool* pool,
+                          int threads);
+    // clones a host built structure into device local memory, traversal no longer reads over the bus.
+    // The host visible copy is retired like a compacted one
+    void copyToDevice(CommandBuffer* cmd);
+
+    // KHR bottom levels only, blob starts with the driver and compatibility UUIDs
+    std::vector<uint8> serialize();
+    // false if the driver rejects the blob, the structure is then left empty
+    bool deserialize(std::vector<uint8> const& data);
 
   protected:
+    struct Retired {
+      vk::AccelerationStructureNV structure;
+      vk::AccelerationStructureKHR structureKHR;
+      Ptr<Buffer> buffer;
+      int frames = 0;
+    };
     void barrier(CommandBuffer* cmd);
+    vk::BuildAccelerationStructureFlagsNV getFlagsNV() const;
+    void destroy(Retired const& retired);
+
+    void setGeometriesKHR(std::vector<vk::GeometryNV> const& geometries);
+    void setInstancesKHR();
+    vk::DeviceSize getInstanceOffset() const;
+    void createKHR(vk::AccelerationStructureTypeKHR type, bool host = false);
+    void buildKHR(CommandBuffer* cmd, bool update);
+
+    Api api;
     bool updatable = false;
+    bool compactable = false;
+    bool compacted = false;
+    Compaction compaction = Compaction::None;
+    vk::QueryPool compactionQuery;
+    std::vector<Retired> retired;
     vk::AccelerationStructureNV structure;
+    vk::AccelerationStructureKHR structureKHR;
+    vk::AccelerationStructureTypeKHR typeKHR;
+    vk::BuildAccelerationStructureFlagsKHR flagsKHR;
+    std::vector<vk::AccelerationStructureGeometryKHR> geometriesKHR;
+    std::vector<vk::AccelerationStructureBuildRangeInfoKHR> rangesKHR;
     uint64 handle=0;
     Ptr<Buffer> buffer;
     Ptr<Buffer> bufferScratch;
     Ptr<Buffer> bufferInstances;
+    std::vector<uint8> hostScratch;
+    vk::GeometryInstance* mappedInstances = nullptr;
+    uint instanceCount = 0;
+    int framesInFlight = 1;
+    int instanceSlot = 0;
   };
 };
@@ -13,6 +13,9 @@ Allocation AdvancedMemoryManager::allocate(vk::Image image, MemoryUsage usage) {
 Allocation AdvancedMemoryManager::allocate(vk::Buffer buffer, MemoryUsage usage) {
   return Allocation();
 }
+Allocation AdvancedMemoryManager::allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage) {
+  return Allocation();
+}
 
 void AdvancedMemoryManager::free(Allocation const& allocation) {
   
@@ -10,6 +10,7 @@ public:
 
   Allocation allocate(vk::Image image, MemoryUsage usage) override;
   Allocation allocate(vk::Buffer buffer, MemoryUsage usage) override;
+  Allocation allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage) override;
   void free(Allocation const& allocation) override;
   void* map(Allocation const& allocation) override;
   void unmap(Allocation const& allocation) override;
@@ -8,49 +8,21 @@ BasicMemoryManager::BasicMemoryManager(DeviceContext* dc): MemoryManager(dc) { }
 BasicMemoryManager::~BasicMemoryManager() { }
 
 Allocation BasicMemoryManager::allocate(vk::Image image, MemoryUsage usage) {
-  nei_assert(usage != Default);
-
-  vk::MemoryPropertyFlags requiredFlags;
-
-  if(usage == GpuOnly) requiredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
-  else
-    requiredFlags = vk::MemoryPropertyFlagBits::eHostVisible |
-      vk::MemoryPropertyFlagBits::eHostCoherent |
-      vk::MemoryPropertyFlagBits::eHostCached;
-
   auto device = deviceContext->getVkDevice();
-  auto req = device.getImageMemoryRequirements(image);
-
-  auto index = findMemoryType(req.memoryTypeBits,requiredFlags);
-  nei_assert(index>=0);
-
-
-  vk::MemoryAllocateInfo ai;
-  ai.memoryTypeIndex = index;
-  ai.allocationSize = req.size;
-
-  Ptr block = new MemoryBlock;
-  block->memory = device.allocateMemory(ai);
-  block->size = req.size;
-
-  memoryBlocks.push_back(block);
-
-  Allocation allocation;
-  allocation.size = uint(req.size);
-  allocation.offset = 0;
-  allocation.memory = block->memory;
-  
-  allocationMap[allocation] = block;
-
-  device.bindImageMemory(image,block->memory,0);
+  auto allocation = allocate(device.getImageMemoryRequirements(image), usage);
+  device.bindImageMemory(image, allocation.memory, 0);
   return allocation;
 }
 
 Allocation BasicMemoryManager::allocate(vk::Buffer buffer, MemoryUsage usage) {
-  nei_assert(usage != Default);
-
   auto device = deviceContext->getVkDevice();
-  auto req = device.getBufferMemoryRequirements(buffer);
+  auto allocation = allocate(device.getBufferMemoryRequirements(buffer), usage);
+  device.bindBufferMemory(buffer, allocation.memory, 0);
+  return allocation;
+}
+
+Allocation BasicMemoryManager::allocate(vk::MemoryRequirements const& req, MemoryUsage usage) {
+  nei_assert(usage != Default && usage != Aliased);
 
   vk::MemoryPropertyFlags requiredFlags;
   if (usage == GpuOnly) requiredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
@@ -60,25 +32,33 @@ Allocation BasicMemoryManager::allocate(vk::Buffer buffer, MemoryUsage usage) {
     vk::MemoryPropertyFlagBits::eHostCached;
 
   auto index = findMemoryType(req.memoryTypeBits, requiredFlags);
+  nei_assert(index>=0);
 
   vk::MemoryAllocateInfo ai;
   ai.memoryTypeIndex = index;
   ai.allocationSize = req.size;
 
+  // any buffer can be used as acceleration structure input when device address is enabled
+  vk::MemoryAllocateFlagsInfo flagsInfo;
+  flagsInfo.flags = vk::MemoryAllocateFlagBits::eDeviceAddress;
+  if(deviceContext->supportsDeviceAddress()) ai.pNext = &flagsInfo;
+
+  auto device = deviceContext->getVkDevice();
   Ptr block = new MemoryBlock;
   block->memory = device.allocateMemory(ai);
   block->size = req.size;
 
   memoryBlocks.push_back(block);
 
+  allocatedSize += block->size;
+  peakSize = glm::max(peakSize, allocatedSize);
+
   Allocation allocation;
   allocation.size = uint(req.size);
   allocation.offset = 0;
   allocation.memory = block->memory;
 
   allocationMap[allocation] = block;
-
-  device.bindBufferMemory(buffer, block->memory, 0);
   return allocation;
 }
 
@@ -88,6 +68,7 @@ void BasicMemoryManager::free(Allocation const& allocation) {
   if(block->mappedCount > 0)
   nei_error("Freeing mapped memory!");
   deviceContext->getVkDevice().freeMemory(block->memory);
+  allocatedSize -= block->size;
 
   auto it = std::find(memoryBlocks.begin(),memoryBlocks.end(),block);
   memoryBlocks.erase(it);
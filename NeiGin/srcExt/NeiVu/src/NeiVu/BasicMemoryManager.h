@@ -10,6 +10,7 @@ namespace Nei::Vu {
 
     Allocation allocate(vk::Image image, MemoryUsage usage = Default) override;
     Allocation allocate(vk::Buffer buffer, MemoryUsage usage = Default) override;
+    Allocation allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage = Default) override;
 
     void free(Allocation const& allocation) override;
     void* map(Allocation const& allocation) override;
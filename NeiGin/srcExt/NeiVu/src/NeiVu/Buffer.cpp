@@ -42,7 +42,8 @@ void Buffer::create(uint size, Type type, MemoryUsage mem) {
     memoryType = GpuOnly;
     break;
   case Storage:
-    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::
+      BufferUsageFlagBits::eTransferSrc;
     memoryType = GpuOnly;
     break;
   case Staging:
@@ -70,23 +71,69 @@ void Buffer::create(uint size, Type type, MemoryUsage mem) {
       BufferUsageFlagBits::eStorageBuffer;
     memoryType = GpuOnly;
     break;
+  case IndirectStorage:
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::
+      BufferUsageFlagBits::eStorageBuffer;
+    // indirect trace rays reads the launch size by device address
+    if(deviceContext->supportsDeviceAddress())
+      bufferCreateInfo.usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    memoryType = GpuOnly;
+    break;
+  case AccelerationStorage:
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::
+      eShaderDeviceAddress;
+    memoryType = GpuOnly;
+    break;
+  case AccelerationScratch:
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    memoryType = GpuOnly;
+    break;
+  case AccelerationInput:
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::
+      BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst;
+    memoryType = Stream;
+    break;
+  case BindingTable:
+    // same bit as eRayTracingNV, khr tables are addressed by device address
+    bufferCreateInfo.usage = vk::BufferUsageFlagBits::eShaderBindingTableKHR | vk::BufferUsageFlagBits::eTransferDst;
+    if(deviceContext->supportsDeviceAddress())
+      bufferCreateInfo.usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    memoryType = GpuOnly;
+    break;
+  }
+
+  // mesh buffers can be used directly as khr acceleration structure build input
+  if(deviceContext->supportsDeviceAddress() && (type == VertexStorage || type == IndexStorage)) {
+    bufferCreateInfo.usage |= vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::
+      BufferUsageFlagBits::eShaderDeviceAddress;
   }
 
   if (mem != Default) {
     memoryType = mem;
   }
 
-  mappable = memoryType == CpuOnly || memoryType == Stream;
+  mappable = memoryType == CpuOnly || memoryType == Stream || memoryType == ReadBack;
 
   if (size == 0) return;
 
+  auto& families = deviceContext->getConcurrentQueues();
+  concurrent = !families.empty();
+  if(concurrent) {
+    bufferCreateInfo.sharingMode = vk::SharingMode::eConcurrent;
+    bufferCreateInfo.queueFamilyIndexCount = uint32(families.size());
+    bufferCreateInfo.pQueueFamilyIndices = families.data();
+  }
+
   auto device = deviceContext->getVkDevice();
   buffer = device.createBuffer(bufferCreateInfo);
-  allocation = deviceContext->getMemoryManager()->allocate(buffer, memoryType);
+  if(memoryType != Aliased)
+    allocation = deviceContext->getMemoryManager()->allocate(buffer, memoryType);
 }
 
 void Buffer::destroy() {
-  deviceContext->getMemoryManager()->free(allocation);
+  // aliased memory is owned by TransientMemory
+  if(memoryType != Aliased)
+    deviceContext->getMemoryManager()->free(allocation);
   buffer = nullptr;
   allocation = Allocation();
 }
@@ -129,6 +176,7 @@ void Buffer::setDataAsync(TransferBuffer* tb, const void* data, uint size, uint
   temp->setData(data, size, 0);
   auto cmd = tb->getCommandBuffer();
   cmd->copy(temp, this, size, 0, offset);
+  tb->release(this);
 }
 
 void Buffer::setDataInline(CommandBuffer* cmd,  const void* data, uint size, uint offset) {
@@ -136,15 +184,22 @@ void Buffer::setDataInline(CommandBuffer* cmd,  const void* data, uint size, uin
   (**cmd).updateBuffer(buffer, offset, size, data);
 }
 
-void Buffer::transferOwnership(CommandBuffer* cmd, uint srcIndex, uint dstIndex) {
+void Buffer::transferOwnership(CommandBuffer* cmd, CommandBuffer* acquire, uint srcIndex, uint dstIndex) {
   vk::BufferMemoryBarrier bmb;
   bmb.srcQueueFamilyIndex = srcIndex;
   bmb.dstQueueFamilyIndex = dstIndex;
   bmb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
   bmb.dstAccessMask = {};
   bmb.buffer = buffer;
+  bmb.size = VK_WHOLE_SIZE;
   (**cmd).pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {bmb},
                           {});
+
+  // access masks of the release are ignored on the acquiring queue and vice versa
+  bmb.srcAccessMask = {};
+  bmb.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+  (**acquire).pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, {},
+                              {bmb}, {});
 }
 
 void* Buffer::map() {
@@ -159,3 +214,19 @@ void Buffer::unmap() {
 Allocation const& Buffer::getAllocation() {
   return allocation;
 }
+
+vk::MemoryRequirements Buffer::getMemoryRequirements() const {
+  return deviceContext->getVkDevice().getBufferMemoryRequirements(buffer);
+}
+
+void Buffer::bindMemory(Allocation const& allocation) {
+  nei_assert(memoryType == Aliased && buffer);
+  deviceContext->getVkDevice().bindBufferMemory(buffer, allocation.memory, allocation.offset);
+  this->allocation = allocation;
+}
+
+vk::DeviceAddress Buffer::getDeviceAddress() const {
+  vk::BufferDeviceAddressInfo info;
+  info.buffer = buffer;
+  return deviceContext->getVkDevice().getBufferAddress(info, deviceContext->getDispatch());
+}
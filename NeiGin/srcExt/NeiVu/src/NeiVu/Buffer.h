@@ -6,9 +6,13 @@
 namespace Nei::Vu {
   const int inlineBufferCopySize = 65536;
 
-  class NEIVU_EXPORT Buffer : public DeviceObject {
+  class NEIVU_EXPORT Buffer : public DeviceObject, public Pooled<Buffer> {
   public:
-    enum Type { Vertex, Index, Indirect, Storage, Staging, Uniform, Raytracing, VertexStorage, IndexStorage};
+    enum Type {
+      Vertex, Index, Indirect, Storage, Staging, Uniform, Raytracing, VertexStorage, IndexStorage, IndirectStorage,
+      AccelerationStorage, AccelerationScratch, AccelerationInput, // khr acceleration structure
+      BindingTable // shader binding table, nv and khr
+    };
 
     Buffer(DeviceContext* dc);
     Buffer(DeviceContext* dc, uint size, Type type, MemoryUsage mem = Default);
@@ -25,18 +29,28 @@ namespace Nei::Vu {
     void setDataAsync(TransferBuffer* tb, const void* data, uint size, uint offset = 0);
     void setDataInline(CommandBuffer* cmd, const void* data, uint size, uint offset = 0);
 
-    void transferOwnership(CommandBuffer* cmd, uint srcIndex, uint dstIndex);
+    // release barrier into cmd on the source queue, matching acquire into acquire on the destination queue
+    void transferOwnership(CommandBuffer* cmd, CommandBuffer* acquire, uint srcIndex, uint dstIndex);
 
     void* map();
     void unmap();
 
     Allocation const& getAllocation();
 
+    // buffers created with Aliased memory are placed into a shared allocation
+    vk::MemoryRequirements getMemoryRequirements() const;
+    void bindMemory(Allocation const& allocation);
+
+    // requires device address support, see DeviceContext::supportsDeviceAddress
+    vk::DeviceAddress getDeviceAddress() const;
+
     auto getSize() const { return size; }
     auto getVkBuffer() const { return buffer; }
     auto getType() const { return type; }
     auto getMemoryType() const { return memoryType; }
     bool isMappable() const { return mappable; }
+    // shared by queue families, see DeviceContext::setConcurrentQueues
+    bool isConcurrent() const { return concurrent; }
 
     operator vk::Buffer() const { return buffer; }
     vk::Buffer operator*() const { return buffer; }
@@ -47,6 +61,7 @@ namespace Nei::Vu {
     uint64 size = 0;
     vk::Buffer buffer;
     bool mappable = false;
+    bool concurrent = false;
     //VmaAllocation allocation = nullptr;
     //VmaAllocationInfo allocationInfo;
     Allocation allocation;
@@ -12,7 +12,6 @@
 #include "Swapchain.h"
 #include "ShaderBindingTable.h"
 #include "Texture.h"
-#include "Fence.h"
 
 #include "CommandPool.h"
 
@@ -170,11 +169,30 @@ void CommandBuffer::drawIndexed(uint indexCount, uint instanceCount, uint firstI
   commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, firstVertex, firstInstance);
 }
 
+void CommandBuffer::drawIndexedIndirect(Buffer* buffer, uint offset, uint drawCount, uint stride) {
+  commandBuffer.drawIndexedIndirect(*buffer, offset, drawCount, stride);
+}
+
+void CommandBuffer::drawIndexedIndirectCount(Buffer* buffer, uint offset, Buffer* countBuffer, uint countOffset,
+                                             uint maxDrawCount, uint stride) {
+  commandBuffer.drawIndexedIndirectCountKHR(*buffer, offset, *countBuffer, countOffset, maxDrawCount, stride,
+    deviceContext->getDispatch());
+}
+
 void CommandBuffer::dispatch(ivec3 const& size) {
   commandBuffer.dispatch(size.x, size.y, size.z);
 }
 
+void CommandBuffer::dispatchIndirect(Buffer* buffer, uint offset) {
+  commandBuffer.dispatchIndirect(*buffer, offset);
+}
+
 void CommandBuffer::raytrace(ShaderBindingTable* sbt, ivec3 const& size) {
+  if(sbt->getApi() == RaytracingApi::KHR) {
+    commandBuffer.traceRaysKHR(sbt->getRayGenRegion(), sbt->getMissRegion(), sbt->getHitRegion(),
+      sbt->getCallableRegion(), size.x, size.y, size.z, deviceContext->getDispatch());
+    return;
+  }
   commandBuffer.traceRaysNV(sbt->getRayGenBuffer(), sbt->getRayGenOffset(),
     sbt->getMissBuffer(), sbt->getMissOffset(), sbt->getMissStride(),
     sbt->getHitBuffer(), sbt->getHitOffset(), sbt->getHitStride(),
@@ -182,6 +200,12 @@ void CommandBuffer::raytrace(ShaderBindingTable* sbt, ivec3 const& size) {
     size.x, size.y, size.z, deviceContext->getDispatch());
 }
 
+void CommandBuffer::raytraceIndirect(ShaderBindingTable* sbt, Buffer* buffer, uint offset) {
+  nei_assertm(sbt->getApi() == RaytracingApi::KHR, "Indirect trace needs VK_KHR_ray_tracing_pipeline");
+  commandBuffer.traceRaysIndirectKHR(sbt->getRayGenRegion(), sbt->getMissRegion(), sbt->getHitRegion(),
+    sbt->getCallableRegion(), buffer->getDeviceAddress() + offset, deviceContext->getDispatch());
+}
+
 void CommandBuffer::reset() {
   commandBuffer.reset({vk::CommandBufferResetFlagBits::eReleaseResources});
 
@@ -189,39 +213,22 @@ void CommandBuffer::reset() {
   boundComputePipeline = nullptr;
   boundGraphicsPipeline = nullptr;
   boundRaytracingPipeline = nullptr;
+  currentRenderPass = nullptr;
+  currentFramebuffer = nullptr;
 
   executable = false;
 }
 
-void CommandBuffer::submit(bool wait) {
-  vk::SubmitInfo si;
-  si.commandBufferCount = 1;
-  si.pCommandBuffers = &commandBuffer;
-  auto queue = deviceContext->getQueue(queueIndex);
-  if(!fence) fence = new Fence(deviceContext);
-  fence->reset();
-  queue.submit({si}, *fence);
-  if(wait)queue.waitIdle();
+uint64 CommandBuffer::submit(bool wait) {
+  ticket = deviceContext->submit(queueIndex, std::vector<vk::CommandBuffer>{commandBuffer});
+  if(wait) deviceContext->wait(ticket);
+  return ticket;
 }
 
-void CommandBuffer::submit(std::vector<vk::Semaphore> wait, std::vector<vk::Semaphore> signal,
-                           std::vector<vk::PipelineStageFlags> stages) {
-  assert(signal.size() == stages.size());
-  vk::SubmitInfo si;
-  si.commandBufferCount = 1;
-  si.pCommandBuffers = &commandBuffer;
-  si.waitSemaphoreCount = (uint32)wait.size();
-  si.pWaitSemaphores = wait.data();
-  si.pWaitDstStageMask = stages.data();
-  si.signalSemaphoreCount = (uint32)signal.size();
-  si.pSignalSemaphores = signal.data();
-
-  auto queue = deviceContext->getQueue(queueIndex);
-  assert(queue);
-  if(!fence) fence = new Fence(deviceContext);
-  fence->reset();
-  queue.submit({si}, *fence);
-
+uint64 CommandBuffer::submit(std::vector<vk::Semaphore> wait, std::vector<vk::Semaphore> signal,
+                             std::vector<vk::PipelineStageFlags> stages) {
+  ticket = deviceContext->submit(queueIndex, std::vector<vk::CommandBuffer>{commandBuffer}, wait, stages, signal);
+  return ticket;
 }
 
 void CommandBuffer::submit(Ptr<Swapchain> const& swapchain) {
@@ -229,18 +236,30 @@ void CommandBuffer::submit(Ptr<Swapchain> const& swapchain) {
     {swapchain->getPresentSemaphore()}, {vk::PipelineStageFlagBits::eColorAttachmentOutput});
 }
 
+void CommandBuffer::submit(Ptr<Swapchain> const& swapchain, std::vector<vk::Semaphore> wait,
+                           std::vector<vk::Semaphore> signal, std::vector<vk::PipelineStageFlags> stages) {
+  wait.push_back(swapchain->getAcquireSemaphore());
+  stages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+  signal.push_back(swapchain->getPresentSemaphore());
+  submit(wait, signal, stages);
+}
+
 void CommandBuffer::execute(Ptr<CommandBuffer> const& scmd) {
   commandBuffer.executeCommands({*scmd});
 }
 
 void CommandBuffer::wait() {
-  if (!fence)return;
+  if (!ticket)return;
   Profile("CommandBuffer::wait");  
-  fence->wait();
+  deviceContext->wait(ticket);
+}
+
+bool CommandBuffer::isFinished() {
+  return deviceContext->isFinished(ticket);
 }
 
-void CommandBuffer::setFence(Ptr<Fence> const& fence) {
-  this->fence = fence;
+void CommandBuffer::setTicket(uint64 ticket) {
+  this->ticket = ticket;
 }
 
 void CommandBuffer::debugBarrier() {
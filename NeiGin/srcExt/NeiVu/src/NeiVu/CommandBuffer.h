@@ -30,19 +30,34 @@ namespace Nei::Vu {
     void draw(uint vertexCount, uint instanceCount = 1, uint firstVertex = 0, uint firstInstance = 0);
     void drawIndexed(uint indexCount, uint instanceCount = 1, uint firstIndex = 0, uint firstVertex = 0,
                      uint firstInstance = 0);
+    // VkDrawIndexedIndirectCommand records, more than one draw needs multiDrawIndirect
+    void drawIndexedIndirect(Buffer* buffer, uint offset, uint drawCount,
+                             uint stride = sizeof(vk::DrawIndexedIndirectCommand));
+    // draw count is read from countBuffer, needs VK_KHR_draw_indirect_count
+    void drawIndexedIndirectCount(Buffer* buffer, uint offset, Buffer* countBuffer, uint countOffset,
+                                  uint maxDrawCount, uint stride = sizeof(vk::DrawIndexedIndirectCommand));
     void dispatch(ivec3 const& size);
+    void dispatchIndirect(Buffer* buffer, uint offset = 0);
     void raytrace(ShaderBindingTable* sbt, ivec3 const& size);
+    // khr only, launch size is a vk::TraceRaysIndirectCommandKHR at offset written by the gpu
+    void raytraceIndirect(ShaderBindingTable* sbt, Buffer* buffer, uint offset = 0);
     void execute(Ptr<CommandBuffer> const& scmd);
 
-    void submit(bool wait = true);
-    void submit(std::vector<vk::Semaphore> wait, std::vector<vk::Semaphore> signal,
-                std::vector<vk::PipelineStageFlags> stages);
+    // returns the submission ticket, see DeviceContext::submit. wait blocks only on this submission
+    uint64 submit(bool wait = true);
+    uint64 submit(std::vector<vk::Semaphore> wait, std::vector<vk::Semaphore> signal,
+                  std::vector<vk::PipelineStageFlags> stages);
     void submit(Ptr<Swapchain> const& swapchain);
+    // extra semaphores next to acquire and present, e.g. work from other queues
+    void submit(Ptr<Swapchain> const& swapchain, std::vector<vk::Semaphore> wait, std::vector<vk::Semaphore> signal,
+                std::vector<vk::PipelineStageFlags> stages);
 
-    auto& getFence() const { return fence; }
+    uint64 getTicket() const { return ticket; }
     void reset();
+    // last submission of this buffer
     void wait();
-    void setFence(Ptr<Fence> const& fence);
+    bool isFinished();
+    void setTicket(uint64 ticket);
 
     vk::CommandBuffer operator*() const { return commandBuffer; }
     operator vk::CommandBuffer() const { return commandBuffer; }
@@ -65,15 +80,17 @@ namespace Nei::Vu {
     bool executable = false;
     vk::CommandBuffer commandBuffer;
     vk::CommandPool pool;
-    Ptr<Fence> fence;
+    uint64 ticket = 0;
     int queueIndex;
 
-    Ptr<Pipeline> lastBoundPipeline;
-    Ptr<GraphicsPipeline> boundGraphicsPipeline;
-    Ptr<ComputePipeline> boundComputePipeline;
-    Ptr<RaytracingPipeline> boundRaytracingPipeline;
+    // borrowed, bound objects have to outlive the recording anyway, a bind is then two pointer stores
+    // instead of atomic ref and unref pairs
+    Ref<Pipeline> lastBoundPipeline;
+    Ref<GraphicsPipeline> boundGraphicsPipeline;
+    Ref<ComputePipeline> boundComputePipeline;
+    Ref<RaytracingPipeline> boundRaytracingPipeline;
 
-    Ptr<RenderPass> currentRenderPass;
-    Ptr<Framebuffer> currentFramebuffer;
+    Ref<RenderPass> currentRenderPass;
+    Ref<Framebuffer> currentFramebuffer;
   };
 };
@@ -32,7 +32,8 @@ Context::Context(ContextCreateInfo const& info) {
   validationEnabled = info.validation;
   
   vk::ApplicationInfo appInfo;
-  appInfo.apiVersion = VK_MAKE_VERSION(1,1,0);
+  // 1.2 for buffer device address and spirv 1.5 (khr ray tracing), device may still be 1.1
+  appInfo.apiVersion = apiVersion;
   appInfo.applicationVersion = info.applicationVersion;
   appInfo.engineVersion = NEIVU_VERSION;
   appInfo.pApplicationName = info.applicationName.c_str();
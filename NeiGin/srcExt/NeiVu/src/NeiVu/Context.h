@@ -16,11 +16,13 @@ namespace Nei::Vu {
 
     auto getVkInstance() const { return instance; }
     bool isValidationEnabled() const { return validationEnabled; }
+    uint32 getApiVersion() const { return apiVersion; }
 
     static bool supportsExtension(std::string const& name);
     static bool supportsLayer(std::string const& name);
   protected:
     bool validationEnabled;
+    uint32 apiVersion = VK_MAKE_VERSION(1, 2, 0);
     vk::Instance instance;
     vk::DebugReportCallbackEXT debugCallback;
     vk::DispatchLoaderDynamic dynamicDispatch;
@@ -6,6 +6,7 @@
 #include "Buffer.h"
 #include "Texture.h"
 #include "AccelerationStructure.h"
+#include "UniformRing.h"
 
 using namespace Nei::Vu;
 
@@ -49,6 +50,10 @@ void DescriptorSet::update(uint binding, Buffer* buffer, uint offset, size_t siz
   device.updateDescriptorSets({write},{});
 }
 
+void DescriptorSet::update(uint binding, UniformRing* ring, uint range) {
+  update(binding, ring->getBuffer(), 0, range);
+}
+
 void DescriptorSet::update(uint binding, vk::ImageView view,  vk::Sampler sampler) {
   bool storage = false;  
   bool found = false;
@@ -85,6 +90,11 @@ void DescriptorSet::update(uint binding, AccelerationStructure* as) {
   vk::WriteDescriptorSetAccelerationStructureNV writeAs;
   writeAs.accelerationStructureCount = 1;
   writeAs.pAccelerationStructures = &vkas;
+
+  auto vkasKHR = as->getVkStructureKHR();
+  vk::WriteDescriptorSetAccelerationStructureKHR writeAsKHR;
+  writeAsKHR.accelerationStructureCount = 1;
+  writeAsKHR.pAccelerationStructures = &vkasKHR;
   
   vk::DescriptorType type;
   for (auto &b : descriptorSetLayout->getBindings()) {
@@ -93,6 +103,10 @@ void DescriptorSet::update(uint binding, AccelerationStructure* as) {
 
   vk::WriteDescriptorSet write;
   write.pNext = &writeAs;
+  if (as->getApi() == AccelerationStructure::Api::KHR) {
+    nei_assert(type == vk::DescriptorType::eAccelerationStructureKHR);
+    write.pNext = &writeAsKHR;
+  }
   write.descriptorCount = 1;
   write.descriptorType = type;
   write.dstSet = descriptorSet;
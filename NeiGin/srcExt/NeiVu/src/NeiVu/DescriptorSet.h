@@ -6,7 +6,7 @@
 namespace Nei::Vu {
   const size_t WholeSize = ~0ull;
 
-  class NEIVU_EXPORT DescriptorSet : public DeviceObject {
+  class NEIVU_EXPORT DescriptorSet : public DeviceObject, public Pooled<DescriptorSet> {
   public:
     DescriptorSet(DeviceContext* dc, DescriptorPool* pool, DescriptorSetLayout* layout, vk::DescriptorSet set);
     virtual ~DescriptorSet();
@@ -22,6 +22,8 @@ namespace Nei::Vu {
     }
 
     void update(uint binding, Buffer* buffer, uint offset = 0, size_t size = WholeSize);
+    // dynamic uniform binding, range is the size of one allocation
+    void update(uint binding, UniformRing* ring, uint range);
     void update(uint binding, vk::ImageView view, vk::Sampler sampler={});
     void update(uint binding, AccelerationStructure* as);
 
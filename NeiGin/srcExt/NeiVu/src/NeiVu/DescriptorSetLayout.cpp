@@ -28,6 +28,19 @@ void DescriptorSetLayout::addDescriptor(int binding, vk::DescriptorType type,
   }
 }
 
+void DescriptorSetLayout::setDynamic(int binding) {
+  auto it = std::find_if(bindings.begin(), bindings.end(), [&](vk::DescriptorSetLayoutBinding& b) {
+    return b.binding == binding;
+  });
+  if(it == bindings.end()) {
+    nei_error("binding {} not in set", binding);
+    return;
+  }
+  nei_assert(it->descriptorType == vk::DescriptorType::eUniformBuffer ||
+             it->descriptorType == vk::DescriptorType::eUniformBufferDynamic);
+  it->descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+}
+
 void DescriptorSetLayout::create(bool push) {
   vk::DescriptorSetLayoutCreateInfo dslci;
   dslci.bindingCount = (uint32)bindings.size();
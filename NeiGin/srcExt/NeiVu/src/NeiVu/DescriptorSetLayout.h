@@ -9,6 +9,8 @@ namespace Nei::Vu {
     virtual ~DescriptorSetLayout();
 
     void addDescriptor(int binding, vk::DescriptorType type, vk::ShaderStageFlags stage, uint count = 1, vk::Sampler* sampler=nullptr);
+    // uniform buffer binding takes a dynamic offset when bound, before create
+    void setDynamic(int binding);
     void create(bool push=false);
 
     operator vk::DescriptorSetLayout() const { return descriptorSetLayout; }
@@ -2,6 +2,7 @@
 
 #include "Context.h"
 #include <thread>
+#include <algorithm>
 #include "CommandBuffer.h"
 #include "SamplerManager.h"
 #include "FxLoader.h"
@@ -35,7 +36,10 @@ DeviceContext::DeviceContext(CreateInfo const& createInfo) {
   std::vector<const char *> enabledLayers;
 
   auto addExtension = [&](const char* name) {
-    if(supportsExtension(name)) enabledExtensions.push_back(name);
+    if(supportsExtension(name)) {
+      enabledExtensions.push_back(name);
+      extensions.insert(name);
+    }
   };
 
   auto addLayer = [&](const char* name) {
@@ -52,10 +56,24 @@ DeviceContext::DeviceContext(CreateInfo const& createInfo) {
   // allows negative viewport height - avoids inverting y in shader
   addExtension(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
 
+  // submission tickets
+  addExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
   for(auto& e : createInfo.extensions) {
     addExtension(e);
   }
 
+  // khr ray tracing dependencies, core in 1.2 but still listed as extensions
+  if(isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME))
+    addExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
+  if(isExtensionEnabled(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME)) {
+    addExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+    addExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+    addExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    addExtension(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+    addExtension(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+  }
+
   if(context->isValidationEnabled())
     addLayer("VK_LAYER_LUNARG_standard_validation");
 
@@ -101,14 +119,69 @@ DeviceContext::DeviceContext(CreateInfo const& createInfo) {
   nei_assert(transferQueueIndex >= 0);
   //nei_assert(computeQueueIndex >= 0);
 
-  vk::PhysicalDeviceFeatures features;
   features.tessellationShader = true;
   features.geometryShader = true;
   features.independentBlend = true;
   features.samplerAnisotropy = true;
   features.fillModeNonSolid = true;
+  // gpu driven draws, optional
+  auto supportedFeatures = physicalDevice.getFeatures();
+  features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+  // extension features, chained only when the extension is enabled
+  vk::PhysicalDeviceBufferDeviceAddressFeatures addressFeatures;
+  vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelerationFeatures;
+  vk::PhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures;
+  vk::PhysicalDeviceRayTracingPipelineFeaturesKHR pipelineFeatures;
+  vk::PhysicalDeviceTimelineSemaphoreFeatures timelineFeatures;
+  void* featureChain = nullptr;
+
+  if(isExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    timelineSemaphores = true;
+    timelineFeatures.timelineSemaphore = true;
+    timelineFeatures.pNext = featureChain;
+    featureChain = &timelineFeatures;
+  }
+
+  if(isExtensionEnabled(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)) {
+    addressFeatures.bufferDeviceAddress = true;
+    addressFeatures.pNext = featureChain;
+    featureChain = &addressFeatures;
+  }
+  if(isExtensionEnabled(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME)) {
+    // host builds are optional, lavapipe and some drivers support them
+    vk::PhysicalDeviceAccelerationStructureFeaturesKHR supported;
+    vk::PhysicalDeviceFeatures2 features2;
+    features2.pNext = &supported;
+    physicalDevice.getFeatures2(&features2);
+    hostBuilds = supported.accelerationStructureHostCommands;
+
+    accelerationFeatures.accelerationStructure = true;
+    accelerationFeatures.accelerationStructureHostCommands = hostBuilds;
+    accelerationFeatures.pNext = featureChain;
+    featureChain = &accelerationFeatures;
+  }
+  if(isExtensionEnabled(VK_KHR_RAY_QUERY_EXTENSION_NAME)) {
+    rayQueryFeatures.rayQuery = true;
+    rayQueryFeatures.pNext = featureChain;
+    featureChain = &rayQueryFeatures;
+  }
+  if(isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME)) {
+    vk::PhysicalDeviceRayTracingPipelineFeaturesKHR supported;
+    vk::PhysicalDeviceFeatures2 features2;
+    features2.pNext = &supported;
+    physicalDevice.getFeatures2(&features2);
+    traceRaysIndirect = supported.rayTracingPipelineTraceRaysIndirect;
+
+    pipelineFeatures.rayTracingPipeline = true;
+    pipelineFeatures.rayTracingPipelineTraceRaysIndirect = traceRaysIndirect;
+    pipelineFeatures.pNext = featureChain;
+    featureChain = &pipelineFeatures;
+  }
 
   vk::DeviceCreateInfo dci;
+  dci.pNext = featureChain;
   dci.queueCreateInfoCount = uint32(queues.size());
   dci.pQueueCreateInfos = queues.data();
   dci.enabledExtensionCount = uint32(enabledExtensions.size());
@@ -122,6 +195,8 @@ DeviceContext::DeviceContext(CreateInfo const& createInfo) {
 
   dispatch.init(instance, vkGetInstanceProcAddr, device, vkGetDeviceProcAddr);
 
+  apiVersion = glm::min(context->getApiVersion(), physicalDevice.getProperties().apiVersion);
+
   mainQueue = device.getQueue(mainQueueIndex, 0);
   if(transferQueueIndex != -1)
     transferQueue = device.getQueue(transferQueueIndex, 0);
@@ -147,6 +222,13 @@ DeviceContext::DeviceContext(CreateInfo const& createInfo) {
 
 DeviceContext::~DeviceContext() {
   TracyVkDestroy(tracyContext);
+
+  for(auto& [queue, timeline] : timelines) {
+    if(timeline.semaphore) device.destroySemaphore(timeline.semaphore);
+    for(auto& p : timeline.pending) {
+      if(p.owned) device.destroyFence(p.fence);
+    }
+  }
   device.destroyPipelineCache(pipelineCache);
 
   for(auto& [id, cp] : commandPoolMap) {
@@ -173,6 +255,26 @@ bool DeviceContext::supportsLayer(std::string const& name) const {
   return false;
 }
 
+bool DeviceContext::isExtensionEnabled(std::string const& name) const {
+  return extensions.count(name) > 0;
+}
+
+bool DeviceContext::supportsRayQuery() const {
+  return isExtensionEnabled(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+}
+
+bool DeviceContext::supportsRaytracingPipeline() const {
+  return isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+}
+
+bool DeviceContext::supportsDrawIndirectCount() const {
+  return isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+}
+
+bool DeviceContext::supportsDeviceAddress() const {
+  return isExtensionEnabled(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+}
+
 bool DeviceContext::supportsImageFormat(vk::Format format, vk::FormatFeatureFlags usage) {
   auto prop = physicalDevice.getFormatProperties(format);
   return !!(prop.optimalTilingFeatures & usage);
@@ -194,20 +296,34 @@ vk::CommandPool DeviceContext::getCommandPool(int queueIndex) {
   static std::hash<std::thread::id> hasher;
   auto id = hasher(std::this_thread::get_id());
   id = 0;
-  auto cp = commandPoolMap[id];
+  // pools are bound to one queue family
+  uint64 key = uint64(queueIndex) << 32 | (id & 0xffffffff);
+  auto cp = commandPoolMap[key];
   if(!cp) {
 
     vk::CommandPoolCreateInfo i;
     i.queueFamilyIndex = queueIndex;
     i.flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
     cp = device.createCommandPool(i);
-    commandPoolMap[id] = cp;
+    commandPoolMap[key] = cp;
   }
   return cp;
 }
 
-Ptr<MemoryManager> DeviceContext::getMemoryManager() const {
-  return memoryManager;
+void DeviceContext::setConcurrentQueues(std::vector<int> const& queueIndices) {
+  concurrentQueues.clear();
+  for(auto q : queueIndices) {
+    if(q == DefaultQueue) q = mainQueueIndex;
+    if(q == MissingQueue) continue;
+    if(std::find(concurrentQueues.begin(), concurrentQueues.end(), uint32(q)) == concurrentQueues.end())
+      concurrentQueues.push_back(uint32(q));
+  }
+  // TransferBuffer uploads on the transfer queue
+  if(concurrentQueues.size() > 1 && transferQueueIndex != MissingQueue &&
+     std::find(concurrentQueues.begin(), concurrentQueues.end(), uint32(transferQueueIndex)) == concurrentQueues.end())
+    concurrentQueues.push_back(uint32(transferQueueIndex));
+  // a single family is exclusive anyway
+  if(concurrentQueues.size() < 2) concurrentQueues.clear();
 }
 
 Ptr<GraphicsPipeline> DeviceContext::loadFx(std::string const& fx) const {
@@ -228,31 +344,122 @@ void DeviceContext::wait() {
 
 bool DeviceContext::validation() const { return context->isValidationEnabled(); }
 
-void DeviceContext::submit(int queueIndex, std::vector<Ptr<CommandBuffer>> const& buffers, Ptr<Fence> const& fence,
-                           std::vector<vk::Semaphore> const& wait, std::vector<vk::Semaphore> const& signal,
-                           std::vector<vk::PipelineStageFlags> const& stages) {
-  assert(signal.size() == stages.size());
+// queue family in the high byte, timeline value below
+static uint64 makeTicket(int queueIndex, uint64 value) { return uint64(queueIndex + 1) << 56 | value; }
+static int ticketQueue(uint64 ticket) { return int(ticket >> 56) - 1; }
+static uint64 ticketValue(uint64 ticket) { return ticket & ((1ull << 56) - 1); }
+
+uint64 DeviceContext::submit(int queueIndex, std::vector<vk::CommandBuffer> const& buffers,
+                             std::vector<vk::Semaphore> const& wait, std::vector<vk::PipelineStageFlags> const& stages,
+                             std::vector<vk::Semaphore> const& signal, vk::Fence fence) {
+  nei_assert(wait.size() == stages.size());
+  if(queueIndex == DefaultQueue) queueIndex = mainQueueIndex;
+  auto queue = getQueue(queueIndex);
+  nei_assert(queue);
+
+  std::lock_guard lock(timelineMutex);
+  auto& timeline = timelines[queueIndex];
+  uint64 value = ++timeline.value;
+
+  // binary semaphores ignore their values
+  std::vector<vk::Semaphore> signals = signal;
+  std::vector<uint64> signalValues(signal.size(), 0);
+
+  vk::SubmitInfo si;
+  si.commandBufferCount = (uint32)buffers.size();
+  si.pCommandBuffers = buffers.data();
+  si.waitSemaphoreCount = (uint32)wait.size();
+  si.pWaitSemaphores = wait.data();
+  si.pWaitDstStageMask = stages.data();
+
+  vk::TimelineSemaphoreSubmitInfo tssi;
+  if(timelineSemaphores) {
+    if(!timeline.semaphore) {
+      vk::SemaphoreTypeCreateInfo stci;
+      stci.semaphoreType = vk::SemaphoreType::eTimeline;
+      vk::SemaphoreCreateInfo sci;
+      sci.pNext = &stci;
+      timeline.semaphore = device.createSemaphore(sci);
+    }
+    signals.push_back(timeline.semaphore);
+    signalValues.push_back(value);
+    tssi.signalSemaphoreValueCount = (uint32)signalValues.size();
+    tssi.pSignalSemaphoreValues = signalValues.data();
+    si.pNext = &tssi;
+  } else {
+    bool owned = !fence;
+    if(owned) fence = device.createFence(vk::FenceCreateInfo());
+    timeline.pending.push_back({value, fence, owned});
+  }
+  si.signalSemaphoreCount = (uint32)signals.size();
+  si.pSignalSemaphores = signals.data();
+
+  queue.submit({si}, fence);
+  return makeTicket(queueIndex, value);
+}
+
+uint64 DeviceContext::submit(int queueIndex, std::vector<Ptr<CommandBuffer>> const& buffers, Ptr<Fence> const& fence,
+                             std::vector<vk::Semaphore> const& wait, std::vector<vk::Semaphore> const& signal,
+                             std::vector<vk::PipelineStageFlags> const& stages) {
   thread_local std::vector<vk::CommandBuffer> vkBuffers;
   vkBuffers.clear();
   for(auto& b : buffers) {
-    if(b->isExecutable()) {
-      vkBuffers.push_back(*b);
-      b->setFence(fence);
+    if(b->isExecutable()) vkBuffers.push_back(*b);
+  }
+
+  auto ticket = submit(queueIndex, vkBuffers, wait, stages, signal, fence ? **fence : vk::Fence());
+  for(auto& b : buffers) {
+    if(b->isExecutable()) b->setTicket(ticket);
+  }
+  return ticket;
+}
+
+// fallback without timeline semaphores, drops fences up to value
+bool DeviceContext::retire(Timeline& timeline, uint64 value, bool block) {
+  while(timeline.finished < value && !timeline.pending.empty()) {
+    auto& p = timeline.pending.front();
+    if(block) {
+      auto res = device.waitForFences({p.fence}, true, UINT64_MAX);
+      nei_assert(res == vk::Result::eSuccess);
+    } else if(device.getFenceStatus(p.fence) != vk::Result::eSuccess) {
+      break;
     }
+    timeline.finished = p.value;
+    if(p.owned) device.destroyFence(p.fence);
+    timeline.pending.pop_front();
   }
+  return timeline.finished >= value;
+}
 
-  vk::SubmitInfo si;
-  si.commandBufferCount = (uint32)vkBuffers.size();
-  si.pCommandBuffers = vkBuffers.data();
-  si.waitSemaphoreCount = (uint32)wait.size();
-  si.pWaitSemaphores = wait.data();
-  si.pWaitDstStageMask = stages.data();
-  si.signalSemaphoreCount = (uint32)signal.size();
-  si.pSignalSemaphores = signal.data();
+void DeviceContext::wait(uint64 ticket) {
+  if(!ticket) return;
+  uint64 value = ticketValue(ticket);
 
-  auto queue = getQueue(queueIndex);
-  assert(queue);
-  queue.submit({si}, *fence);
+  std::unique_lock lock(timelineMutex);
+  auto& timeline = timelines[ticketQueue(ticket)];
+  if(!timelineSemaphores) {
+    retire(timeline, value, true);
+    return;
+  }
+  auto semaphore = timeline.semaphore;
+  lock.unlock();
+
+  vk::SemaphoreWaitInfo swi;
+  swi.semaphoreCount = 1;
+  swi.pSemaphores = &semaphore;
+  swi.pValues = &value;
+  auto res = device.waitSemaphoresKHR(swi, UINT64_MAX, dispatch);
+  nei_assert(res == vk::Result::eSuccess);
+}
+
+bool DeviceContext::isFinished(uint64 ticket) {
+  if(!ticket) return true;
+  uint64 value = ticketValue(ticket);
+
+  std::lock_guard lock(timelineMutex);
+  auto& timeline = timelines[ticketQueue(ticket)];
+  if(!timelineSemaphores) return retire(timeline, value, false);
+  return device.getSemaphoreCounterValueKHR(timeline.semaphore, dispatch) >= value;
 }
 
 CommandBuffer* DeviceContext::getSingleUseCommandBuffer() {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "NeiVuBase.h"
+#include <mutex>
 
 namespace Nei::Vu {
   enum class SamplerType;
@@ -22,33 +23,64 @@ namespace Nei::Vu {
 
     bool supportsExtension(std::string const& name) const ;
     bool supportsLayer(std::string const& name) const ;
+    bool isExtensionEnabled(std::string const& name) const;
+    bool supportsRayQuery() const;
+    bool supportsRaytracingPipeline() const;
+    // acceleration structures built by the cpu, see AccelerationStructure::buildHost
+    bool supportsHostBuilds() const { return hostBuilds; }
+    // khr trace rays with the launch size read from a buffer, see CommandBuffer::raytraceIndirect
+    bool supportsTraceRaysIndirect() const { return traceRaysIndirect; }
+    bool supportsDeviceAddress() const;
+    // VK_KHR_timeline_semaphore, tickets fall back to a fence per submission without it
+    bool supportsTimeline() const { return timelineSemaphores; }
+    // multi draw with firstInstance from indirect records, the draw count read by the gpu needs draw indirect count
+    bool supportsMultiDrawIndirect() const { return features.multiDrawIndirect && features.drawIndirectFirstInstance; }
+    bool supportsDrawIndirectCount() const;
     bool supportsImageFormat(vk::Format format, vk::FormatFeatureFlags usage);
     bool supportsDepthFormat(vk::Format format);
 
     Ptr<Context> const& getContext() const  { return context; }
     vk::Device getVkDevice() const  { return device; }
     vk::PhysicalDevice getVkPhysicalDevice() const  { return physicalDevice; }
+    uint32 getApiVersion() const { return apiVersion; }
 
     int getMainQueueIndex() const   { return mainQueueIndex; }
     int getTransferQueueIndex() const   { return transferQueueIndex; }
+    // dedicated compute family, MissingQueue if the device has none
+    int getComputeQueueIndex() const   { return computeQueueIndex; }
 
     vk::Queue getMainQueue() const  { return mainQueue; }
     vk::Queue getTransferQueue() const  { return transferQueue; }
+    vk::Queue getComputeQueue() const  { return computeQueue; }
 
     vk::Queue getPresentQueue() const  { return presentQueue; }
     vk::Queue getQueue(int index) const  ;
 
     vk::CommandPool getCommandPool(int queueIndex) ;
+
+    // buffers created afterwards use concurrent sharing between these queue families,
+    // resources used on several queues need no ownership transfers
+    void setConcurrentQueues(std::vector<int> const& queueIndices);
+    std::vector<uint32> const& getConcurrentQueues() const { return concurrentQueues; }
     vk::PipelineCache getPipelineCache() const  { return pipelineCache; }
 
-    Ptr<MemoryManager> getMemoryManager() const ;
+    Ptr<MemoryManager> const& getMemoryManager() const { return memoryManager; }
 
     vk::DispatchLoaderDynamic const& getDispatch()  { return dispatch; }
 
-    void submit(int queueIndex, std::vector<Ptr<CommandBuffer>> const& buffers, Ptr<Fence> const&fence = nullptr,
+    // Every submission returns a ticket, the value of the timeline semaphore of its queue.
+    // Waiting on a ticket blocks until that submission is done instead of draining the queue,
+    // tickets of one queue finish in order. Ticket 0 is always finished.
+    uint64 submit(int queueIndex, std::vector<vk::CommandBuffer> const& buffers,
+                  std::vector<vk::Semaphore> const& wait = {},
+                  std::vector<vk::PipelineStageFlags> const& stages = {},
+                  std::vector<vk::Semaphore> const& signal = {}, vk::Fence fence = nullptr);
+    uint64 submit(int queueIndex, std::vector<Ptr<CommandBuffer>> const& buffers, Ptr<Fence> const&fence = nullptr,
                 std::vector<vk::Semaphore> const& wait = {},
                 std::vector<vk::Semaphore> const& signal = {},
                 std::vector<vk::PipelineStageFlags> const& stages = {}) ;
+    void wait(uint64 ticket);
+    bool isFinished(uint64 ticket);
 
      CommandBuffer* getSingleUseCommandBuffer() ;
 
@@ -69,6 +101,12 @@ namespace Nei::Vu {
     Ptr<Context> context;
     vk::Device device;
     vk::PhysicalDevice physicalDevice;
+    uint32 apiVersion = 0;
+    std::set<std::string> extensions;
+    bool hostBuilds = false;
+    bool traceRaysIndirect = false;
+    bool timelineSemaphores = false;
+    vk::PhysicalDeviceFeatures features; // enabled core features
 
     Ptr<MemoryManager> memoryManager;
 
@@ -83,6 +121,26 @@ namespace Nei::Vu {
     int presentQueueIndex = MissingQueue;
 
     std::map<uint64, vk::CommandPool> commandPoolMap;
+    std::vector<uint32> concurrentQueues;
+
+    struct Pending {
+      uint64 value;
+      vk::Fence fence;
+      bool owned;
+    };
+
+    // submissions of one queue
+    struct Timeline {
+      vk::Semaphore semaphore;
+      uint64 value = 0;             // last submitted
+      uint64 finished = 0;          // fallback, last known finished
+      std::deque<Pending> pending;  // fallback, fences of unfinished submissions
+    };
+
+    bool retire(Timeline& timeline, uint64 value, bool block);
+
+    std::map<int, Timeline> timelines;
+    std::mutex timelineMutex;
     vk::PipelineCache pipelineCache;
 
     vk::DispatchLoaderDynamic dispatch;
@@ -10,4 +10,7 @@ namespace Nei::Vu {
     shadow
   };
 
+  // NV - VK_NV_ray_tracing, KHR - VK_KHR_acceleration_structure and VK_KHR_ray_tracing_pipeline
+  enum class RaytracingApi { NV, KHR };
+
 }
@@ -3,7 +3,7 @@
 #include "DeviceObject.h"
 
 namespace Nei::Vu{
-  class NEIVU_EXPORT Fence : public DeviceObject {
+  class NEIVU_EXPORT Fence : public DeviceObject, public Pooled<Fence> {
   public:
     Fence(DeviceContext* dc, bool signaled = false);
     virtual ~Fence();
@@ -97,6 +97,22 @@ Ptr<Pipeline> FxLoader::loadFxFile(fs::path const& fxFile) const {
   return loadFx(fx.str(), fxFile.filename().string());
 }
 
+void FxLoader::setDefine(std::string const& name, std::string const& value) {
+  if(value.empty()) defines.erase(name);
+  else defines[name] = value;
+}
+
+void FxLoader::setRaytracingApi(RaytracingApi api) {
+  raytracingApi = api;
+  setDefine("RT_KHR", api == RaytracingApi::KHR ? "1" : "");
+}
+
+std::string FxLoader::getDefines() const {
+  std::string ret;
+  for(auto& [name, value] : defines) ret += "#define " + name + " " + value + "\n";
+  return ret;
+}
+
 Ptr<ComputePipeline> FxLoader::parseCompute(std::string const& fx, std::string const& fxName) const {
   std::stringstream stream(fx);
   std::string line;
@@ -114,9 +130,11 @@ Ptr<ComputePipeline> FxLoader::parseCompute(std::string const& fx, std::string c
     lines++;
     if (line._Starts_with("#version")) {
       version = line;
+    } else if (parseLayout(line, pipeline)) {
     } else if (line == "#comp") {
       current = &comp;
       *current << version << "\n";
+      *current << getDefines();
       *current << shared.str();
     } else {
       *current << line << "\n";
@@ -152,6 +170,7 @@ Ptr<GraphicsPipeline> FxLoader::parseGraphics(std::string const& fx, std::string
     current = &src;
     src = std::stringstream();
     src << version << "\n";
+    src << getDefines();
     src << shared.str();
     stage = newStageFlag;
   };
@@ -160,7 +179,7 @@ Ptr<GraphicsPipeline> FxLoader::parseGraphics(std::string const& fx, std::string
     lines++;
     if (line._Starts_with("#version")) {
       version = line;
-    } else if (parsePipeline(line, pipeline)) { } else if (line == "#vert") {
+    } else if (parsePipeline(line, pipeline) || parseLayout(line, pipeline)) { } else if (line == "#vert") {
       newStage(vk::ShaderStageFlagBits::eVertex);
     } else if (line == "#tesc") {
       newStage(vk::ShaderStageFlagBits::eTessellationControl);
@@ -181,7 +200,7 @@ Ptr<GraphicsPipeline> FxLoader::parseGraphics(std::string const& fx, std::string
 }
 
 Ptr<RaytracingPipeline> FxLoader::parseRaytracing(std::string const& fx, std::string const& fxName) const {
-  Ptr pipeline = new RaytracingPipeline(deviceContext);
+  Ptr pipeline = new RaytracingPipeline(deviceContext, raytracingApi);
 
   std::stringstream stream(fx);
   std::string line;
@@ -218,6 +237,7 @@ Ptr<RaytracingPipeline> FxLoader::parseRaytracing(std::string const& fx, std::st
     current = &src;
     src = std::stringstream();
     src << version << "\n";
+    src << getDefines();
     src << shared.str();
     stage = newStageFlag;
   };
@@ -242,6 +262,7 @@ Ptr<RaytracingPipeline> FxLoader::parseRaytracing(std::string const& fx, std::st
     } else if (line._Starts_with("#depth")) {
       int d = parseInt(line.substr(7));
       pipeline->setRecursionDepth(d);
+    } else if (parseLayout(line, pipeline)) {
     } else if (line == "#rgen") {
       newStage(vk::ShaderStageFlagBits::eRaygenNV);
     } else if (line == "#rmiss") {
@@ -271,6 +292,20 @@ Ptr<RaytracingPipeline> FxLoader::parseRaytracing(std::string const& fx, std::st
   return pipeline;
 }
 
+// #dynamic set binding - uniform buffer bound with a dynamic offset, e.g. from UniformRing
+bool FxLoader::parseLayout(std::string const& line, Pipeline* pipe) const {
+  std::string tag;
+  int set = 0;
+  int binding = 0;
+
+  std::stringstream linestream(line);
+  linestream >> tag;
+  if(tag != "#dynamic") return false;
+  linestream >> set >> binding;
+  pipe->setDynamicUniform(set, binding);
+  return true;
+}
+
 bool FxLoader::parsePipeline(std::string const& line, GraphicsPipeline* pipe) const {
   std::string tag;
   std::string value;
@@ -13,11 +13,22 @@ namespace Nei::Vu {
     Ptr<Pipeline> loadFx(std::string const& fx, std::string const& fxName = "inlineFx") const;
     Ptr<Pipeline> loadFxFile(fs::path const& fxFile) const;
 
+    // #define inserted after #version in every stage of following loads, empty value removes it
+    void setDefine(std::string const& name, std::string const& value = "1");
+    // ray tracing pipelines are created with this api, KHR also defines RT_KHR
+    void setRaytracingApi(RaytracingApi api);
+
   protected:
+    std::string getDefines() const;
+
     Ptr<ComputePipeline> parseCompute(std::string const& fx, std::string const& fxName) const;
     Ptr<GraphicsPipeline> parseGraphics(std::string const& fx, std::string const& fxName) const;
     Ptr<RaytracingPipeline> parseRaytracing(std::string const& fx, std::string const& fxName) const;
 
     bool parsePipeline(std::string const& line, GraphicsPipeline* pipe) const;
+    bool parseLayout(std::string const& line, Pipeline* pipe) const;
+
+    std::map<std::string, std::string> defines;
+    RaytracingApi raytracingApi = RaytracingApi::NV;
   };
 };
@@ -26,12 +26,21 @@ void GBuffer::resize(uvec2 const& size) {
   }
 
   createRenderPass();
-  createFrameBuffer();
+  updateFramebuffer();
   createClearValues();
 
   version++;
 }
 
+void GBuffer::updateFramebuffer() {
+  framebuffer = nullptr;
+  for (auto& l : colorLayers)
+    if (!l.texture->isBound()) return;
+  if (depthLayer.texture && !depthLayer.texture->isBound()) return;
+
+  createFrameBuffer();
+}
+
 void GBuffer::addColorLayer(vk::Format format, std::string const& name, vk::ImageLayout layout) {
   GBufferLayer layer;
   layer.format = format;
@@ -47,12 +56,13 @@ void GBuffer::addColorLayer(vk::Format format, std::string const& name, vk::Imag
   colorLayers.push_back(layer);
 }
 
-void GBuffer::addDepthLayer(vk::Format format, std::string const& name, vk::ImageLayout layout) {
+void GBuffer::addDepthLayer(vk::Format format, std::string const& name, vk::ImageLayout layout, MemoryUsage memory) {
   depthLayer.format = format;
   depthLayer.name = name;
   depthLayer.finalLayout = layout;
   depthLayer.clear = vk::ClearDepthStencilValue({1, 0});
-  depthLayer.texture = new Texture2D(deviceContext, size, depthLayer.format, Texture::Usage::ShadowMap, false);
+  depthLayer.texture = new Texture2D(deviceContext, size, depthLayer.format, Texture::Usage::ShadowMap, false,
+                                      memory);
   if (!name.empty())depthLayer.texture->setName(name);
 }
 
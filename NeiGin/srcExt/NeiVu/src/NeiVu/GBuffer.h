@@ -1,6 +1,7 @@
 #pragma once
 
 #include "NeiVuBase.h"
+#include "MemoryManager.h"
 
 namespace Nei::Vu {
 
@@ -22,10 +23,13 @@ namespace Nei::Vu {
     void addColorLayer(vk::Format format, std::string const& name = "",
                        vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
     void addDepthLayer(vk::Format format = vk::Format::eD32SfloatS8Uint, std::string const& name = "GBuffer Depth",
-                       vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+                       vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal, MemoryUsage memory = GpuOnly);
+
+    // framebuffer needs memory bound to all layers, call after aliased layers were bound
+    void updateFramebuffer();
 
-    Ptr<Texture2D> getLayer(int i) { return colorLayers[i].texture; }
-    Ptr<Texture2D> getDepthLayer() { return depthLayer.texture; }
+    Ptr<Texture2D> const& getLayer(int i) const { return colorLayers[i].texture; }
+    Ptr<Texture2D> const& getDepthLayer() const { return depthLayer.texture; }
 
     auto& getRenderPass(bool clear = true) const { return clear ? renderPass : renderPassContinue; }
     auto& getFramebuffer() const { return framebuffer; }
@@ -8,7 +8,8 @@ namespace Nei::Vu {
     CpuOnly,
     ReadBack,
     Stream,
-    Default
+    Default,
+    Aliased // created without memory, bound into a shared range by TransientMemory
   };
 
   struct MemoryBlock : public Object {
@@ -26,6 +27,8 @@ namespace Nei::Vu {
 
     virtual Allocation allocate(vk::Image image, MemoryUsage usage = GpuOnly) = 0;
     virtual Allocation allocate(vk::Buffer buffer, MemoryUsage usage = GpuOnly) = 0;
+    // raw memory, resources are placed into it by the caller
+    virtual Allocation allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage = GpuOnly) = 0;
 
     virtual void free(Allocation const& allocation) = 0;
     virtual void* map(Allocation const& allocation) = 0;
@@ -33,8 +36,13 @@ namespace Nei::Vu {
 
     uint findMemoryType(uint memoryBits, vk::MemoryPropertyFlags requiredFlags);
 
+    uint64 getAllocatedSize() const { return allocatedSize; }
+    uint64 getPeakSize() const { return peakSize; }
+
   protected:
     vk::PhysicalDeviceMemoryProperties memoryProperties;
+    uint64 allocatedSize = 0;
+    uint64 peakSize = 0;
   };
 
 
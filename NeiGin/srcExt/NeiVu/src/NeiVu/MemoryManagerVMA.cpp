@@ -49,13 +49,7 @@ Allocation MemoryManagerVMA::allocate(vk::Image image, MemoryUsage usage) {
 
   deviceContext->getVkDevice().bindImageMemory(image, allocationInfo.deviceMemory, allocationInfo.offset);
 
-  Allocation allocation;
-  allocation.memory = allocationInfo.deviceMemory;
-  allocation.size = uint(allocationInfo.size);
-  allocation.offset = uint(allocationInfo.offset);
-
-  vma->allocationMap[allocation] = vmaAllocation;
-  return allocation;
+  return track(vmaAllocation, allocationInfo.deviceMemory, allocationInfo.offset, allocationInfo.size);
 }
 
 Allocation MemoryManagerVMA::allocate(vk::Buffer buffer, MemoryUsage usage) {
@@ -70,12 +64,31 @@ Allocation MemoryManagerVMA::allocate(vk::Buffer buffer, MemoryUsage usage) {
 
   deviceContext->getVkDevice().bindBufferMemory(buffer, allocationInfo.deviceMemory, allocationInfo.offset);
 
+  return track(vmaAllocation, allocationInfo.deviceMemory, allocationInfo.offset, allocationInfo.size);
+}
+
+Allocation MemoryManagerVMA::allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage) {
+  VmaAllocationCreateInfo aci = {};
+  aci.usage = memoryTypeToUsage(usage);
+  VmaAllocation vmaAllocation;
+  VmaAllocationInfo allocationInfo;
+  VkMemoryRequirements req = requirements;
+  auto res = vmaAllocateMemory(vma->allocator, &req, &aci, &vmaAllocation, &allocationInfo);
+  if (res != VK_SUCCESS)
+  nei_error("Allocation failed!");
+
+  return track(vmaAllocation, allocationInfo.deviceMemory, allocationInfo.offset, allocationInfo.size);
+}
+
+Allocation MemoryManagerVMA::track(void* vmaAllocation, vk::DeviceMemory memory, uint64 offset, uint64 size) {
   Allocation allocation;
-  allocation.memory = allocationInfo.deviceMemory;
-  allocation.size = uint(allocationInfo.size);
-  allocation.offset = uint(allocationInfo.offset);
+  allocation.memory = memory;
+  allocation.size = uint(size);
+  allocation.offset = uint(offset);
 
-  vma->allocationMap[allocation] = vmaAllocation;
+  vma->allocationMap[allocation] = VmaAllocation(vmaAllocation);
+  allocatedSize += size;
+  peakSize = glm::max(peakSize, allocatedSize);
   return allocation;
 }
 
@@ -83,6 +96,7 @@ void MemoryManagerVMA::free(Allocation const& allocation) {
   VmaAllocation vmaAllocation = vma->allocationMap[allocation];
   vmaFreeMemory(vma->allocator, vmaAllocation);
   vma->allocationMap.erase(allocation);
+  allocatedSize -= allocation.size;
 
 }
 
@@ -12,9 +12,14 @@ namespace Nei::Vu {
 
     Allocation allocate(vk::Image image, MemoryUsage usage) override;
     Allocation allocate(vk::Buffer buffer, MemoryUsage usage) override;
+    Allocation allocate(vk::MemoryRequirements const& requirements, MemoryUsage usage) override;
     void free(Allocation const& allocation) override;
     void* map(Allocation const& allocation) override;
     void unmap(Allocation const& allocation) override;
     Ptr<VMAData> vma;
+
+  protected:
+    // remembers the vma handle and counts the size
+    Allocation track(void* vmaAllocation, vk::DeviceMemory memory, uint64 offset, uint64 size);
   };
 }
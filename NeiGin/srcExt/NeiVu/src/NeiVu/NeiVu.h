@@ -23,4 +23,7 @@
 #include "AccelerationStructure.h"
 #include "VertexLayout.h"
 #include "UniformBuffer.h"
-#include "TransferBuffer.h"
\ No newline at end of file
+#include "UniformRing.h"
+#include "TransferBuffer.h"
+#include "RenderGraph.h"
+#include "TransientMemory.h"
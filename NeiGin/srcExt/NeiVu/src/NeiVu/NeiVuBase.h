@@ -36,6 +36,8 @@ namespace Nei::Vu {
   class MemoryManager;
   struct MemoryBlock;
   class GBuffer;
+  class TransientMemory;
+  class UniformRing;
   class Fence;
 };
 
@@ -5,6 +5,7 @@
 #include "DescriptorSetLayout.h"
 #include "DescriptorSet.h"
 #include "Shader.h"
+#include "UniformRing.h"
 
 using namespace Nei::Vu;
 
@@ -51,7 +52,14 @@ Nei::Ptr<DescriptorSetLayout> Pipeline::getOrCreateDescriptorSetLayout(int i) {
   return layouts[i];
 }
 
+void Pipeline::setDynamicUniform(int set, int binding) {
+  nei_assert(!pipelineLayout);
+  dynamicUniforms.emplace_back(set, binding);
+}
+
 void Pipeline::createLayout() {
+  for(auto& d : dynamicUniforms) getOrCreateDescriptorSetLayout(d.x)->setDynamic(d.y);
+
   std::vector<vk::DescriptorSetLayout> vkLayouts;
   for(auto &l:layouts) {
     if (!**l)l->create();
@@ -68,4 +76,13 @@ void Pipeline::createLayout() {
 
   pipelineLayout = device.createPipelineLayout(plci);
   assert(pipelineLayout);
-}
\ No newline at end of file
+}
+
+void Pipeline::bindDynamic(CommandBuffer* cmd, DescriptorSet* set, int setIndex, std::vector<uint32> const& offsets) {
+  (**cmd).bindDescriptorSets(getBindPoint(), pipelineLayout, setIndex, {*set}, offsets);
+}
+
+void Pipeline::setUniform(CommandBuffer* cmd, UniformRing* ring, DescriptorSet* set, int setIndex, void const* data,
+                          uint size) {
+  bindDynamic(cmd, set, setIndex, {ring->push(data, size)});
+}
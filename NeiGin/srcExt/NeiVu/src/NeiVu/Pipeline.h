@@ -26,8 +26,22 @@ namespace Nei::Vu {
 
     virtual vk::PipelineBindPoint getBindPoint() const =0;
 
+    // uniform buffer binding gets its offset when the set is bound, has to be set before createLayout
+    void setDynamicUniform(int set, int binding);
+
     void createLayout();
 
+    // binds a set with dynamic uniform bindings, offsets from UniformRing::push in binding order
+    void bindDynamic(CommandBuffer* cmd, DescriptorSet* set, int setIndex, std::vector<uint32> const& offsets);
+
+    // per draw data, written into the ring and bound at its offset. The set has one dynamic uniform binding
+    void setUniform(CommandBuffer* cmd, UniformRing* ring, DescriptorSet* set, int setIndex, void const* data, uint size);
+
+    template<typename T>
+    void setUniform(CommandBuffer* cmd, UniformRing* ring, DescriptorSet* set, int setIndex, T const& value) {
+      setUniform(cmd, ring, set, setIndex, &value, sizeof(T));
+    }
+
     template<typename T>
     void setConstants(CommandBuffer* cmd, T const& value, uint offset = 0, vk::ShaderStageFlags stage = vk::ShaderStageFlagBits::eVertex);
 
@@ -39,6 +53,7 @@ namespace Nei::Vu {
 
     std::vector<vk::PipelineShaderStageCreateInfo> stages;
     std::vector<vk::PushConstantRange> pushConstants;
+    std::vector<ivec2> dynamicUniforms; // set, binding
     vk::PipelineLayout pipelineLayout;
   };
 
@@ -8,7 +8,10 @@
 
 using namespace Nei::Vu;
 
-RaytracingPipeline::RaytracingPipeline(DeviceContext* deviceContext): Pipeline(deviceContext) {}
+RaytracingPipeline::RaytracingPipeline(DeviceContext* deviceContext, RaytracingApi api): Pipeline(deviceContext),
+  api(api) {
+  if(api == RaytracingApi::KHR) nei_assert(deviceContext->supportsRaytracingPipeline());
+}
 
 RaytracingPipeline::~RaytracingPipeline() {
   if(pipeline)
@@ -22,6 +25,34 @@ void RaytracingPipeline::bind(CommandBuffer* cmd) {
 void RaytracingPipeline::create() {
   if(!pipelineLayout)createLayout();
 
+  if(api == RaytracingApi::KHR) {
+    std::vector<vk::RayTracingShaderGroupCreateInfoKHR> groups;
+    for(auto& h : hitGroups) {
+      vk::RayTracingShaderGroupCreateInfoKHR group;
+      group.type = vk::RayTracingShaderGroupTypeKHR(h.type);
+      group.generalShader = h.generalShader;
+      group.closestHitShader = h.closestHitShader;
+      group.anyHitShader = h.anyHitShader;
+      group.intersectionShader = h.intersectionShader;
+      groups.push_back(group);
+    }
+
+    vk::RayTracingPipelineCreateInfoKHR rpci;
+    rpci.maxPipelineRayRecursionDepth = recursionDepth;
+    rpci.layout = pipelineLayout;
+    rpci.groupCount = (uint)groups.size();
+    rpci.pGroups = groups.data();
+    rpci.stageCount = (uint)stages.size();
+    rpci.pStages = stages.data();
+    rpci.basePipelineIndex = -1;
+
+    auto result = deviceContext->getVkDevice().createRayTracingPipelineKHR(nullptr, deviceContext->getPipelineCache(),
+      rpci, nullptr, deviceContext->getDispatch());
+    pipeline = result.value;
+    nei_assert(pipeline);
+    return;
+  }
+
   vk::RayTracingPipelineCreateInfoNV rpci;
   rpci.flags = {};
   rpci.maxRecursionDepth = recursionDepth;
@@ -90,8 +121,8 @@ void RaytracingPipeline::addHitShader(Shader* closest, Shader* any, Shader* inte
   hitGroups.push_back(group);
 }
 
-Nei::Ptr<ShaderBindingTable> RaytracingPipeline::createShaderBindingTable() {
+Nei::Ptr<ShaderBindingTable> RaytracingPipeline::createShaderBindingTable(MemoryUsage memory) {
   Ptr ret = new ShaderBindingTable(deviceContext);
-  ret->create(this);
+  ret->create(this, memory);
   return ret;
 }
@@ -1,11 +1,12 @@
 #pragma once
 
 #include "Pipeline.h"
+#include "MemoryManager.h"
 
 namespace Nei::Vu {
   class NEIVU_EXPORT RaytracingPipeline : public Pipeline {
   public:
-    RaytracingPipeline(DeviceContext* deviceContext);
+    RaytracingPipeline(DeviceContext* deviceContext, RaytracingApi api = RaytracingApi::NV);
     virtual ~RaytracingPipeline();
 
     void bind(CommandBuffer* cmd) override;
@@ -16,9 +17,11 @@ namespace Nei::Vu {
     void addHitShader(Shader* closest, Shader* any, Shader* intersection);
     void addCallableShader(Shader* shader){};
 
+    // groups are described with NV structures for both apis
     auto &getHitGroups() const { return hitGroups; }
+    RaytracingApi getApi() const { return api; }
 
-    Ptr<ShaderBindingTable> createShaderBindingTable();
+    Ptr<ShaderBindingTable> createShaderBindingTable(MemoryUsage memory = GpuOnly);
 
     void setRecursionDepth(int d){recursionDepth=d;}
     
@@ -27,6 +30,7 @@ namespace Nei::Vu {
     operator vk::Pipeline() const { return pipeline; }
     vk::Pipeline operator*() const { return pipeline; }
   protected:
+    RaytracingApi api;
     vk::Pipeline pipeline;
     std::vector<vk::RayTracingShaderGroupCreateInfoNV> hitGroups;
 
@@ -0,0 +1,326 @@
+#include "RenderGraph.h"
+
+#include "CommandBuffer.h"
+#include "Texture.h"
+#include "Buffer.h"
+#include "AccelerationStructure.h"
+
+using namespace Nei;
+using namespace Vu;
+
+namespace {
+  const vk::AccessFlags writeAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+    vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite |
+    vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite |
+    vk::AccessFlagBits::eAccelerationStructureWriteKHR;
+}
+
+RenderGraph::Pass::Usage RenderGraph::Pass::describe(Access access) {
+  using Stage = vk::PipelineStageFlagBits;
+  using A = vk::AccessFlagBits;
+
+  Usage u;
+  switch(access) {
+    case Access::ComputeRead:
+      u.stages = Stage::eComputeShader;
+      u.access = A::eShaderRead;
+      u.layout = vk::ImageLayout::eGeneral;
+      break;
+    case Access::ComputeWrite:
+      u.stages = Stage::eComputeShader;
+      u.access = A::eShaderRead | A::eShaderWrite;
+      u.layout = vk::ImageLayout::eGeneral;
+      u.write = true;
+      break;
+    case Access::RaytracingRead:
+      u.stages = Stage::eRayTracingShaderNV;
+      u.access = A::eShaderRead;
+      u.layout = vk::ImageLayout::eGeneral;
+      break;
+    case Access::RaytracingWrite:
+      u.stages = Stage::eRayTracingShaderNV;
+      u.access = A::eShaderRead | A::eShaderWrite;
+      u.layout = vk::ImageLayout::eGeneral;
+      u.write = true;
+      break;
+    case Access::VertexRead:
+      u.stages = Stage::eVertexShader;
+      u.access = A::eShaderRead;
+      break;
+    case Access::UniformRead:
+      u.stages = Stage::eComputeShader | Stage::eRayTracingShaderNV;
+      u.access = A::eUniformRead;
+      break;
+    case Access::IndirectRead:
+      u.stages = Stage::eDrawIndirect;
+      u.access = A::eIndirectCommandRead;
+      break;
+    case Access::TransferRead:
+      u.stages = Stage::eTransfer;
+      u.access = A::eTransferRead;
+      u.layout = vk::ImageLayout::eTransferSrcOptimal;
+      break;
+    case Access::TransferWrite:
+      u.stages = Stage::eTransfer;
+      u.access = A::eTransferWrite;
+      u.layout = vk::ImageLayout::eTransferDstOptimal;
+      u.write = true;
+      break;
+    case Access::ColorAttachment:
+      u.stages = Stage::eColorAttachmentOutput;
+      u.access = A::eColorAttachmentRead | A::eColorAttachmentWrite;
+      u.write = true;
+      u.renderPass = true;
+      break;
+    case Access::DepthAttachment:
+      u.stages = Stage::eEarlyFragmentTests | Stage::eLateFragmentTests;
+      u.access = A::eDepthStencilAttachmentRead | A::eDepthStencilAttachmentWrite;
+      u.write = true;
+      u.renderPass = true;
+      break;
+    case Access::AccelerationStructureBuild:
+      u.stages = Stage::eAccelerationStructureBuildKHR;
+      u.access = A::eAccelerationStructureReadKHR | A::eAccelerationStructureWriteKHR;
+      u.write = true;
+      break;
+  }
+  return u;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::use(Texture* texture, Access access, vk::ImageLayout attachmentLayout) {
+  auto u = describe(access);
+  u.resource = graph->getResource(texture);
+  graph->resources[u.resource].texture = texture;
+  // render pass leaves the attachment in its final layout
+  if(u.renderPass) u.layout = attachmentLayout;
+  addUsage(u);
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::use(Buffer* buffer, Access access) {
+  auto u = describe(access);
+  u.resource = graph->getResource(buffer);
+  u.layout = vk::ImageLayout::eUndefined;
+  addUsage(u);
+  return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::use(AccelerationStructure* structure, Access access) {
+  auto u = describe(access);
+  u.resource = graph->getResource(structure);
+  graph->resources[u.resource].structure = true;
+  u.layout = vk::ImageLayout::eUndefined;
+  if(u.access & vk::AccessFlagBits::eShaderRead)
+    u.access = vk::AccessFlagBits::eAccelerationStructureReadKHR;
+  addUsage(u);
+  return *this;
+}
+
+// multiple uses of one resource in a pass are merged, nothing orders them against each other.
+// a write in one stage and a use in another, like a transfer clear before a dispatch, need their own passes
+void RenderGraph::Pass::addUsage(Usage const& usage) {
+  nei_assert(!graph->compiled);
+  for(auto& u : usages) {
+    if(u.resource != usage.resource) continue;
+    nei_assert(!graph->resources[u.resource].texture || u.layout == usage.layout);
+    nei_assertm(!(u.write || usage.write) || u.stages == usage.stages,
+      "RenderGraph pass writes a resource in several stages, split it into passes");
+    u.stages |= usage.stages;
+    u.access |= usage.access;
+    u.write |= usage.write;
+    u.renderPass |= usage.renderPass;
+    return;
+  }
+  usages.push_back(usage);
+}
+
+RenderGraph::RenderGraph(DeviceContext* dc): DeviceObject(dc) { }
+
+RenderGraph::~RenderGraph() { }
+
+RenderGraph::Pass& RenderGraph::addPass(std::string const& name, std::function<void(CommandBuffer*)> const& record) {
+  nei_assert(!compiled);
+  auto& pass = passes.emplace_back();
+  pass.graph = this;
+  pass.name = name;
+  pass.record = record;
+  return pass;
+}
+
+void RenderGraph::setTransient(Texture* texture) {
+  auto index = getResource(texture);
+  resources[index].texture = texture;
+  resources[index].transient = true;
+}
+
+void RenderGraph::addAlias(void* a, void* b) {
+  nei_assert(!compiled);
+  auto ia = getResource(a);
+  auto ib = getResource(b);
+  resources[ia].aliases.push_back(ib);
+  resources[ib].aliases.push_back(ia);
+}
+
+void RenderGraph::compile() {
+  for(int i = 0; i < resources.size(); i++)
+    resources[i].lifetime = computeLifetime(i);
+
+  std::vector<State> states(resources.size());
+  firstBarriers = simulate(states);
+
+  // next frame continues from the end state, transient content is discarded
+  for(int i = 0; i < resources.size(); i++) {
+    if(resources[i].transient) states[i].layout = vk::ImageLayout::eUndefined;
+  }
+  steadyBarriers = simulate(states);
+
+  int images = 0;
+  int memory = 0;
+  for(auto& b : steadyBarriers) {
+    images += int(b.images.size());
+    memory += b.memory.srcAccessMask || b.memory.dstAccessMask ? 1 : 0;
+  }
+  nei_log("RenderGraph {} passes, {} resources, {} barriers per frame ({} image, {} memory)", passes.size(),
+    resources.size(), getBarrierCount(), images, memory);
+
+  compiled = true;
+}
+
+void RenderGraph::execute(CommandBuffer* cmd) {
+  nei_assert(compiled);
+  auto& batches = firstFrame ? firstBarriers : steadyBarriers;
+
+  for(int i = 0; i < passes.size(); i++) {
+    if(fullBarriers && !passes[i].usages.empty()) {
+      Batch full;
+      full.srcStages = vk::PipelineStageFlagBits::eAllCommands;
+      full.dstStages = vk::PipelineStageFlagBits::eAllCommands;
+      full.memory.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+      full.memory.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+      full.images = batches[i].images;
+      record(cmd, full);
+    } else if(!batches[i].empty()) {
+      record(cmd, batches[i]);
+    }
+    passes[i].record(cmd);
+  }
+
+  firstFrame = false;
+}
+
+int RenderGraph::getBarrierCount() const {
+  int count = 0;
+  for(int i = 0; i < passes.size(); i++) {
+    if(fullBarriers) count += passes[i].usages.empty() ? 0 : 1;
+    else count += steadyBarriers[i].empty() ? 0 : 1;
+  }
+  return count;
+}
+
+ivec2 RenderGraph::getLifetime(void* resource) const {
+  auto it = resourceMap.find(resource);
+  if(it == resourceMap.end()) return {-1, -1};
+  return computeLifetime(it->second);
+}
+
+ivec2 RenderGraph::computeLifetime(int resource) const {
+  ivec2 lifetime = {-1, -1};
+  for(int i = 0; i < passes.size(); i++) {
+    for(auto& u : passes[i].usages) {
+      if(u.resource != resource) continue;
+      if(lifetime.x < 0) lifetime.x = i;
+      lifetime.y = i;
+    }
+  }
+  return lifetime;
+}
+
+int RenderGraph::getResource(void* handle) {
+  auto it = resourceMap.find(handle);
+  if(it != resourceMap.end()) return it->second;
+
+  Resource resource;
+  resource.handle = handle;
+  resources.push_back(resource);
+  resourceMap[handle] = int(resources.size()) - 1;
+  return int(resources.size()) - 1;
+}
+
+std::vector<RenderGraph::Batch> RenderGraph::simulate(std::vector<State>& states) {
+  std::vector<Batch> batches(passes.size());
+
+  for(int p = 0; p < passes.size(); p++) {
+    auto& batch = batches[p];
+    for(auto& u : passes[p].usages) {
+      auto& r = resources[u.resource];
+      auto& s = states[u.resource];
+      bool transition = r.texture && !u.renderPass && u.layout != s.layout;
+
+      // memory was used by an aliased resource since the last frame, its work has to finish first
+      if(p == r.lifetime.x) {
+        for(auto a : r.aliases) {
+          auto& as = states[a];
+          auto src = as.writeStages | as.readStages;
+          if(!src) continue;
+          batch.memory.srcAccessMask |= as.writeAccess;
+          batch.memory.dstAccessMask |= u.access;
+          batch.srcStages |= src;
+          batch.dstStages |= u.stages;
+        }
+      }
+
+      if(u.write || transition) {
+        // write after write or read, previous readers have to finish
+        auto src = s.writeStages | s.readStages;
+        if(transition) {
+          vk::ImageMemoryBarrier imb;
+          imb.oldLayout = s.layout;
+          imb.newLayout = u.layout;
+          imb.srcAccessMask = s.writeAccess;
+          imb.dstAccessMask = u.access;
+          imb.image = r.texture->getImage();
+          imb.subresourceRange = r.texture->getFullRange();
+          batch.images.push_back(imb);
+          batch.srcStages |= src ? src : vk::PipelineStageFlagBits::eTopOfPipe;
+          batch.dstStages |= u.stages;
+        } else if(src) {
+          batch.memory.srcAccessMask |= s.writeAccess;
+          batch.memory.dstAccessMask |= u.access;
+          batch.srcStages |= src;
+          batch.dstStages |= u.stages;
+        }
+
+        // layout transition counts as write, later readers are ordered after it. A new write is visible to
+        // nobody yet, even to the stage which wrote it, only a transition for a reader makes it visible to that reader
+        s.writeStages = u.stages;
+        s.writeAccess = u.access & writeAccessMask;
+        s.readStages = {};
+        s.visibleStages = u.write ? vk::PipelineStageFlags() : u.stages;
+        s.visibleAccess = u.write ? vk::AccessFlags() : u.access;
+      } else {
+        // read after write, skipped when the stage already sees the write
+        bool visible = !(u.stages & ~s.visibleStages) && !(u.access & ~s.visibleAccess);
+        if(s.writeStages && !visible) {
+          batch.memory.srcAccessMask |= s.writeAccess;
+          batch.memory.dstAccessMask |= u.access;
+          batch.srcStages |= s.writeStages;
+          batch.dstStages |= u.stages;
+          s.visibleStages |= u.stages;
+          s.visibleAccess |= u.access;
+        }
+        s.readStages |= u.stages;
+      }
+
+      if(r.texture) s.layout = u.layout;
+    }
+  }
+
+  return batches;
+}
+
+void RenderGraph::record(CommandBuffer* cmd, Batch const& batch) {
+  bool memory = batch.memory.srcAccessMask || batch.memory.dstAccessMask;
+  (**cmd).pipelineBarrier(batch.srcStages, batch.dstStages, vk::DependencyFlags(),
+    memory ? 1 : 0, memory ? &batch.memory : nullptr, 0, nullptr,
+    uint32(batch.images.size()), batch.images.data());
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "DeviceObject.h"
+
+namespace Nei::Vu {
+  // Passes declare how they use images, buffers and acceleration structures.
+  // Barriers are derived once in compile and replayed every frame, all barriers
+  // in front of a pass are batched into a single pipeline barrier.
+  class NEIVU_EXPORT RenderGraph : public DeviceObject {
+  public:
+    enum class Access {
+      ComputeRead,
+      ComputeWrite,    // storage read/write
+      RaytracingRead,
+      RaytracingWrite,
+      VertexRead,      // storage read in vertex shaders
+      UniformRead,
+      IndirectRead,
+      TransferRead,
+      TransferWrite,
+      ColorAttachment, // layout is changed by the render pass
+      DepthAttachment,
+      AccelerationStructureBuild,
+    };
+
+    // one pipeline barrier in front of a pass
+    struct Batch {
+      vk::PipelineStageFlags srcStages;
+      vk::PipelineStageFlags dstStages;
+      vk::MemoryBarrier memory;
+      std::vector<vk::ImageMemoryBarrier> images;
+      bool empty() const { return !srcStages; }
+    };
+
+    class NEIVU_EXPORT Pass {
+    public:
+      Pass& use(Texture* texture, Access access, vk::ImageLayout attachmentLayout = vk::ImageLayout::eGeneral);
+      Pass& use(Buffer* buffer, Access access);
+      Pass& use(AccelerationStructure* structure, Access access);
+
+    protected:
+      friend class RenderGraph;
+
+      struct Usage {
+        int resource = -1;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        bool write = false;
+        bool renderPass = false;
+      };
+
+      static Usage describe(Access access);
+      void addUsage(Usage const& usage);
+
+      RenderGraph* graph = nullptr;
+      std::string name;
+      std::function<void(CommandBuffer*)> record;
+      std::vector<Usage> usages;
+    };
+
+    RenderGraph(DeviceContext* dc);
+    virtual ~RenderGraph();
+
+    Pass& addPass(std::string const& name, std::function<void(CommandBuffer*)> const& record);
+
+    // content is not needed in the next frame, first use discards it
+    void setTransient(Texture* texture);
+
+    // every pass using resources waits for all previous work, for comparison with derived barriers
+    void setFullBarriers(bool full) { fullBarriers = full; }
+
+    void compile();
+    void execute(CommandBuffer* cmd);
+
+    // steady state, pipeline barriers per frame
+    int getBarrierCount() const;
+    // steady state, a barrier is recorded in front of the pass
+    bool hasBarrier(int pass) const { return !steadyBarriers[pass].empty(); }
+    // barrier in front of the pass in the first frame or in the steady state
+    Batch const& getBarrier(int pass, bool steady = true) const {
+      return steady ? steadyBarriers[pass] : firstBarriers[pass];
+    }
+
+    // barriers no longer start from the initial layouts, a recorded frame can be replayed
+    bool isSteady() const { return compiled && !firstFrame; }
+
+    // resources sharing memory, first use of one waits for all previous uses of the other
+    void addAlias(void* a, void* b);
+
+    // first and last pass using the resource, -1 if unused, valid before compile
+    ivec2 getLifetime(void* resource) const;
+
+  protected:
+    struct Resource {
+      void* handle = nullptr;
+      Texture* texture = nullptr;
+      bool structure = false;
+      bool transient = false;
+      ivec2 lifetime = {-1, -1};
+      std::vector<int> aliases;
+    };
+
+    struct State {
+      vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+      vk::PipelineStageFlags writeStages;
+      vk::AccessFlags writeAccess;
+      vk::PipelineStageFlags readStages;
+      // stages and accesses which already see the last write
+      vk::PipelineStageFlags visibleStages;
+      vk::AccessFlags visibleAccess;
+    };
+
+    int getResource(void* handle);
+    ivec2 computeLifetime(int resource) const;
+    std::vector<Batch> simulate(std::vector<State>& states);
+    void record(CommandBuffer* cmd, Batch const& batch);
+
+    bool fullBarriers = false;
+    bool compiled = false;
+    bool firstFrame = true;
+    std::deque<Pass> passes;
+    std::vector<Resource> resources;
+    std::map<void*, int> resourceMap;
+
+    std::vector<Batch> firstBarriers;  // from initial layouts
+    std::vector<Batch> steadyBarriers; // from the end state of previous frame
+  };
+};
@@ -91,11 +91,10 @@ void RenderPass::begin(CommandBuffer* cmd, Framebuffer* framebuffer, std::vector
 }
 
 void RenderPass::end() {
-  auto cmd = scopeCommandBuffer;
+  auto cmd = std::move(scopeCommandBuffer);
   (**cmd).endRenderPass();
   cmd->setCurrentFramebuffer(nullptr);
   cmd->setCurrentRenderPass(nullptr);
-  scopeCommandBuffer = nullptr;
 }
 
 void RenderPass::setName(std::string const& name) {
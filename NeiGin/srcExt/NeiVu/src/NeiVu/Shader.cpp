@@ -129,6 +129,9 @@ bool Shader::fromString(std::string const& src, vk::ShaderStageFlagBits stage, s
   shaderc::Compiler compiler;
   shaderc::CompileOptions opt;
   //opt.SetOptimizationLevel(shaderc_optimization_level_performance);
+  // ray queries need spirv 1.4+
+  if(deviceContext->getApiVersion() >= VK_MAKE_VERSION(1, 2, 0))
+    opt.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
 
   auto res = compiler.CompileGlslToSpv(src, kind, name.c_str(), opt);
 
@@ -259,13 +262,19 @@ void Shader::addResourcesToPipeline(Pipeline* pipeline) {
     deset->addDescriptor(binding, vk::DescriptorType::eStorageImage, stage, count);
   }
 
+  // NV ray tracing shaders use NV structures, ray queries require KHR
+  auto const& capabilities = glsl.get_declared_capabilities();
+  bool nvRaytracing = std::find(capabilities.begin(), capabilities.end(), spv::CapabilityRayTracingNV) != capabilities.
+    end();
+  auto asType = nvRaytracing ? vk::DescriptorType::eAccelerationStructureNV : vk::DescriptorType::eAccelerationStructureKHR;
+
   for(auto& u : resources.acceleration_structures) {
     auto type = glsl.get_type(u.type_id);
     auto set = glsl.get_decoration(u.id, spv::Decoration::DecorationDescriptorSet);
     auto binding = glsl.get_decoration(u.id, spv::Decoration::DecorationBinding);
     auto count = type.array.empty() ? 1 : type.array[0];
     auto deset = pipeline->getOrCreateDescriptorSetLayout(set);
-    deset->addDescriptor(binding, vk::DescriptorType::eAccelerationStructureNV, stage, count);
+    deset->addDescriptor(binding, asType, stage, count);
   }
 
   for(auto& u : resources.storage_buffers) {
@@ -11,65 +11,139 @@ ShaderBindingTable::ShaderBindingTable(DeviceContext* dc): DeviceObject(dc) { }
 
 ShaderBindingTable::~ShaderBindingTable() {}
 
-void ShaderBindingTable::create(RaytracingPipeline* pipeline) {
+void ShaderBindingTable::create(RaytracingPipeline* pipeline, MemoryUsage memory) {
+  this->pipeline = pipeline;
+  this->memory = memory;
+  api = pipeline->getApi();
+  build();
+}
+
+void ShaderBindingTable::setRecordData(int group, void const* data, uint size) {
+  auto bytes = (uint8 const*)data;
+  recordData[group].assign(bytes, bytes + size);
+  if(!pipeline) return;
+  // command buffers in flight still reference the old table
+  if(buffer) retired.push_back({std::move(buffer), framesInFlight});
+  build();
+}
+
+void ShaderBindingTable::nextFrame() {
+  for(auto& r : retired) r.frames--;
+  while(!retired.empty() && retired.front().frames <= 0) retired.erase(retired.begin());
+}
+
+// every region starts at the base alignment, record strides are aligned to the handle alignment
+// (NV requires multiples of the handle size)
+void ShaderBindingTable::build() {
   auto device = deviceContext->getVkDevice();
   auto physicalDevice = deviceContext->getVkPhysicalDevice();
 
-  vk::PhysicalDeviceRayTracingPropertiesNV rtxProps;
-  vk::PhysicalDeviceProperties2 props;
-  props.pNext = &rtxProps;
-  physicalDevice.getProperties2(&props);
-
-  auto handleSize = rtxProps.shaderGroupHandleSize;
-
-
-  auto hitGroups = pipeline->getHitGroups();
-
-  auto size = uint(handleSize * hitGroups.size());
-  std::vector<uint8> handles(size);
-  device.getRayTracingShaderGroupHandlesNV(*pipeline, 0, uint(hitGroups.size()), size,handles.data(), deviceContext->getDispatch());
-
-  auto shaders = pipeline->getShaders();
-
-  buffer = new Buffer(deviceContext, size, Buffer::Type::Staging);
-
-
-  
-  uint offset = 0;
-  auto ptr =(uint8*) buffer->map();
-  rayGenOffset = offset;
-  rayGenBuffer = *buffer;
-  for (int i = 0; i < hitGroups.size();i++) {
-    auto &h = hitGroups[i];
-    if (h.generalShader != VK_SHADER_UNUSED_NV && shaders[h.generalShader]->getStage() == vk::ShaderStageFlagBits::eRaygenNV) {
-      memcpy(ptr+offset, handles.data()+i*handleSize, handleSize);
-      offset += handleSize;
-    }
+  vk::DeviceSize handleSize, handleAlignment, baseAlignment;
+  if(api == RaytracingApi::KHR) {
+    vk::PhysicalDeviceRayTracingPipelinePropertiesKHR rtxProps;
+    vk::PhysicalDeviceProperties2 props;
+    props.pNext = &rtxProps;
+    physicalDevice.getProperties2(&props);
+    handleSize = rtxProps.shaderGroupHandleSize;
+    handleAlignment = rtxProps.shaderGroupHandleAlignment;
+    baseAlignment = rtxProps.shaderGroupBaseAlignment;
+  } else {
+    vk::PhysicalDeviceRayTracingPropertiesNV rtxProps;
+    vk::PhysicalDeviceProperties2 props;
+    props.pNext = &rtxProps;
+    physicalDevice.getProperties2(&props);
+    handleSize = rtxProps.shaderGroupHandleSize;
+    handleAlignment = rtxProps.shaderGroupHandleSize;
+    baseAlignment = rtxProps.shaderGroupBaseAlignment;
   }
 
-  missOffset = offset;
-  missStride = handleSize;
-  for (int i = 0; i < hitGroups.size(); i++) {
-    auto &h = hitGroups[i];
-    if (h.type == vk::RayTracingShaderGroupTypeNV::eGeneral && shaders[h.generalShader]->getStage() == vk::ShaderStageFlagBits::eMissNV) {
-      memcpy(ptr + offset, handles.data() + i * handleSize, handleSize);
-      offset += handleSize;
-      missBuffer = *buffer;
-    }
+  auto align = [](vk::DeviceSize size, vk::DeviceSize alignment) { return (size + alignment - 1) / alignment * alignment; };
+
+  auto& hitGroups = pipeline->getHitGroups();
+  auto& shaders = pipeline->getShaders();
+
+  auto groupCount = uint(hitGroups.size());
+  std::vector<uint8> handles(handleSize * groupCount);
+  if(api == RaytracingApi::KHR)
+    device.getRayTracingShaderGroupHandlesKHR(*pipeline, 0, groupCount, handles.size(), handles.data(),
+      deviceContext->getDispatch());
+  else
+    device.getRayTracingShaderGroupHandlesNV(*pipeline, 0, groupCount, handles.size(), handles.data(),
+      deviceContext->getDispatch());
+
+  std::vector<int> rayGen, miss, hit, callable;
+  for(int i = 0; i < hitGroups.size(); i++) {
+    auto& h = hitGroups[i];
+    if(h.type != vk::RayTracingShaderGroupTypeNV::eGeneral) hit.push_back(i);
+    else if(shaders[h.generalShader]->getStage() == vk::ShaderStageFlagBits::eRaygenNV) rayGen.push_back(i);
+    else if(shaders[h.generalShader]->getStage() == vk::ShaderStageFlagBits::eMissNV) miss.push_back(i);
+    else if(shaders[h.generalShader]->getStage() == vk::ShaderStageFlagBits::eCallableNV) callable.push_back(i);
   }
+  nei_assert(rayGen.size() == 1);
 
-  hitOffset = offset;
-  hitStride = handleSize;
-  for (int i = 0; i < hitGroups.size(); i++) {
-    auto &h = hitGroups[i];
-    if (h.type == vk::RayTracingShaderGroupTypeNV::eTrianglesHitGroup) {
-      memcpy(ptr + offset, handles.data() + i * handleSize, handleSize);
-      offset += handleSize;
-      hitBuffer = *buffer;
+  auto stride = [&](std::vector<int> const& groups) {
+    vk::DeviceSize record = handleSize;
+    for(auto g : groups) {
+      auto it = recordData.find(g);
+      if(it != recordData.end()) record = std::max(record, handleSize + it->second.size());
     }
-  }
+    return align(record, handleAlignment);
+  };
+
+  // ray gen region holds a single record, for KHR its stride has to match the size
+  rayGenRegion.stride = align(stride(rayGen), baseAlignment);
+  rayGenRegion.size = rayGenRegion.stride;
+  missRegion.stride = stride(miss);
+  missRegion.size = align(miss.size() * missRegion.stride, baseAlignment);
+  hitRegion.stride = stride(hit);
+  hitRegion.size = align(hit.size() * hitRegion.stride, baseAlignment);
+  callableRegion.stride = stride(callable);
+  callableRegion.size = align(callable.size() * callableRegion.stride, baseAlignment);
+
+  rayGenOffset = 0;
+  missOffset = rayGenOffset + rayGenRegion.size;
+  hitOffset = missOffset + missRegion.size;
+  callableOffset = hitOffset + hitRegion.size;
+  auto size = callableOffset + callableRegion.size;
+
+  std::vector<uint8> table(size, 0);
+  auto write = [&](std::vector<int> const& groups, vk::DeviceSize offset, vk::DeviceSize stride) {
+    for(auto g : groups) {
+      memcpy(table.data() + offset, handles.data() + g * handleSize, handleSize);
+      auto it = recordData.find(g);
+      if(it != recordData.end()) memcpy(table.data() + offset + handleSize, it->second.data(), it->second.size());
+      offset += stride;
+    }
+  };
+  write(rayGen, rayGenOffset, rayGenRegion.stride);
+  write(miss, missOffset, missRegion.stride);
+  write(hit, hitOffset, hitRegion.stride);
+  write(callable, callableOffset, callableRegion.stride);
 
-  buffer->unmap();
+  // traced every frame, device local unless asked otherwise
+  buffer = new Buffer(deviceContext, uint(size), Buffer::Type::BindingTable, memory);
+  buffer->setName("ShaderBindingTable");
+  buffer->setData(table.data(), uint(size));
 
+  rayGenBuffer = *buffer;
+  missBuffer = miss.empty() ? vk::Buffer() : *buffer;
+  missStride = missRegion.stride;
+  hitBuffer = hit.empty() ? vk::Buffer() : *buffer;
+  hitStride = hitRegion.stride;
+  callableBuffer = callable.empty() ? vk::Buffer() : *buffer;
+  callableStride = callableRegion.stride;
+
+  if(api != RaytracingApi::KHR) {
+    rayGenRegion = missRegion = hitRegion = callableRegion = vk::StridedDeviceAddressRegionKHR();
+    return;
+  }
 
-}
\ No newline at end of file
+  auto address = buffer->getDeviceAddress();
+  rayGenRegion.deviceAddress = address + rayGenOffset;
+  missRegion.deviceAddress = address + missOffset;
+  hitRegion.deviceAddress = address + hitOffset;
+  callableRegion.deviceAddress = address + callableOffset;
+  if(miss.empty()) missRegion = vk::StridedDeviceAddressRegionKHR();
+  if(hit.empty()) hitRegion = vk::StridedDeviceAddressRegionKHR();
+  if(callable.empty()) callableRegion = vk::StridedDeviceAddressRegionKHR();
+}
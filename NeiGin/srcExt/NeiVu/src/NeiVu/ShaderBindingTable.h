@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DeviceObject.h"
+#include "MemoryManager.h"
 
 namespace Nei::Vu {
   class NEIVU_EXPORT ShaderBindingTable : public DeviceObject {
@@ -8,7 +9,19 @@ namespace Nei::Vu {
     ShaderBindingTable(DeviceContext* dc);
     virtual ~ShaderBindingTable();
 
-    void create(RaytracingPipeline* pipeline);
+    // the table is uploaded through a staging copy, CpuOnly keeps it in host memory
+    void create(RaytracingPipeline* pipeline, MemoryUsage memory = GpuOnly);
+
+    // shader record data after the handle of the group, readable with shaderRecordNV/EXT.
+    // all records of a region get the stride of the largest one, the table is rebuilt if created.
+    // the replaced table stays alive for the frames in flight, see nextFrame
+    void setRecordData(int group, void const* data, uint size);
+
+    void setFramesInFlight(int frames) { framesInFlight = frames; }
+    // once per frame, releases replaced tables no frame in flight can use anymore
+    void nextFrame();
+
+    RaytracingApi getApi() const { return api; }
 
     vk::Buffer getRayGenBuffer() const { return rayGenBuffer; }
     vk::DeviceSize getRayGenOffset() const { return rayGenOffset; }
@@ -21,9 +34,28 @@ namespace Nei::Vu {
     vk::Buffer getCallableBuffer() const { return callableBuffer; }
     vk::DeviceSize getCallableOffset() const { return callableOffset; }
     vk::DeviceSize getCallableStride() const { return callableStride; }
+
+    // KHR regions, empty for NV
+    vk::StridedDeviceAddressRegionKHR const& getRayGenRegion() const { return rayGenRegion; }
+    vk::StridedDeviceAddressRegionKHR const& getMissRegion() const { return missRegion; }
+    vk::StridedDeviceAddressRegionKHR const& getHitRegion() const { return hitRegion; }
+    vk::StridedDeviceAddressRegionKHR const& getCallableRegion() const { return callableRegion; }
   protected:
+    void build();
+
+    RaytracingApi api = RaytracingApi::NV;
+    Ptr<RaytracingPipeline> pipeline;
+    MemoryUsage memory = GpuOnly;
+    std::map<int, std::vector<uint8>> recordData;
     Ptr<Buffer> buffer;
 
+    struct Retired {
+      Ptr<Buffer> buffer;
+      int frames = 0;
+    };
+    std::vector<Retired> retired;
+    int framesInFlight = 1;
+
     vk::Buffer rayGenBuffer;
     vk::DeviceSize rayGenOffset=0;
     vk::Buffer missBuffer;
@@ -35,5 +67,10 @@ namespace Nei::Vu {
     vk::Buffer callableBuffer;
     vk::DeviceSize callableOffset=0;
     vk::DeviceSize callableStride=0;
+
+    vk::StridedDeviceAddressRegionKHR rayGenRegion;
+    vk::StridedDeviceAddressRegionKHR missRegion;
+    vk::StridedDeviceAddressRegionKHR hitRegion;
+    vk::StridedDeviceAddressRegionKHR callableRegion;
   };
 };
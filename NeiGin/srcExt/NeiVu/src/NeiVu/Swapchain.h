@@ -18,6 +18,9 @@ namespace Nei::Vu {
 
     void resize();
     vk::Image getImage(int i) { return swapchainImages[i]; }
+    uint32 getImageCount() const { return imageCount; }
+    // acquired by begin
+    uint32 getCurrentImage() const { return currentImage; }
 
     vk::Semaphore getPresentSemaphore() const { return presentSemaphores[currentImage]; }
     vk::Semaphore getAcquireSemaphore() const { return acquireSemaphore[aqIndex]; }
@@ -150,7 +150,28 @@ void Texture::setDataAsync(TransferBuffer* tb, void* data, int layer) {
   auto cmd = tb->getCommandBuffer();
   setLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, range);
   cmd->copy(buffer, this, layer);
-  setLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal, range);
+  tb->release(this, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, range);
+}
+
+void Texture::transferOwnership(CommandBuffer* cmd, CommandBuffer* acquire, uint srcIndex, uint dstIndex,
+                                vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::ImageSubresourceRange range) {
+  vk::ImageMemoryBarrier imb;
+  imb.srcQueueFamilyIndex = srcIndex;
+  imb.dstQueueFamilyIndex = dstIndex;
+  imb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  imb.oldLayout = oldLayout;
+  imb.newLayout = newLayout;
+  imb.image = image;
+  imb.subresourceRange = range;
+  (**cmd).pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {},
+                          {imb});
+
+  imb.srcAccessMask = {};
+  imb.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+  (**acquire).pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, {},
+                              {}, {imb});
+
+  layout = newLayout;
 }
 
 void Texture::generateMipMaps(CommandBuffer* cmd) {
@@ -222,7 +243,8 @@ void Texture::create(vk::ImageType type, vk::Format format, uvec3 size, int laye
   ici.usage = usage;
 
   image = deviceContext->getVkDevice().createImage(ici);
-  allocation = deviceContext->getMemoryManager()->allocate(image,GpuOnly);
+  if(memoryUsage != Aliased)
+    allocation = deviceContext->getMemoryManager()->allocate(image,GpuOnly);
 }
 
 void Texture::destroy() {
@@ -230,10 +252,23 @@ void Texture::destroy() {
     auto device = deviceContext->getVkDevice();
     device.destroyImage(image);
     image = nullptr;
-    deviceContext->getMemoryManager()->free(allocation);
+    // aliased memory is owned by TransientMemory
+    if(memoryUsage != Aliased)
+      deviceContext->getMemoryManager()->free(allocation);
+    allocation = Allocation();
   }
 }
 
+vk::MemoryRequirements Texture::getMemoryRequirements() const {
+  return deviceContext->getVkDevice().getImageMemoryRequirements(image);
+}
+
+void Texture::bindMemory(Allocation const& allocation) {
+  nei_assert(memoryUsage == Aliased && image);
+  deviceContext->getVkDevice().bindImageMemory(image, allocation.memory, allocation.offset);
+  this->allocation = allocation;
+}
+
 vk::ImageUsageFlags Texture::usageToFlags(Usage usage) {
   vk::ImageUsageFlags ret;
   switch(usage) {
@@ -303,10 +338,12 @@ vk::ImageView Texture::createView(vk::ImageViewType viewType, vk::ImageAspectFla
   return deviceContext->getVkDevice().createImageView(iwci);
 }
 
-Texture2D::Texture2D(DeviceContext* dc, uvec2 const& size, vk::Format format, Usage usage, bool mipmap)
+Texture2D::Texture2D(DeviceContext* dc, uvec2 const& size, vk::Format format, Usage usage, bool mipmap,
+                     MemoryUsage memory)
   : Texture(dc) {
   int levels = 1;
   this->mipmap = mipmap;
+  memoryUsage = memory;
   if(mipmap) levels = (int)ceil(glm::log2(float(max(size.x, size.y))));
   levels = max(levels,1);
   flags = {};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DeviceObject.h"
+#include "MemoryManager.h"
 
 namespace Nei::Vu {
   class NEIVU_EXPORT Texture : public DeviceObject {
@@ -37,10 +38,22 @@ namespace Nei::Vu {
                    vk::PipelineStageFlags srcStage = vk::PipelineStageFlagBits::eAllCommands,
                    vk::PipelineStageFlags dstStage = vk::PipelineStageFlagBits::eAllCommands);
     
+    // queue family ownership transfer, release into cmd and the matching acquire into acquire,
+    // both barriers carry the same layout transition
+    void transferOwnership(CommandBuffer* cmd, CommandBuffer* acquire, uint srcIndex, uint dstIndex,
+                           vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::ImageSubresourceRange range);
+
     void setData(void* data, int layer = 0);
     void setDataAsync(TransferBuffer* tb, void* data, int layer = 0);
 
     void generateMipMaps(CommandBuffer* cmd=nullptr);
+
+    // aliased textures are created without memory, bindMemory places them into a shared allocation
+    vk::MemoryRequirements getMemoryRequirements() const;
+    void bindMemory(Allocation const& allocation);
+    bool isBound() const { return image && allocation.memory; }
+    MemoryUsage getMemoryUsage() const { return memoryUsage; }
+
   protected:
     void create(vk::ImageType type, vk::Format format, uvec3 size, int layers, int levels, vk::ImageUsageFlags usage);
     void destroy();
@@ -57,13 +70,14 @@ namespace Nei::Vu {
     uint layers = 0;
     uint levels = 0;
     Allocation allocation;
+    MemoryUsage memoryUsage = GpuOnly;
     vk::ImageCreateFlags flags;
   };
 
   class NEIVU_EXPORT Texture2D : public Texture {
   public:
     Texture2D(DeviceContext* dc, uvec2 const& size, vk::Format format, Usage usage = Usage::Sampled,
-              bool mipmap = true);
+              bool mipmap = true, MemoryUsage memory = GpuOnly);
 
     uvec2 getSize() const { return uvec2(size); }
     void resize(uvec2 const& size);
@@ -2,12 +2,19 @@
 
 #include "CommandBuffer.h"
 #include "Buffer.h"
+#include "Texture.h"
 using namespace Nei;
 using namespace Vu;
 
 TransferBuffer::TransferBuffer(DeviceContext* dc) :DeviceObject(dc) {
-  //commandBuffer = new CommandBuffer(dc, true, deviceContext->getTransferQueueIndex());
-  commandBuffer = new CommandBuffer(dc, true, deviceContext->getMainQueueIndex());
+  mainCommandBuffer = new CommandBuffer(dc, true, deviceContext->getMainQueueIndex());
+  int transferIndex = deviceContext->getTransferQueueIndex();
+  if(transferIndex != MissingQueue && transferIndex != deviceContext->getMainQueueIndex()) {
+    commandBuffer = new CommandBuffer(dc, true, transferIndex);
+    semaphore = deviceContext->getVkDevice().createSemaphoreUnique(vk::SemaphoreCreateInfo());
+  } else {
+    commandBuffer = mainCommandBuffer;
+  }
 }
 
 TransferBuffer::~TransferBuffer() {
@@ -21,35 +28,56 @@ Buffer* TransferBuffer::createStagingBuffer(uint size) {
   return ret;
 }
 
+void TransferBuffer::release(Buffer* buffer) {
+  // concurrent buffers are shared by the queues, the semaphore is enough
+  if(!isAsync() || buffer->isConcurrent()) return;
+  buffer->transferOwnership(commandBuffer, mainCommandBuffer, deviceContext->getTransferQueueIndex(),
+                            deviceContext->getMainQueueIndex());
+}
+
+void TransferBuffer::release(Texture* texture, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                             vk::ImageSubresourceRange const& range) {
+  if(!isAsync()) {
+    texture->setLayout(commandBuffer, oldLayout, newLayout, range);
+    return;
+  }
+  texture->transferOwnership(commandBuffer, mainCommandBuffer, deviceContext->getTransferQueueIndex(),
+                             deviceContext->getMainQueueIndex(), oldLayout, newLayout, range);
+}
+
 void TransferBuffer::begin() {
-  nei_assertm(!fence,"Transfer buffer already started!");
-  fence = deviceContext->getVkDevice().createFenceUnique(vk::FenceCreateInfo());
+  nei_assertm(!started,"Transfer buffer already started!");
+  started = true;
   commandBuffer->begin();
+  if(isAsync()) mainCommandBuffer->begin();
 }
 
 void TransferBuffer::end() {
   commandBuffer->end();
-  //auto q = deviceContext->getTransferQueue();
-  auto q = deviceContext->getMainQueue();
-  vk::SubmitInfo si;
-  si.commandBufferCount = 1;
-  si.pCommandBuffers = commandBuffer->vkPtr();
-  q.submit({si}, *fence);
+  if(!isAsync()) {
+    ticket = commandBuffer->submit(false);
+    return;
+  }
+
+  commandBuffer->submit({}, {*semaphore}, {});
+
+  // acquires and graphics work wait for all copies
+  mainCommandBuffer->end();
+  ticket = mainCommandBuffer->submit({*semaphore}, {}, {vk::PipelineStageFlagBits::eAllCommands});
 }
 
 bool TransferBuffer::wait() {
-  if (!fence) return true;
-  auto device = deviceContext->getVkDevice();
-  auto res = device.waitForFences({ *fence }, true, ~0u);
-  return res == vk::Result::eSuccess;
+  if (!started) return true;
+  deviceContext->wait(ticket);
+  started = false;
+  ticket = 0;
+  return true;
 }
 
 bool TransferBuffer::isFinished() {
-  if (!fence) return true;
-  auto device = deviceContext->getVkDevice();
-  auto status = device.getFenceStatus(*fence);
-  if(status == vk::Result::eSuccess) {
-    fence.reset();
-  }
-  return status == vk::Result::eSuccess;
+  if (!started) return true;
+  if (!deviceContext->isFinished(ticket)) return false;
+  started = false;
+  ticket = 0;
+  return true;
 }
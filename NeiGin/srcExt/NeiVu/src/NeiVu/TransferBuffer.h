@@ -3,6 +3,10 @@
 #include "DeviceObject.h"
 
 namespace Nei::Vu {
+  // Copies are recorded into getCommandBuffer and run on the dedicated transfer queue. Written resources
+  // are released there and acquired by the main queue, which waits for the copies on a semaphore.
+  // Graphics only work (mip generation) goes into getMainCommandBuffer, it runs after the acquire.
+  // Without a separate transfer family both are the same command buffer on the main queue.
   class NEIVU_EXPORT TransferBuffer : public DeviceObject {
   public:
     TransferBuffer(DeviceContext* dc);
@@ -10,6 +14,14 @@ namespace Nei::Vu {
 
     Buffer* createStagingBuffer(uint size);
     CommandBuffer* getCommandBuffer() { return commandBuffer; }
+    CommandBuffer* getMainCommandBuffer() { return mainCommandBuffer; }
+    bool isAsync() const { return commandBuffer != mainCommandBuffer; }
+
+    // hands the written resource to the main queue, call after the last copy into it
+    void release(Buffer* buffer);
+    // oldLayout is the one of the copies, main queue continues with newLayout
+    void release(Texture* texture, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                 vk::ImageSubresourceRange const& range);
 
     void begin();
     void end();
@@ -17,7 +29,10 @@ namespace Nei::Vu {
     bool isFinished();
   protected:
     Ptr<CommandBuffer> commandBuffer;
+    Ptr<CommandBuffer> mainCommandBuffer;
     std::vector<Ptr<Buffer>> buffers;
-    vk::UniqueFence fence;
+    bool started = false;
+    uint64 ticket = 0; // main queue submission, after the copies
+    vk::UniqueSemaphore semaphore; // transfer to main queue
   };
 };
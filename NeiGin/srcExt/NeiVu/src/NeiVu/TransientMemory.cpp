@@ -0,0 +1,129 @@
+#include "TransientMemory.h"
+
+#include "Texture.h"
+#include "Buffer.h"
+#include "MemoryManager.h"
+
+using namespace Nei;
+using namespace Vu;
+
+namespace {
+  vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+}
+
+TransientMemory::TransientMemory(DeviceContext* dc): DeviceObject(dc) { }
+
+TransientMemory::~TransientMemory() {
+  release();
+}
+
+void TransientMemory::add(Texture* texture, ivec2 lifetime) {
+  nei_assert(texture->getMemoryUsage() == Aliased);
+  Entry e;
+  e.handle = texture;
+  e.texture = texture;
+  e.lifetime = lifetime;
+  entries.push_back(e);
+}
+
+void TransientMemory::add(Buffer* buffer, ivec2 lifetime) {
+  nei_assert(buffer->getMemoryType() == Aliased);
+  Entry e;
+  e.handle = buffer;
+  e.buffer = buffer;
+  e.lifetime = lifetime;
+  entries.push_back(e);
+}
+
+void TransientMemory::allocate() {
+  nei_assertm(!allocation.memory, "TransientMemory resources are already bound, clear and add recreated ones");
+  if(entries.empty()) return;
+
+  // linear and optimal resources can share a page only with buffer image granularity
+  auto granularity = deviceContext->getVkPhysicalDevice().getProperties().limits.bufferImageGranularity;
+
+  uint memoryTypeBits = ~0u;
+  unaliasedSize = 0;
+  for(auto& e : entries) {
+    e.requirements = e.texture ? e.texture->getMemoryRequirements() : e.buffer->getMemoryRequirements();
+    e.requirements.alignment = glm::max(e.requirements.alignment, granularity);
+    memoryTypeBits &= e.requirements.memoryTypeBits;
+    unaliasedSize += alignUp(e.requirements.size, e.requirements.alignment);
+    // unused resources are kept alive for the whole frame
+    if(e.lifetime.x < 0) e.lifetime = ivec2(0, std::numeric_limits<int>::max());
+  }
+  nei_assert(memoryTypeBits != 0);
+
+  // largest first, each resource takes the lowest offset not used by a resource alive at the same time
+  std::vector<Entry*> order;
+  for(auto& e : entries) order.push_back(&e);
+  std::stable_sort(order.begin(), order.end(), [](Entry* a, Entry* b) {
+    return a->requirements.size > b->requirements.size;
+  });
+
+  std::vector<Entry*> placed;
+  for(auto e : order) {
+    std::vector<Entry*> live;
+    for(auto p : placed)
+      if(overlaps(*e, *p)) live.push_back(p);
+    std::sort(live.begin(), live.end(), [](Entry* a, Entry* b) { return a->offset < b->offset; });
+
+    vk::DeviceSize offset = 0;
+    for(auto p : live) {
+      offset = alignUp(offset, e->requirements.alignment);
+      if(offset + e->requirements.size <= p->offset) break;
+      offset = glm::max(offset, p->offset + p->requirements.size);
+    }
+    e->offset = alignUp(offset, e->requirements.alignment);
+    size = glm::max(size, uint64(e->offset + e->requirements.size));
+    placed.push_back(e);
+  }
+
+  vk::MemoryRequirements requirements;
+  requirements.size = size;
+  requirements.alignment = granularity;
+  requirements.memoryTypeBits = memoryTypeBits;
+  allocation = deviceContext->getMemoryManager()->allocate(requirements, GpuOnly);
+
+  for(auto& e : entries) {
+    Allocation range = allocation;
+    range.offset += uint(e.offset);
+    range.size = uint(e.requirements.size);
+    if(e.texture) e.texture->bindMemory(range);
+    else e.buffer->bindMemory(range);
+  }
+
+  nei_log("Transient memory {} MB, {} MB without aliasing", size >> 20, unaliasedSize >> 20);
+}
+
+std::vector<std::pair<void*, void*>> TransientMemory::getAliases() const {
+  std::vector<std::pair<void*, void*>> aliases;
+  for(int i = 0; i < entries.size(); i++) {
+    for(int j = i + 1; j < entries.size(); j++) {
+      auto& a = entries[i];
+      auto& b = entries[j];
+      if(a.offset < b.offset + b.requirements.size && b.offset < a.offset + a.requirements.size)
+        aliases.emplace_back(a.handle, b.handle);
+    }
+  }
+  return aliases;
+}
+
+void TransientMemory::clear() {
+  release();
+  entries.clear();
+  unaliasedSize = 0;
+}
+
+void TransientMemory::release() {
+  if(allocation.memory)
+    deviceContext->getMemoryManager()->free(allocation);
+  allocation = Allocation();
+  size = 0;
+}
+
+bool TransientMemory::overlaps(Entry const& a, Entry const& b) {
+  return a.lifetime.x <= b.lifetime.y && b.lifetime.x <= a.lifetime.y;
+}
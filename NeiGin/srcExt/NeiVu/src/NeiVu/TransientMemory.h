@@ -0,0 +1,47 @@
+#pragma once
+
+#include "DeviceObject.h"
+
+namespace Nei::Vu {
+  // Places textures and buffers created with Aliased memory into one allocation.
+  // Resources whose lifetimes (first and last pass using them) don't overlap share memory,
+  // lifetimes come from RenderGraph::getLifetime. Vulkan resources can be bound to memory only once, so one set of
+  // resources is allocated once. Resizing recreates the resources, clear and add them again before allocate.
+  class NEIVU_EXPORT TransientMemory : public DeviceObject {
+  public:
+    TransientMemory(DeviceContext* dc);
+    virtual ~TransientMemory();
+
+    void add(Texture* texture, ivec2 lifetime);
+    void add(Buffer* buffer, ivec2 lifetime);
+
+    // packs the resources and binds them, only once until clear
+    void allocate();
+    // releases the memory and forgets the resources, they are unusable until recreated or bound elsewhere
+    void clear();
+
+    // pairs of resources sharing memory, a barrier is needed between their uses
+    std::vector<std::pair<void*, void*>> getAliases() const;
+
+    uint64 getSize() const { return size; }
+    uint64 getUnaliasedSize() const { return unaliasedSize; }
+
+  protected:
+    struct Entry {
+      void* handle = nullptr;
+      Texture* texture = nullptr;
+      Buffer* buffer = nullptr;
+      ivec2 lifetime;
+      vk::MemoryRequirements requirements;
+      vk::DeviceSize offset = 0;
+    };
+
+    void release();
+    static bool overlaps(Entry const& a, Entry const& b);
+
+    std::vector<Entry> entries;
+    Allocation allocation;
+    uint64 size = 0;
+    uint64 unaliasedSize = 0;
+  };
+};
@@ -0,0 +1,41 @@
+#include "UniformRing.h"
+
+#include "Buffer.h"
+#include "MemoryManager.h"
+
+using namespace Nei;
+using namespace Vu;
+
+namespace {
+  uint alignUp(uint value, uint alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+}
+
+UniformRing::UniformRing(DeviceContext* dc, uint frameSize, int frames): DeviceObject(dc), frames(frames) {
+  auto properties = dc->getVkPhysicalDevice().getProperties();
+  alignment = std::max(1u, uint(properties.limits.minUniformBufferOffsetAlignment));
+  this->frameSize = alignUp(frameSize, alignment);
+
+  buffer = new Buffer(dc, this->frameSize * frames, Buffer::Uniform, Stream);
+  buffer->setName("UniformRing");
+  mapped = (uint8*)buffer->map();
+}
+
+UniformRing::~UniformRing() {
+  if(mapped) buffer->unmap();
+}
+
+void UniformRing::beginFrame(int frame) {
+  nei_assert(frame >= 0 && frame < frames);
+  begin = frame * frameSize;
+  head = begin;
+}
+
+uint32 UniformRing::push(void const* data, uint size) {
+  uint offset = alignUp(head, alignment);
+  nei_assertm(offset + size <= begin + frameSize, "UniformRing frame region is full");
+  memcpy(mapped + offset, data, size);
+  head = offset + size;
+  return offset;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DeviceObject.h"
+
+namespace Nei::Vu {
+  // Per frame uniform data in one persistently mapped Stream buffer. Every frame in flight owns a region,
+  // allocations are aligned sub ranges bound with dynamic offsets (see Pipeline::setDynamicUniform).
+  // A region is reused by beginFrame, the frame which used it last has to be finished.
+  class NEIVU_EXPORT UniformRing : public DeviceObject {
+  public:
+    UniformRing(DeviceContext* dc, uint frameSize, int frames = 4);
+    virtual ~UniformRing();
+
+    // starts writing into the region of the frame, previous allocations in it are discarded
+    void beginFrame(int frame);
+
+    // returns the dynamic offset, data is visible to the next submission
+    uint32 push(void const* data, uint size);
+
+    template<typename T>
+    uint32 push(T const& value) { return push(&value, sizeof(T)); }
+
+    Buffer* getBuffer() const { return buffer; }
+    uint getAlignment() const { return alignment; }
+    uint getFrameSize() const { return frameSize; }
+    // bytes allocated in the current frame, including alignment
+    uint getFrameUsage() const { return head - begin; }
+
+  protected:
+    Ptr<Buffer> buffer;
+    uint8* mapped = nullptr;
+    uint alignment = 1;
+    uint frameSize = 0;
+    int frames = 0;
+    uint begin = 0;
+    uint head = 0;
+  };
+};
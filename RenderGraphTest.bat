@@ -0,0 +1 @@
+bin\release\RenderGraphTest.exe
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 3 -b 1 -i 1024 -ia 0.1 -l rtx_Budha_1080_Instances1k.csv
\ No newline at end of file
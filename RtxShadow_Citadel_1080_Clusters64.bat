@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 2 -b 0 -c 64 -l rtx_Citadel_1080_Clusters64.csv
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 4 -b 0 -rt khr -l rtx_Hairball_1080_KHR.csv
\ No newline at end of file
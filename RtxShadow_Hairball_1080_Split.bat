@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 4 -b 0 -ts 0.5 -l rtx_Hairball_1080_Split.csv
\ No newline at end of file
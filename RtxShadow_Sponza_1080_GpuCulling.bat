@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 0 -b 0 -gc 256 -l rtx_Sponza_1080_GpuCulling.csv
\ No newline at end of file
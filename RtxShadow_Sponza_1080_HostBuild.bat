@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -a 5 -p 0 -b 0 -rt khr -hb 8 -l rtx_Sponza_1080_HostBuild.csv
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -r 2 -a 5 -p 0 -b 0 -rp -l rtx_Sponza_4k_Replay.csv
\ No newline at end of file
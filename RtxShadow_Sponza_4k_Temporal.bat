@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -r 2 -a 5 -p 0 -b 0 -sm 3 -qm -l rtx_Sponza_4k_Temporal.csv
\ No newline at end of file
@@ -0,0 +1 @@
+bin\release\RtxShadow.exe -w 1920 -h 1080 -t 1000 -r 4 -a 5 -p 0 -b 0 -sm 2 -qm -l rtx_Sponza_8k_Checkerboard.csv
\ No newline at end of file